@@ -1,6 +1,7 @@
 // cam_to_privcam_dmabuf.c
-// Capture one YUYV frame from /dev/video0 (MMAP), export that camera buffer as DMABUF (EXPBUF),
-// queue it into privcam OUTPUT using V4L2_MEMORY_DMABUF, dequeue privcam CAPTURE (MMAP), write out.yuyv.
+// Capture YUYV frames from /dev/video0 (MMAP), export the camera buffers as DMABUF (EXPBUF),
+// queue them into privcam OUTPUT using V4L2_MEMORY_DMABUF, dequeue privcam CAPTURE (MMAP) and
+// append each frame to out.yuyv. Every frame's glass-to-disk timing goes to a CSV trace.
 
 #define _GNU_SOURCE
 #include <errno.h>
@@ -14,6 +15,8 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include "frame_trace.h"
+#include "pcraw.h"
 
 static int xioctl(int fd, unsigned long req, void *arg)
 {
@@ -33,7 +36,8 @@ struct mmap_buf {
     size_t len;
 };
 
-static void set_fmt(int fd, enum v4l2_buf_type type, uint32_t w, uint32_t h, uint32_t pixfmt)
+// Returns the format the driver settled on, padding included
+static struct v4l2_pix_format set_fmt(int fd, enum v4l2_buf_type type, uint32_t w, uint32_t h, uint32_t pixfmt)
 {
     struct v4l2_format fmt;
     memset(&fmt, 0, sizeof(fmt));
@@ -54,6 +58,7 @@ static void set_fmt(int fd, enum v4l2_buf_type type, uint32_t w, uint32_t h, uin
             (fmt.fmt.pix.pixelformat >> 16) & 0xFF,
             (fmt.fmt.pix.pixelformat >> 24) & 0xFF,
             fmt.fmt.pix.bytesperline, fmt.fmt.pix.sizeimage);
+    return fmt.fmt.pix;
 }
 
 static uint32_t reqbufs(int fd, enum v4l2_buf_type type, enum v4l2_memory mem, uint32_t count)
@@ -111,7 +116,8 @@ static void qbuf_mmap(int fd, enum v4l2_buf_type type, uint32_t index, uint32_t
 }
 
 static void qbuf_dmabuf(int fd, enum v4l2_buf_type type, uint32_t index,
-                        int dmabuf_fd, uint32_t bytesused, uint32_t length)
+                        int dmabuf_fd, uint32_t bytesused, uint32_t length,
+                        const struct timeval *timestamp)
 {
     struct v4l2_buffer b;
     memset(&b, 0, sizeof(b));
@@ -121,6 +127,7 @@ static void qbuf_dmabuf(int fd, enum v4l2_buf_type type, uint32_t index,
     b.m.fd = dmabuf_fd;
     b.bytesused = bytesused;
     b.length = 0;
+    b.timestamp = *timestamp;   // privcam copies it to the CAPTURE buffer
 
     if (xioctl(fd, VIDIOC_QBUF, &b) == -1)
         die("VIDIOC_QBUF (DMABUF)");
@@ -178,13 +185,15 @@ int main(int argc, char **argv)
     const char *out_path = (argc > 3) ? argv[3] : "out.yuyv";
     uint32_t w = (argc > 4) ? (uint32_t)atoi(argv[4]) : 640;
     uint32_t h = (argc > 5) ? (uint32_t)atoi(argv[5]) : 480;
+    uint32_t nframes = (argc > 6) ? (uint32_t)atoi(argv[6]) : 1;
+    const char *trace_path = (argc > 7) ? argv[7] : "trace.csv";
 
     const uint32_t pixfmt = V4L2_PIX_FMT_YUYV;
-    const uint32_t frame_sz = w * h * 2;
 
     fprintf(stderr, "[MODE] DMABUF handoff\n");
-    fprintf(stderr, "Camera:  %s\nPrivcam: %s\nOut:     %s\nSize:    %ux%u YUYV (%u bytes)\n",
-            cam_dev, m2m_dev, out_path, w, h, frame_sz);
+    fprintf(stderr, "Camera:  %s\nPrivcam: %s\nOut:     %s\nSize:    %ux%u YUYV\n"
+            "Frames:  %u\nTrace:   %s\n",
+            cam_dev, m2m_dev, out_path, w, h, nframes, trace_path);
 
     int cam_fd = open(cam_dev, O_RDWR | O_CLOEXEC);
     if (cam_fd < 0) die("open camera");
@@ -195,7 +204,10 @@ int main(int argc, char **argv)
     // Set formats
     set_fmt(cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, w, h, pixfmt);
     set_fmt(m2m_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT,  w, h, pixfmt);
-    set_fmt(m2m_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, w, h, pixfmt);
+    const struct v4l2_pix_format cap_fmt = set_fmt(m2m_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, w, h, pixfmt);
+
+    // privcam may pad rows, so frames are sized by what it reported, not w * 2
+    const uint32_t frame_sz = cap_fmt.sizeimage;
 
     // Camera: MMAP capture buffers
     const uint32_t cam_req = 4;
@@ -234,48 +246,85 @@ int main(int argc, char **argv)
     stream_on(m2m_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE);
     stream_on(m2m_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT);
 
-    // ---- Process exactly one frame ----
-
-    // 1) DQ one frame from camera
-    struct v4l2_buffer cam_dq;
-    if (dqbuf_any(cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, V4L2_MEMORY_MMAP, &cam_dq) == -1)
-        die("camera VIDIOC_DQBUF");
-
-    uint32_t cam_bytes = cam_dq.bytesused ? cam_dq.bytesused : frame_sz;
-    if (cam_bytes > frame_sz) cam_bytes = frame_sz;
-
-    // 2) Queue that camera buffer's DMABUF fd into privcam OUTPUT (no memcpy)
-    // Use same index as camera's index (simple & works when counts match).
-    qbuf_dmabuf(m2m_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT,
-                cam_dq.index,
-                cam_dmabuf_fds[cam_dq.index],
-                cam_bytes,
-                frame_sz);
-
-    // 3) DQ CAPTURE from privcam
-    struct v4l2_buffer cap_dq;
-    if (dqbuf_any(m2m_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, V4L2_MEMORY_MMAP, &cap_dq) == -1)
-        die("privcam CAPTURE VIDIOC_DQBUF");
+    // "*.pcraw" records an indexed container with timestamps, anything else a raw dump
+    int out_fd = -1;
+    struct pcraw rec_c;
+    const int use_pcraw = pcraw_path(out_path);
+    if (use_pcraw) {
+        if (pcraw_create(&rec_c, out_path, w, h, pixfmt, 1, &cap_fmt.bytesperline, &frame_sz, nframes) < 0)
+            exit(1);
+    } else {
+        out_fd = open(out_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        if (out_fd < 0) die("open out file");
+    }
 
-    uint32_t out_bytes = cap_dq.bytesused ? cap_dq.bytesused : frame_sz;
-    if (out_bytes > cap_bufs[cap_dq.index].len) out_bytes = cap_bufs[cap_dq.index].len;
+    struct frame_trace trace;
+    if (frame_trace_open(&trace, trace_path) < 0) exit(1);
+
+    for (uint32_t n = 0; n < nframes; n++) {
+        struct frame_trace_rec rec;
+        memset(&rec, 0, sizeof(rec));
+
+        // 1) DQ one frame from camera
+        struct v4l2_buffer cam_dq;
+        if (dqbuf_any(cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, V4L2_MEMORY_MMAP, &cam_dq) == -1)
+            die("camera VIDIOC_DQBUF");
+        rec.t[TRACE_CAM_DQ] = trace_now_ns();
+
+        uint32_t cam_bytes = cam_dq.bytesused ? cam_dq.bytesused : frame_sz;
+        if (cam_bytes > frame_sz) cam_bytes = frame_sz;
+
+        // 2) Queue that camera buffer's DMABUF fd into privcam OUTPUT (no memcpy)
+        // Use same index as camera's index (simple & works when counts match).
+        rec.t[TRACE_PC_Q] = trace_now_ns();
+        qbuf_dmabuf(m2m_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT,
+                    cam_dq.index,
+                    cam_dmabuf_fds[cam_dq.index],
+                    cam_bytes,
+                    frame_sz,
+                    &cam_dq.timestamp);
+
+        // 3) DQ CAPTURE from privcam
+        struct v4l2_buffer cap_dq;
+        if (dqbuf_any(m2m_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, V4L2_MEMORY_MMAP, &cap_dq) == -1)
+            die("privcam CAPTURE VIDIOC_DQBUF");
+        rec.t[TRACE_PC_DQ] = trace_now_ns();
+
+        // The camera timestamp as it came out of privcam
+        rec.seq = cap_dq.sequence;
+        rec.t[TRACE_CAM_TS] = trace_tv_ns(&cap_dq.timestamp);
+
+        uint32_t out_bytes = cap_dq.bytesused ? cap_dq.bytesused : frame_sz;
+        if (out_bytes > cap_bufs[cap_dq.index].len) out_bytes = cap_bufs[cap_dq.index].len;
+
+        if (use_pcraw) {
+            const void *planes[1] = { cap_bufs[cap_dq.index].addr };
+            if (pcraw_append(&rec_c, planes, &out_bytes, rec.t[TRACE_CAM_TS], cap_dq.sequence) < 0)
+                exit(1);
+        } else if (write(out_fd, cap_bufs[cap_dq.index].addr, out_bytes) < 0) {
+            die("write out");
+        }
+        rec.t[TRACE_WR_DONE] = trace_now_ns();
 
-    int out_fd = open(out_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
-    if (out_fd < 0) die("open out file");
-    ssize_t wr = write(out_fd, cap_bufs[cap_dq.index].addr, out_bytes);
-    if (wr < 0) die("write out");
-    close(out_fd);
+        frame_trace_add(&trace, &rec);
 
-    fprintf(stderr, "Wrote %zd bytes to %s\n", wr, out_path);
+        // 4) DQ privcam OUTPUT (recycle)
+        struct v4l2_buffer out_dq;
+        if (dqbuf_any(m2m_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT, V4L2_MEMORY_DMABUF, &out_dq) == -1)
+            die("privcam OUTPUT VIDIOC_DQBUF");
 
-    // 4) DQ privcam OUTPUT (recycle)
-    struct v4l2_buffer out_dq;
-    if (dqbuf_any(m2m_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT, V4L2_MEMORY_DMABUF, &out_dq) == -1)
-        die("privcam OUTPUT VIDIOC_DQBUF");
+        // Requeue camera and privcam CAPTURE buffers for the next frame
+        if (xioctl(cam_fd, VIDIOC_QBUF, &cam_dq) == -1)
+            die("camera re-QBUF");
+        qbuf_mmap(m2m_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, cap_dq.index, 0);
+    }
 
-    // Requeue camera buffer and stop
-    if (xioctl(cam_fd, VIDIOC_QBUF, &cam_dq) == -1)
-        die("camera re-QBUF");
+    if (use_pcraw)
+        pcraw_close(&rec_c);
+    else
+        close(out_fd);
+    fprintf(stderr, "Wrote %u frames to %s\n", nframes, out_path);
+    frame_trace_close(&trace);
 
     stream_off(m2m_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT);
     stream_off(m2m_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE);
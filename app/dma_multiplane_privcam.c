@@ -12,6 +12,8 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include "dmaheap_pool.h"
+
 static int xioctl(int fd, unsigned long req, void *arg)
 {
     int r;
@@ -19,37 +21,6 @@ static int xioctl(int fd, unsigned long req, void *arg)
     return r;
 }
 
-static int dmabuf_sync(int dmabuf_fd, int start)
-{
-    struct dma_buf_sync sync;
-    memset(&sync, 0, sizeof(sync));
-    sync.flags = DMA_BUF_SYNC_RW | (start ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END);
-    if (xioctl(dmabuf_fd, DMA_BUF_IOCTL_SYNC, &sync) < 0) {
-        perror("DMA_BUF_IOCTL_SYNC");
-        return -1;
-    }
-    return 0;
-}
-
-static int alloc_dmabuf_from_heap(const char *heap_path, size_t size)
-{
-    int heap_fd = open(heap_path, O_RDONLY | O_CLOEXEC);
-    if (heap_fd < 0) { perror("open dma_heap"); return -1; }
-
-    struct dma_heap_allocation_data alloc;
-    memset(&alloc, 0, sizeof(alloc));
-    alloc.len = size;
-    alloc.fd_flags = O_RDWR | O_CLOEXEC;
-
-    if (xioctl(heap_fd, DMA_HEAP_IOCTL_ALLOC, &alloc) < 0) {
-        perror("DMA_HEAP_IOCTL_ALLOC");
-        close(heap_fd);
-        return -1;
-    }
-    close(heap_fd);
-    return (int)alloc.fd;
-}
-
 static int read_exact(int fd, void *dst, size_t len)
 {
     size_t off = 0;
@@ -62,27 +33,17 @@ static int read_exact(int fd, void *dst, size_t len)
     return off == len ? 0 : -1;
 }
 
-static int load_file_into_dmabuf(const char *path, int dmabuf_fd, size_t size)
+static int load_file_into_dmabuf(const char *path, struct dmaheap_buf *buf, size_t off, size_t size)
 {
     int f = open(path, O_RDONLY | O_CLOEXEC);
     if (f < 0) { perror("open input"); return -1; }
 
-    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, dmabuf_fd, 0);
-    if (p == MAP_FAILED) { perror("mmap dmabuf"); close(f); return -1; }
-
-    if (dmabuf_sync(dmabuf_fd, 1) < 0) { munmap(p, size); close(f); return -1; }
-
-    if (read_exact(f, p, size) < 0) {
+    if (read_exact(f, (uint8_t *)buf->addr + off, size) < 0) {
         fprintf(stderr, "%s too small (need %zu bytes)\n", path, size);
-        dmabuf_sync(dmabuf_fd, 0);
-        munmap(p, size);
         close(f);
         return -1;
     }
 
-    if (dmabuf_sync(dmabuf_fd, 0) < 0) { /* continue */ }
-
-    munmap(p, size);
     close(f);
     return 0;
 }
@@ -166,9 +127,10 @@ static int qbuf_capture(int vfd, unsigned index)
     return 0;
 }
 
-static int qbuf_output_dmabuf_i420m(int vfd, unsigned index,
-                                   int y_fd, int u_fd, int v_fd,
-                                   unsigned y_size, unsigned u_size, unsigned v_size)
+// All three planes point at the same dmabuf; data_offset selects each plane.
+// bytesused counts from the start of the buffer, so it includes data_offset.
+static int qbuf_output_dmabuf_i420m(int vfd, unsigned index, int fd, unsigned length,
+                                    const unsigned off[3], const unsigned size[3])
 {
     struct v4l2_buffer b;
     struct v4l2_plane planes[3];
@@ -181,9 +143,12 @@ static int qbuf_output_dmabuf_i420m(int vfd, unsigned index,
     b.length = 3;
     b.m.planes = planes;
 
-    planes[0].m.fd = y_fd; planes[0].bytesused = y_size; planes[0].length = y_size;
-    planes[1].m.fd = u_fd; planes[1].bytesused = u_size; planes[1].length = u_size;
-    planes[2].m.fd = v_fd; planes[2].bytesused = v_size; planes[2].length = v_size;
+    for (int p = 0; p < 3; p++) {
+        planes[p].m.fd = fd;
+        planes[p].data_offset = off[p];
+        planes[p].bytesused = off[p] + size[p];
+        planes[p].length = length;
+    }
 
     if (xioctl(vfd, VIDIOC_QBUF, &b) < 0) { perror("VIDIOC_QBUF out dmabuf"); return -1; }
     return 0;
@@ -222,7 +187,7 @@ int main(int argc, char **argv)
     const size_t USZ = YSZ / 4;
     const size_t VSZ = YSZ / 4;
 
-    printf("[MODE] system dma-heap -> 3 dmabufs (Y/U/V) -> privcam\n");
+    printf("[MODE] system dma-heap -> 1 dmabuf (Y/U/V at data_offset) -> privcam\n");
     printf("Inputs:  %s %s %s\n", in_y, in_u, in_v);
     printf("Outputs: %s %s %s\n", out_y, out_u, out_v);
 
@@ -232,19 +197,29 @@ int main(int argc, char **argv)
     if (set_fmt_i420m(vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE,  W, H) < 0) return 1;
     if (set_fmt_i420m(vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, W, H) < 0) return 1;
 
-    // Allocate dmabufs
-    int y_fd = alloc_dmabuf_from_heap(heap, YSZ);
-    int u_fd = alloc_dmabuf_from_heap(heap, USZ);
-    int v_fd = alloc_dmabuf_from_heap(heap, VSZ);
-    if (y_fd < 0 || u_fd < 0 || v_fd < 0) return 1;
+    // One dmabuf per frame holding Y, U and V back to back, taken from a pool
+    // (one heap fd, premapped buffers). Planes are addressed by data_offset.
+    const unsigned out_count = 1;
+    const size_t FRAME_SZ = YSZ + USZ + VSZ;
+    const unsigned plane_off[3]  = { 0, (unsigned)YSZ, (unsigned)(YSZ + USZ) };
+    const unsigned plane_size[3] = { (unsigned)YSZ, (unsigned)USZ, (unsigned)VSZ };
+
+    struct dmaheap_pool pool;
+    if (dmaheap_pool_init(&pool, heap, out_count) < 0) return 1;
+    if (dmaheap_pool_reserve(&pool, FRAME_SZ, out_count) < 0) return 1;
 
-    // Load each plane file into its dmabuf
-    if (load_file_into_dmabuf(in_y, y_fd, YSZ) < 0) return 1;
-    if (load_file_into_dmabuf(in_u, u_fd, USZ) < 0) return 1;
-    if (load_file_into_dmabuf(in_v, v_fd, VSZ) < 0) return 1;
+    struct dmaheap_buf *frame = dmaheap_pool_get(&pool, FRAME_SZ);
+    if (!frame) return 1;
+
+    // Load each plane file at its offset, one CPU access window for the frame
+    if (dmabuf_sync(frame->fd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE) < 0) return 1;
+    if (load_file_into_dmabuf(in_y, frame, plane_off[0], YSZ) < 0) return 1;
+    if (load_file_into_dmabuf(in_u, frame, plane_off[1], USZ) < 0) return 1;
+    if (load_file_into_dmabuf(in_v, frame, plane_off[2], VSZ) < 0) return 1;
+    if (dmabuf_sync(frame->fd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE) < 0) return 1;
 
     // OUTPUT: DMABUF slots
-    if (reqbufs(vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_DMABUF, 1) < 0) return 1;
+    if (reqbufs(vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_DMABUF, out_count) < 0) return 1;
 
     // CAPTURE: MMAP buffers
     const unsigned cap_count = 2;
@@ -258,8 +233,7 @@ int main(int argc, char **argv)
     }
 
     // Queue one OUTPUT frame
-    if (qbuf_output_dmabuf_i420m(vfd, 0, y_fd, u_fd, v_fd,
-                                (unsigned)YSZ, (unsigned)USZ, (unsigned)VSZ) < 0)
+    if (qbuf_output_dmabuf_i420m(vfd, 0, frame->fd, (unsigned)FRAME_SZ, plane_off, plane_size) < 0)
         return 1;
 
     // Stream
@@ -302,6 +276,9 @@ int main(int argc, char **argv)
     stream_off(vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE);
     stream_off(vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE);
 
+    dmaheap_pool_put(frame);
+    dmaheap_pool_destroy(&pool);
+
     printf("Wrote: %s %s %s\n", out_y, out_u, out_v);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,189 @@
+// dmaheap_pool.h
+// Recycled dma-heap buffer pool. The heap fd stays open for the lifetime of the pool,
+// buffers are grouped by size (one class per plane size) and keep a persistent CPU
+// mapping, so a get/put pair is a free-list pop/push with no ioctl, mmap or page fault.
+
+#ifndef DMAHEAP_POOL_H
+#define DMAHEAP_POOL_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-heap.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define DMAHEAP_POOL_MAX_CLASSES 8
+
+struct dmaheap_class;
+
+struct dmaheap_buf {
+    int fd;                         // dmabuf fd, owned by the pool
+    void *addr;                     // persistent mapping of the whole buffer
+    size_t size;
+    struct dmaheap_class *cls;      // owning size class, makes put O(1)
+    struct dmaheap_buf *next;       // free-list link while idle
+};
+
+struct dmaheap_class {
+    size_t size;
+    unsigned count;                 // buffers allocated in this class
+    struct dmaheap_buf *free;       // LIFO free list, keeps recently used buffers cache-hot
+};
+
+struct dmaheap_pool {
+    int heap_fd;
+    unsigned cap;                   // max buffers per class
+    unsigned nclasses;
+    struct dmaheap_class classes[DMAHEAP_POOL_MAX_CLASSES];
+};
+
+static inline int dmaheap_pool_init(struct dmaheap_pool *pool, const char *heap_path, unsigned cap)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->cap = cap ? cap : 1;
+    pool->heap_fd = open(heap_path, O_RDONLY | O_CLOEXEC);
+    if (pool->heap_fd < 0) {
+        perror("open dma_heap");
+        return -1;
+    }
+    return 0;
+}
+
+static inline struct dmaheap_class *dmaheap_pool_class(struct dmaheap_pool *pool, size_t size)
+{
+    for (unsigned i = 0; i < pool->nclasses; i++)
+        if (pool->classes[i].size == size)
+            return &pool->classes[i];
+
+    if (pool->nclasses == DMAHEAP_POOL_MAX_CLASSES) {
+        fprintf(stderr, "dmaheap_pool: too many size classes\n");
+        return NULL;
+    }
+    struct dmaheap_class *cls = &pool->classes[pool->nclasses++];
+    cls->size = size;
+    return cls;
+}
+
+static inline struct dmaheap_buf *dmaheap_pool_grow(struct dmaheap_pool *pool, struct dmaheap_class *cls)
+{
+    if (cls->count >= pool->cap) {
+        fprintf(stderr, "dmaheap_pool: cap %u reached for %zu byte buffers\n", pool->cap, cls->size);
+        return NULL;
+    }
+
+    struct dmaheap_buf *b = calloc(1, sizeof(*b));
+    if (!b) { perror("calloc dmaheap_buf"); return NULL; }
+
+    struct dma_heap_allocation_data alloc;
+    memset(&alloc, 0, sizeof(alloc));
+    alloc.len = cls->size;
+    alloc.fd_flags = O_RDWR | O_CLOEXEC;
+
+    int r;
+    do { r = ioctl(pool->heap_fd, DMA_HEAP_IOCTL_ALLOC, &alloc); } while (r == -1 && errno == EINTR);
+    if (r < 0) {
+        perror("DMA_HEAP_IOCTL_ALLOC");
+        free(b);
+        return NULL;
+    }
+
+    // MAP_POPULATE takes the page faults now instead of on the first frame
+    b->addr = mmap(NULL, cls->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, (int)alloc.fd, 0);
+    if (b->addr == MAP_FAILED) {
+        perror("mmap dmabuf");
+        close((int)alloc.fd);
+        free(b);
+        return NULL;
+    }
+
+    b->fd = (int)alloc.fd;
+    b->size = cls->size;
+    b->cls = cls;
+    cls->count++;
+    return b;
+}
+
+// Preallocate and map n buffers of the given size.
+static inline int dmaheap_pool_reserve(struct dmaheap_pool *pool, size_t size, unsigned n)
+{
+    struct dmaheap_class *cls = dmaheap_pool_class(pool, size);
+    if (!cls)
+        return -1;
+
+    while (cls->count < n) {
+        struct dmaheap_buf *b = dmaheap_pool_grow(pool, cls);
+        if (!b)
+            return -1;
+        b->next = cls->free;
+        cls->free = b;
+    }
+    return 0;
+}
+
+// Take a buffer of exactly `size` bytes; grows the class on demand up to the cap.
+static inline struct dmaheap_buf *dmaheap_pool_get(struct dmaheap_pool *pool, size_t size)
+{
+    struct dmaheap_class *cls = dmaheap_pool_class(pool, size);
+    if (!cls)
+        return NULL;
+
+    struct dmaheap_buf *b = cls->free;
+    if (b) {
+        cls->free = b->next;
+        b->next = NULL;
+        return b;
+    }
+    return dmaheap_pool_grow(pool, cls);
+}
+
+static inline void dmaheap_pool_put(struct dmaheap_buf *b)
+{
+    b->next = b->cls->free;
+    b->cls->free = b;
+}
+
+// Only idle buffers are released: put everything back before destroying.
+static inline void dmaheap_pool_destroy(struct dmaheap_pool *pool)
+{
+    for (unsigned i = 0; i < pool->nclasses; i++) {
+        struct dmaheap_buf *b = pool->classes[i].free;
+        while (b) {
+            struct dmaheap_buf *next = b->next;
+            munmap(b->addr, b->size);
+            close(b->fd);
+            free(b);
+            b = next;
+        }
+        pool->classes[i].free = NULL;
+        pool->classes[i].count = 0;
+    }
+    pool->nclasses = 0;
+
+    if (pool->heap_fd >= 0)
+        close(pool->heap_fd);
+    pool->heap_fd = -1;
+}
+
+// Bracket CPU access to a dmabuf. The apps only ever write OUTPUT frames, so they ask for a
+// WRITE window: on non-coherent systems that is a cache clean at END and no invalidate at
+// START, instead of both for RW.
+static inline int dmabuf_sync(int dmabuf_fd, uint64_t flags)
+{
+    struct dma_buf_sync sync = { .flags = flags };
+    int r;
+
+    do { r = ioctl(dmabuf_fd, DMA_BUF_IOCTL_SYNC, &sync); } while (r == -1 && errno == EINTR);
+    if (r < 0) {
+        perror("DMA_BUF_IOCTL_SYNC");
+        return -1;
+    }
+    return 0;
+}
+
+#endif // DMAHEAP_POOL_H
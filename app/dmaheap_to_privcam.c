@@ -14,6 +14,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "dmaheap_pool.h"
+#include "pcraw.h"
+
 static int xioctl(int fd, unsigned long req, void *arg)
 {
     int r;
@@ -23,42 +26,6 @@ static int xioctl(int fd, unsigned long req, void *arg)
     return r;
 }
 
-static int dmabuf_sync(int dmabuf_fd, int start)  // start=1 BEGIN, start=0 END
-{
-    struct dma_buf_sync sync;
-    memset(&sync, 0, sizeof(sync));
-    sync.flags = DMA_BUF_SYNC_RW | (start ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END);
-    if (xioctl(dmabuf_fd, DMA_BUF_IOCTL_SYNC, &sync) < 0) {
-        perror("DMA_BUF_IOCTL_SYNC");
-        return -1;
-    }
-    return 0;
-}
-
-static int alloc_dmabuf_from_heap(const char *heap_path, size_t size)
-{
-    int heap_fd = open(heap_path, O_RDONLY | O_CLOEXEC);
-    if (heap_fd < 0) {
-        perror("open /dev/dma_heap/system");
-        return -1;
-    }
-
-    struct dma_heap_allocation_data alloc;
-    memset(&alloc, 0, sizeof(alloc));
-    alloc.len = size;
-    alloc.fd_flags = O_RDWR | O_CLOEXEC;
-    alloc.heap_flags = 0;
-
-    if (xioctl(heap_fd, DMA_HEAP_IOCTL_ALLOC, &alloc) < 0) {
-        perror("DMA_HEAP_IOCTL_ALLOC");
-        close(heap_fd);
-        return -1;
-    }
-
-    close(heap_fd);
-    return (int)alloc.fd; // dmabuf fd
-}
-
 static int read_exact(int fd, void *dst, size_t len)
 {
     size_t off = 0;
@@ -79,7 +46,9 @@ struct mmap_buf {
     size_t len;
 };
 
-static int set_fmt(int vfd, enum v4l2_buf_type type, uint32_t w, uint32_t h, uint32_t fourcc)
+// On success *out (if given) holds the format the driver settled on, padding included
+static int set_fmt(int vfd, enum v4l2_buf_type type, uint32_t w, uint32_t h, uint32_t fourcc,
+                   struct v4l2_pix_format *out)
 {
     struct v4l2_format fmt;
     memset(&fmt, 0, sizeof(fmt));
@@ -99,6 +68,8 @@ static int set_fmt(int vfd, enum v4l2_buf_type type, uint32_t w, uint32_t h, uin
         return -1;
     }
 
+    if (out)
+        *out = fmt.fmt.pix;
     return 0;
 }
 
@@ -160,7 +131,8 @@ static int qbuf_capture(int vfd, unsigned int index)
     return 0;
 }
 
-static int qbuf_output_dmabuf(int vfd, unsigned int index, int dmabuf_fd, size_t bytesused)
+static int qbuf_output_dmabuf(int vfd, unsigned int index, int dmabuf_fd, size_t bytesused,
+                              const struct timeval *timestamp)
 {
     struct v4l2_buffer b;
     memset(&b, 0, sizeof(b));
@@ -169,6 +141,7 @@ static int qbuf_output_dmabuf(int vfd, unsigned int index, int dmabuf_fd, size_t
     b.index = index;
     b.m.fd = dmabuf_fd;
     b.bytesused = (unsigned int)bytesused;
+    b.timestamp = *timestamp;
 
     if (xioctl(vfd, VIDIOC_QBUF, &b) < 0) {
         perror("VIDIOC_QBUF (out dmabuf)");
@@ -201,47 +174,89 @@ int main(int argc, char **argv)
     const char *heap_path = "/dev/dma_heap/system";
     const char *in_path = (argc > 1) ? argv[1] : "in.yuyv";
     const char *out_path = (argc > 2) ? argv[2] : "out.yuyv";
+    const uint64_t in_frame = (argc > 3) ? strtoull(argv[3], NULL, 0) : 0;
 
-    const uint32_t W = 640, H = 480;
+    // A pcraw input carries its own geometry; a headerless dump is 640x480 YUYV
+    uint32_t W = 640, H = 480;
     const uint32_t FOURCC = V4L2_PIX_FMT_YUYV;
-    const size_t FRAME_SZ = (size_t)W * (size_t)H * 2;
+    struct pcraw in_c = { .fd = -1 };
+    int in_is_pcraw = pcraw_probe(in_path);
+
+    if (in_is_pcraw) {
+        if (pcraw_open(&in_c, in_path) < 0) return 1;
+        if (in_c.hdr->fourcc != FOURCC || in_c.hdr->num_planes != 1) {
+            fprintf(stderr, "%s: expected single-plane YUYV\n", in_path);
+            return 1;
+        }
+        W = in_c.hdr->width;
+        H = in_c.hdr->height;
+    }
 
     printf("[MODE] dma-heap system -> DMABUF -> privcam\n");
     printf("Input:  %s\n", in_path);
     printf("Output: %s\n", out_path);
     printf("Dev:    %s\n", privcam_dev);
     printf("Heap:   %s\n", heap_path);
-    printf("Frame:  %ux%u YUYV (%zu bytes)\n", W, H, FRAME_SZ);
 
     int vfd = open(privcam_dev, O_RDWR | O_CLOEXEC);
     if (vfd < 0) { perror("open privcam"); return 1; }
 
     // Set both formats (privcam supports same fmt on both in your driver)
-    if (set_fmt(vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT,  W, H, FOURCC) < 0) return 1;
-    if (set_fmt(vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE, W, H, FOURCC) < 0) return 1;
+    struct v4l2_pix_format cap_fmt;
+    if (set_fmt(vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT,  W, H, FOURCC, NULL) < 0) return 1;
+    if (set_fmt(vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE, W, H, FOURCC, &cap_fmt) < 0) return 1;
+
+    // privcam may pad rows, so the frame is sized by what it reported, not W * 2
+    const size_t FRAME_SZ = cap_fmt.sizeimage;
+    printf("Frame:  %ux%u YUYV (bpl %u, %zu bytes)\n", W, H, cap_fmt.bytesperline, FRAME_SZ);
 
-    // Allocate one dmabuf for OUTPUT
-    int dmabuf_fd = alloc_dmabuf_from_heap(heap_path, FRAME_SZ);
-    if (dmabuf_fd < 0) return 1;
+    // OUTPUT dmabufs come from a pool: heap fd stays open, buffers are premapped
+    const unsigned int out_count = 1;
+    struct dmaheap_pool pool;
+    if (dmaheap_pool_init(&pool, heap_path, out_count) < 0) return 1;
+    if (dmaheap_pool_reserve(&pool, FRAME_SZ, out_count) < 0) return 1;
 
-    void *dmabuf_map = mmap(NULL, FRAME_SZ, PROT_READ | PROT_WRITE, MAP_SHARED, dmabuf_fd, 0);
-    if (dmabuf_map == MAP_FAILED) { perror("mmap dmabuf"); return 1; }
+    struct dmaheap_buf *in_buf = dmaheap_pool_get(&pool, FRAME_SZ);
+    if (!in_buf) return 1;
+    int dmabuf_fd = in_buf->fd;
+    void *dmabuf_map = in_buf->addr;
 
     // Load disk file into dmabuf
-    int infd = open(in_path, O_RDONLY | O_CLOEXEC);
-    if (infd < 0) { perror("open input"); return 1; }
+    struct timeval in_ts = { 0, 0 };
+    if (in_is_pcraw) {
+        void *frame;
+        const struct pcraw_index *e;
+        if (pcraw_map_frame(&in_c, in_frame, &frame, &e) < 0) return 1;
+        if (pcraw_plane_bytes(&in_c, e, 0) < FRAME_SZ) {
+            fprintf(stderr, "%s frame %llu holds %u bytes, need %zu\n",
+                    in_path, (unsigned long long)in_frame, pcraw_plane_bytes(&in_c, e, 0), FRAME_SZ);
+            return 1;
+        }
 
-    if (dmabuf_sync(dmabuf_fd, 1) < 0) return 1;
-    if (read_exact(infd, dmabuf_map, FRAME_SZ) < 0) {
-        fprintf(stderr, "Failed to read %zu bytes from %s (file too small?)\n", FRAME_SZ, in_path);
-        return 1;
-    }
-    if (dmabuf_sync(dmabuf_fd, 0) < 0) return 1;
+        if (dmabuf_sync(dmabuf_fd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE) < 0) return 1;
+        memcpy(dmabuf_map, (uint8_t *)frame + in_c.hdr->plane_offset[0], FRAME_SZ);
+        if (dmabuf_sync(dmabuf_fd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE) < 0) return 1;
+
+        in_ts.tv_sec = (time_t)(e->timestamp_ns / 1000000000ull);
+        in_ts.tv_usec = (suseconds_t)(e->timestamp_ns % 1000000000ull / 1000);
+        pcraw_unmap_frame(&in_c, frame);
+        pcraw_close(&in_c);
+    } else {
+        int infd = open(in_path, O_RDONLY | O_CLOEXEC);
+        if (infd < 0) { perror("open input"); return 1; }
+
+        if (dmabuf_sync(dmabuf_fd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE) < 0) return 1;
+        if (read_exact(infd, dmabuf_map, FRAME_SZ) < 0) {
+            fprintf(stderr, "Failed to read %zu bytes from %s (file too small?)\n", FRAME_SZ, in_path);
+            return 1;
+        }
+        if (dmabuf_sync(dmabuf_fd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE) < 0) return 1;
 
-    close(infd);
+        close(infd);
+    }
 
     // OUTPUT: request queue slots for DMABUF
-    if (reqbufs(vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT, V4L2_MEMORY_DMABUF, 1) < 0) return 1;
+    if (reqbufs(vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT, V4L2_MEMORY_DMABUF, out_count) < 0) return 1;
 
     // CAPTURE: request MMAP buffers
     const unsigned int cap_count = 2;
@@ -257,7 +272,7 @@ int main(int argc, char **argv)
     }
 
     // Queue OUTPUT buffer (dmabuf fd)
-    if (qbuf_output_dmabuf(vfd, 0, dmabuf_fd, FRAME_SZ) < 0) return 1;
+    if (qbuf_output_dmabuf(vfd, 0, dmabuf_fd, FRAME_SZ, &in_ts) < 0) return 1;
 
     // Stream ON: CAPTURE then OUTPUT (either order usually ok; this is common)
     if (stream_on(vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE) < 0) return 1;
@@ -287,19 +302,32 @@ int main(int argc, char **argv)
 
     printf("CAPTURE dq: index=%u bytesused=%u\n", cap_dq.index, cap_dq.bytesused);
 
-    int outfd = open(out_path, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
-    if (outfd < 0) { perror("open out"); return 1; }
-
     if (cap_dq.bytesused > cap[cap_dq.index].len) {
         fprintf(stderr, "bytesused bigger than buffer!? (%u > %zu)\n", cap_dq.bytesused, cap[cap_dq.index].len);
         return 1;
     }
 
-    if (write(outfd, cap[cap_dq.index].addr, cap_dq.bytesused) != (ssize_t)cap_dq.bytesused) {
-        perror("write out");
-        return 1;
+    if (pcraw_path(out_path)) {
+        struct pcraw out_c;
+        const void *planes[1] = { cap[cap_dq.index].addr };
+
+        if (pcraw_create(&out_c, out_path, W, H, FOURCC, 1, &cap_fmt.bytesperline, &cap_fmt.sizeimage, 1) < 0)
+            return 1;
+        if (pcraw_append(&out_c, planes, &cap_dq.bytesused,
+                         (uint64_t)cap_dq.timestamp.tv_sec * 1000000000ull +
+                         (uint64_t)cap_dq.timestamp.tv_usec * 1000ull, cap_dq.sequence) < 0)
+            return 1;
+        pcraw_close(&out_c);
+    } else {
+        int outfd = open(out_path, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+        if (outfd < 0) { perror("open out"); return 1; }
+
+        if (write(outfd, cap[cap_dq.index].addr, cap_dq.bytesused) != (ssize_t)cap_dq.bytesused) {
+            perror("write out");
+            return 1;
+        }
+        close(outfd);
     }
-    close(outfd);
 
     // Stream OFF
     stream_off(vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT);
@@ -310,8 +338,8 @@ int main(int argc, char **argv)
         if (cap[i].addr && cap[i].addr != MAP_FAILED)
             munmap(cap[i].addr, cap[i].len);
     }
-    munmap(dmabuf_map, FRAME_SZ);
-    close(dmabuf_fd);
+    dmaheap_pool_put(in_buf);
+    dmaheap_pool_destroy(&pool);
     close(vfd);
 
     printf("Wrote %s\n", out_path);
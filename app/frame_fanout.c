@@ -0,0 +1,580 @@
+// frame_fanout.c
+// Share privcam CAPTURE frames with several local processes without copying them.
+//
+//   frame_fanout -l /tmp/privcam.sock [-s /dev/video0] [-d /dev/video2] [-S WxH] [-b bufs]
+//                [-q max_inflight] [-p skip|disconnect]
+//   frame_fanout -c /tmp/privcam.sock [-n frames] [-D delay_us] [out.yuyv]
+//
+// Server (-l): privcam is fed by an in-kernel linked source (see linked_capture.c), so the only
+// per-frame work is CAPTURE DQBUF/QBUF. Every CAPTURE buffer is exported once with VIDIOC_EXPBUF.
+// A subscriber connecting to the SOCK_SEQPACKET socket gets a hello with the format and all of
+// those dma-buf fds in one SCM_RIGHTS message; after that a frame is announced by buffer index
+// only, and the subscriber answers with a release for that index once it is done reading.
+// A buffer goes back to privcam when the last subscriber that got it has released it.
+//
+// Slow subscribers never hold up the camera: each one may hold at most max_inflight frames
+// (default 2). A frame that would exceed that, or that does not fit in its socket, is skipped
+// for that subscriber. With -p disconnect a subscriber that skips more than 30 frames in a row
+// is dropped and everything it holds is released.
+//
+// Client (-c): receives the fds, maps them, and for every frame checksums it (or writes it out),
+// optionally sleeps to play a slow consumer, and releases it.
+//
+// gcc -O2 -Wall -Wextra -o frame_fanout frame_fanout.c
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../ratsv4l2_cam/privcam_source.h"
+
+#define FANOUT_MAX_BUFS     32
+#define FANOUT_MAX_SUBS     16
+#define FANOUT_MAX_SKIPS    30          // -p disconnect: consecutive skips before a drop
+
+enum { MSG_HELLO = 1, MSG_FRAME, MSG_RELEASE };
+
+struct fanout_hello {
+    uint32_t type;
+    uint32_t width, height, fourcc;
+    uint32_t nplanes, nbufs;            // followed by nbufs * nplanes fds, buffer-major
+    uint32_t bytesperline[3];
+    uint32_t sizeimage[3];
+};
+
+struct fanout_frame {
+    uint32_t type;
+    uint32_t index;
+    uint32_t sequence;
+    uint32_t reserved;
+    uint64_t timestamp_ns;
+    uint32_t bytesused[3];
+};
+
+struct fanout_release {
+    uint32_t type;
+    uint32_t index;
+};
+
+struct subscriber {
+    int fd;                             // -1 when the slot is free
+    uint32_t held;                      // bit i: holds a reference on buffer i
+    unsigned inflight;
+    unsigned skips;                     // consecutive skipped frames
+    unsigned long sent, skipped;
+};
+
+struct fanout {
+    int vfd, sfd, lfd;
+    unsigned nbufs, nplanes;
+    unsigned max_inflight;
+    int drop_slow;
+    unsigned refs[FANOUT_MAX_BUFS];     // subscribers still holding each dequeued buffer
+    int dmabuf[FANOUT_MAX_BUFS][3];
+    struct fanout_hello hello;
+    struct subscriber subs[FANOUT_MAX_SUBS];
+};
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+    int r;
+    do { r = ioctl(fd, req, arg); } while (r == -1 && errno == EINTR);
+    return r;
+}
+
+static void die(const char *msg)
+{
+    perror(msg);
+    exit(1);
+}
+
+static uint32_t reqbufs(int fd, enum v4l2_buf_type type, uint32_t count)
+{
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = type;
+    req.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(fd, VIDIOC_REQBUFS, &req) == -1)
+        die("VIDIOC_REQBUFS");
+    if (req.count < 1 || req.count > FANOUT_MAX_BUFS) {
+        fprintf(stderr, "REQBUFS returned count=%u\n", req.count);
+        exit(1);
+    }
+    return req.count;
+}
+
+static void stream(int fd, enum v4l2_buf_type type, int on)
+{
+    if (xioctl(fd, on ? VIDIOC_STREAMON : VIDIOC_STREAMOFF, &type) == -1)
+        die(on ? "VIDIOC_STREAMON" : "VIDIOC_STREAMOFF");
+}
+
+static void qbuf_capture(struct fanout *f, unsigned index)
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+    memset(&b, 0, sizeof(b));
+    memset(planes, 0, sizeof(planes));
+    b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    b.memory = V4L2_MEMORY_MMAP;
+    b.index = index;
+    b.length = f->nplanes;
+    b.m.planes = planes;
+    if (xioctl(f->vfd, VIDIOC_QBUF, &b) == -1) die("VIDIOC_QBUF cap");
+}
+
+static int export_plane(int vfd, unsigned index, unsigned plane)
+{
+    struct v4l2_exportbuffer exp;
+    memset(&exp, 0, sizeof(exp));
+    exp.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    exp.index = index;
+    exp.plane = plane;
+    exp.flags = O_RDONLY | O_CLOEXEC;
+    if (xioctl(vfd, VIDIOC_EXPBUF, &exp) == -1) die("VIDIOC_EXPBUF");
+    return exp.fd;
+}
+
+// ---- server ----
+
+static void unref(struct fanout *f, unsigned index)
+{
+    if (--f->refs[index] == 0)
+        qbuf_capture(f, index);
+}
+
+static void drop_subscriber(struct fanout *f, struct subscriber *s, const char *why)
+{
+    fprintf(stderr, "subscriber %d %s: %lu frames sent, %lu skipped\n",
+            s->fd, why, s->sent, s->skipped);
+
+    for (unsigned i = 0; i < f->nbufs; i++)
+        if (s->held & (1u << i))
+            unref(f, i);
+    close(s->fd);
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+}
+
+static void accept_subscriber(struct fanout *f)
+{
+    int fd = accept4(f->lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        if (errno != EAGAIN && errno != EINTR) perror("accept");
+        return;
+    }
+
+    struct subscriber *s = NULL;
+    for (unsigned i = 0; i < FANOUT_MAX_SUBS && !s; i++)
+        if (f->subs[i].fd < 0) s = &f->subs[i];
+    if (!s) {
+        fprintf(stderr, "too many subscribers, refusing one\n");
+        close(fd);
+        return;
+    }
+
+    // All buffer fds go over once; per-frame messages then carry only an index
+    const unsigned nfds = f->nbufs * f->nplanes;
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * FANOUT_MAX_BUFS * 3)];
+        struct cmsghdr align;
+    } ctl;
+    struct iovec iov = { .iov_base = &f->hello, .iov_len = sizeof(f->hello) };
+    struct msghdr msg = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = ctl.buf, .msg_controllen = CMSG_SPACE(sizeof(int) * nfds),
+    };
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    int *fds = (int *)CMSG_DATA(cm);
+    for (unsigned i = 0; i < f->nbufs; i++)
+        for (unsigned p = 0; p < f->nplanes; p++)
+            fds[i * f->nplanes + p] = f->dmabuf[i][p];
+
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(f->hello)) {
+        perror("send hello");
+        close(fd);
+        return;
+    }
+
+    memset(s, 0, sizeof(*s));
+    s->fd = fd;
+    fprintf(stderr, "subscriber %d connected\n", fd);
+}
+
+static void read_releases(struct fanout *f, struct subscriber *s)
+{
+    for (;;) {
+        struct fanout_release r;
+        ssize_t n = recv(s->fd, &r, sizeof(r), MSG_DONTWAIT);
+
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+        if (n <= 0) { drop_subscriber(f, s, "disconnected"); return; }
+
+        // A release for a buffer it does not hold would requeue a buffer someone else is reading
+        if (n != sizeof(r) || r.type != MSG_RELEASE || r.index >= f->nbufs || !(s->held & (1u << r.index))) {
+            drop_subscriber(f, s, "sent a bad release");
+            return;
+        }
+        s->held &= ~(1u << r.index);
+        s->inflight--;
+        unref(f, r.index);
+    }
+}
+
+static void distribute(struct fanout *f)
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+    memset(&b, 0, sizeof(b));
+    memset(planes, 0, sizeof(planes));
+    b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    b.memory = V4L2_MEMORY_MMAP;
+    b.length = f->nplanes;
+    b.m.planes = planes;
+    if (xioctl(f->vfd, VIDIOC_DQBUF, &b) == -1) {
+        if (errno == EAGAIN) return;
+        die("VIDIOC_DQBUF cap");
+    }
+    if (b.flags & V4L2_BUF_FLAG_ERROR) {
+        qbuf_capture(f, b.index);
+        return;
+    }
+
+    struct fanout_frame fr;
+    memset(&fr, 0, sizeof(fr));
+    fr.type = MSG_FRAME;
+    fr.index = b.index;
+    fr.sequence = b.sequence;
+    fr.timestamp_ns = (uint64_t)b.timestamp.tv_sec * 1000000000ull + (uint64_t)b.timestamp.tv_usec * 1000ull;
+    for (unsigned p = 0; p < f->nplanes; p++)
+        fr.bytesused[p] = planes[p].bytesused;
+
+    // Hold a reference for the loop itself so a subscriber cannot requeue the buffer under us
+    f->refs[b.index] = 1;
+
+    for (unsigned i = 0; i < FANOUT_MAX_SUBS; i++) {
+        struct subscriber *s = &f->subs[i];
+        if (s->fd < 0) continue;
+
+        ssize_t sent = -1;
+        if (s->inflight < f->max_inflight)
+            sent = send(s->fd, &fr, sizeof(fr), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent == (ssize_t)sizeof(fr)) {
+            f->refs[b.index]++;
+            s->held |= 1u << b.index;
+            s->inflight++;
+            s->sent++;
+            s->skips = 0;
+            continue;
+        }
+
+        if (sent < 0 && s->inflight < f->max_inflight && errno != EAGAIN) {
+            drop_subscriber(f, s, "disconnected");
+            continue;
+        }
+        s->skipped++;
+        if (++s->skips > FANOUT_MAX_SKIPS && f->drop_slow)
+            drop_subscriber(f, s, "dropped as too slow");
+    }
+
+    unref(f, b.index);
+}
+
+static int run_server(const char *sock_path, const char *src_dev, const char *pc_dev,
+                      uint32_t w, uint32_t h, unsigned nbufs, struct fanout *f)
+{
+    // ---- source: configured and primed once, then left alone ----
+    f->sfd = open(src_dev, O_RDWR | O_CLOEXEC);
+    if (f->sfd < 0) die("open source");
+
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = w;
+    fmt.fmt.pix.height = h;
+    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    if (xioctl(f->sfd, VIDIOC_S_FMT, &fmt) == -1) die("source VIDIOC_S_FMT");
+    w = fmt.fmt.pix.width;
+    h = fmt.fmt.pix.height;
+
+    uint32_t scount = reqbufs(f->sfd, V4L2_BUF_TYPE_VIDEO_CAPTURE, nbufs);
+    for (uint32_t i = 0; i < scount; i++) {
+        struct v4l2_buffer b;
+        memset(&b, 0, sizeof(b));
+        b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        b.memory = V4L2_MEMORY_MMAP;
+        b.index = i;
+        if (xioctl(f->sfd, VIDIOC_QBUF, &b) == -1) die("source VIDIOC_QBUF");
+    }
+
+    // ---- privcam: CAPTURE only, fed by the source, every buffer exported ----
+    f->vfd = open(pc_dev, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (f->vfd < 0) die("open privcam");
+
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    fmt.fmt.pix_mp.width = w;
+    fmt.fmt.pix_mp.height = h;
+    fmt.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_YUYV;
+    fmt.fmt.pix_mp.num_planes = 1;
+    if (xioctl(f->vfd, VIDIOC_S_FMT, &fmt) == -1) die("privcam VIDIOC_S_FMT cap");
+
+    int nr = privcam_video_node_number(src_dev);
+    if (nr < 0 || privcam_set_source_node(f->vfd, nr) < 0) exit(1);
+
+    f->nplanes = fmt.fmt.pix_mp.num_planes;
+    f->nbufs = reqbufs(f->vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, nbufs);
+    for (unsigned i = 0; i < f->nbufs; i++) {
+        for (unsigned p = 0; p < f->nplanes; p++)
+            f->dmabuf[i][p] = export_plane(f->vfd, i, p);
+        qbuf_capture(f, i);
+    }
+
+    f->hello.type = MSG_HELLO;
+    f->hello.width = w;
+    f->hello.height = h;
+    f->hello.fourcc = fmt.fmt.pix_mp.pixelformat;
+    f->hello.nplanes = f->nplanes;
+    f->hello.nbufs = f->nbufs;
+    for (unsigned p = 0; p < f->nplanes; p++) {
+        f->hello.bytesperline[p] = fmt.fmt.pix_mp.plane_fmt[p].bytesperline;
+        f->hello.sizeimage[p] = fmt.fmt.pix_mp.plane_fmt[p].sizeimage;
+    }
+
+    // ---- subscribers ----
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(sock_path) >= sizeof(addr.sun_path)) { fprintf(stderr, "socket path too long\n"); return 1; }
+    strcpy(addr.sun_path, sock_path);
+    unlink(sock_path);
+
+    f->lfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (f->lfd < 0) die("socket");
+    if (bind(f->lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("bind");
+    if (listen(f->lfd, FANOUT_MAX_SUBS) < 0) die("listen");
+
+    stream(f->vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, 1);
+    stream(f->sfd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 1);
+
+    fprintf(stderr, "Serving %s (video%d) via %s on %s, %ux%u YUYV, %u buffers, max %u in flight per subscriber\n",
+            src_dev, nr, pc_dev, sock_path, w, h, f->nbufs, f->max_inflight);
+
+    while (!stop) {
+        struct pollfd pfd[2 + FANOUT_MAX_SUBS];
+        struct subscriber *owner[2 + FANOUT_MAX_SUBS];
+        unsigned n = 0;
+
+        pfd[n++] = (struct pollfd){ .fd = f->vfd, .events = POLLIN };
+        pfd[n++] = (struct pollfd){ .fd = f->lfd, .events = POLLIN };
+        for (unsigned i = 0; i < FANOUT_MAX_SUBS; i++) {
+            if (f->subs[i].fd < 0) continue;
+            owner[n] = &f->subs[i];
+            pfd[n++] = (struct pollfd){ .fd = f->subs[i].fd, .events = POLLIN };
+        }
+
+        if (poll(pfd, n, 1000) < 0) {
+            if (errno == EINTR) continue;
+            die("poll");
+        }
+
+        // Releases first, so the buffers they free can take this round's frame
+        for (unsigned i = 2; i < n; i++)
+            if (pfd[i].revents && owner[i]->fd == pfd[i].fd)
+                read_releases(f, owner[i]);
+        if (pfd[0].revents & POLLIN)
+            distribute(f);
+        if (pfd[1].revents & POLLIN)
+            accept_subscriber(f);
+    }
+
+    for (unsigned i = 0; i < FANOUT_MAX_SUBS; i++)
+        if (f->subs[i].fd >= 0)
+            drop_subscriber(f, &f->subs[i], "closed at shutdown");
+
+    stream(f->sfd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0);
+    privcam_set_source_node(f->vfd, -1);
+    stream(f->vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, 0);
+
+    for (unsigned i = 0; i < f->nbufs; i++)
+        for (unsigned p = 0; p < f->nplanes; p++)
+            close(f->dmabuf[i][p]);
+    close(f->lfd);
+    unlink(sock_path);
+    close(f->vfd);
+    close(f->sfd);
+    return 0;
+}
+
+// ---- client ----
+
+static int run_client(const char *sock_path, unsigned nframes, unsigned delay_us, const char *out_path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(sock_path) >= sizeof(addr.sun_path)) { fprintf(stderr, "socket path too long\n"); return 1; }
+    strcpy(addr.sun_path, sock_path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) die("socket");
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("connect");
+
+    struct fanout_hello hello;
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * FANOUT_MAX_BUFS * 3)];
+        struct cmsghdr align;
+    } ctl;
+    struct iovec iov = { .iov_base = &hello, .iov_len = sizeof(hello) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = ctl.buf, .msg_controllen = sizeof(ctl.buf) };
+
+    if (recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(hello) || hello.type != MSG_HELLO) {
+        fprintf(stderr, "bad hello from server\n");
+        return 1;
+    }
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if (!cm || cm->cmsg_type != SCM_RIGHTS || hello.nbufs > FANOUT_MAX_BUFS || hello.nplanes > 3 ||
+        cm->cmsg_len != CMSG_LEN(sizeof(int) * hello.nbufs * hello.nplanes)) {
+        fprintf(stderr, "hello without the expected buffer fds\n");
+        return 1;
+    }
+
+    // Map every buffer once; frames then arrive as indices into these mappings
+    const int *fds = (const int *)CMSG_DATA(cm);
+    void *map[FANOUT_MAX_BUFS][3];
+    for (unsigned i = 0; i < hello.nbufs; i++) {
+        for (unsigned p = 0; p < hello.nplanes; p++) {
+            int dfd = fds[i * hello.nplanes + p];
+            map[i][p] = mmap(NULL, hello.sizeimage[p], PROT_READ, MAP_SHARED, dfd, 0);
+            if (map[i][p] == MAP_FAILED) die("mmap dmabuf");
+            close(dfd);
+        }
+    }
+
+    FILE *out = NULL;
+    if (out_path) {
+        out = fopen(out_path, "wb");
+        if (!out) die("open output");
+    }
+
+    fprintf(stderr, "Subscribed to %s: %ux%u %.4s, %u buffers\n",
+            sock_path, hello.width, hello.height, (char *)&hello.fourcc, hello.nbufs);
+
+    uint32_t last_seq = 0, gaps = 0;
+    uint64_t sum = 0;
+    for (unsigned n = 0; !stop && (!nframes || n < nframes); n++) {
+        struct fanout_frame fr;
+        ssize_t r = recv(fd, &fr, sizeof(fr), 0);
+        if (r < 0 && errno == EINTR) break;
+        if (r <= 0) { fprintf(stderr, "server went away\n"); break; }
+        if (r != sizeof(fr) || fr.type != MSG_FRAME || fr.index >= hello.nbufs) {
+            fprintf(stderr, "bad frame message\n");
+            return 1;
+        }
+
+        if (n && fr.sequence != last_seq + 1) gaps++;
+        last_seq = fr.sequence;
+
+        for (unsigned p = 0; p < hello.nplanes; p++) {
+            uint32_t len = fr.bytesused[p] < hello.sizeimage[p] ? fr.bytesused[p] : hello.sizeimage[p];
+            const uint64_t *q = map[fr.index][p];
+            if (out) {
+                fwrite(q, 1, len, out);
+            } else {
+                for (uint32_t k = 0; k < len / 8; k++)
+                    sum += q[k];
+            }
+        }
+
+        if (delay_us) usleep(delay_us);
+
+        struct fanout_release rel = { .type = MSG_RELEASE, .index = fr.index };
+        if (send(fd, &rel, sizeof(rel), MSG_NOSIGNAL) != (ssize_t)sizeof(rel)) die("send release");
+
+        if (n && n % 100 == 0)
+            fprintf(stderr, "%u frames, %u sequence gaps, checksum %016llx\n", n, gaps, (unsigned long long)sum);
+    }
+
+    if (out) fclose(out);
+    for (unsigned i = 0; i < hello.nbufs; i++)
+        for (unsigned p = 0; p < hello.nplanes; p++)
+            munmap(map[i][p], hello.sizeimage[p]);
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *listen_path = NULL, *connect_path = NULL;
+    const char *src_dev = "/dev/video0", *pc_dev = "/dev/video2";
+    uint32_t w = 640, h = 480;
+    unsigned nbufs = 8, nframes = 0, delay_us = 0;
+    static struct fanout f;
+    int opt;
+
+    f.max_inflight = 2;
+
+    while ((opt = getopt(argc, argv, "l:c:s:d:S:b:q:p:n:D:")) != -1) {
+        switch (opt) {
+        case 'l': listen_path = optarg; break;
+        case 'c': connect_path = optarg; break;
+        case 's': src_dev = optarg; break;
+        case 'd': pc_dev = optarg; break;
+        case 'S': if (sscanf(optarg, "%ux%u", &w, &h) != 2) goto usage; break;
+        case 'b': nbufs = (unsigned)atoi(optarg); break;
+        case 'q': f.max_inflight = (unsigned)atoi(optarg); break;
+        case 'p':
+            if (!strcmp(optarg, "disconnect")) f.drop_slow = 1;
+            else if (strcmp(optarg, "skip")) goto usage;
+            break;
+        case 'n': nframes = (unsigned)atoi(optarg); break;
+        case 'D': delay_us = (unsigned)atoi(optarg); break;
+        default: goto usage;
+        }
+    }
+    if (!listen_path == !connect_path || !nbufs || !f.max_inflight) goto usage;
+    if (listen_path && optind != argc) goto usage;
+    if (connect_path && optind < argc - 1) goto usage;
+
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (connect_path)
+        return run_client(connect_path, nframes, delay_us, optind < argc ? argv[optind] : NULL);
+
+    for (unsigned i = 0; i < FANOUT_MAX_SUBS; i++)
+        f.subs[i].fd = -1;
+    return run_server(listen_path, src_dev, pc_dev, w, h, nbufs, &f);
+
+usage:
+    fprintf(stderr,
+        "usage: %s -l sock [-s /dev/video0] [-d /dev/video2] [-S WxH] [-b bufs] [-q max_inflight] [-p skip|disconnect]\n"
+        "       %s -c sock [-n frames] [-D delay_us] [out.yuyv]\n", argv[0], argv[0]);
+    return 2;
+}
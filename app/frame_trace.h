@@ -0,0 +1,157 @@
+// frame_trace.h
+// Per-frame glass-to-disk latency trace for the streaming apps. Each frame records five
+// CLOCK_MONOTONIC points (the V4L2 camera timestamp is monotonic too):
+//   cam_ts     camera capture timestamp (carried through privcam by TIMESTAMP_COPY)
+//   cam_dq     camera VIDIOC_DQBUF returned
+//   pc_q       privcam OUTPUT VIDIOC_QBUF issued
+//   pc_dq      privcam CAPTURE VIDIOC_DQBUF returned
+//   wr_done    frame write() to disk completed
+// Records are streamed to a CSV file as they complete; frame_trace_close() prints per-stage
+// percentiles and a log2 histogram of the glass-to-disk latency to stderr.
+
+#ifndef FRAME_TRACE_H
+#define FRAME_TRACE_H
+
+#include <linux/videodev2.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FRAME_TRACE_HIST_BUCKETS 24     // log2(us): 1us .. ~8s
+
+enum {
+    TRACE_CAM_TS,
+    TRACE_CAM_DQ,
+    TRACE_PC_Q,
+    TRACE_PC_DQ,
+    TRACE_WR_DONE,
+    TRACE_NPOINTS,
+};
+
+struct frame_trace_rec {
+    uint32_t seq;
+    uint64_t t[TRACE_NPOINTS];
+};
+
+struct frame_trace {
+    FILE *csv;
+    struct frame_trace_rec *recs;
+    size_t n, cap;
+};
+
+static inline uint64_t trace_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t trace_tv_ns(const struct timeval *tv)
+{
+    return (uint64_t)tv->tv_sec * 1000000000ull + (uint64_t)tv->tv_usec * 1000ull;
+}
+
+// csv_path may be NULL to keep only the in-memory summary
+static inline int frame_trace_open(struct frame_trace *tr, const char *csv_path)
+{
+    memset(tr, 0, sizeof(*tr));
+    if (!csv_path)
+        return 0;
+
+    tr->csv = fopen(csv_path, "w");
+    if (!tr->csv) {
+        perror("open trace");
+        return -1;
+    }
+    fprintf(tr->csv, "seq,cam_ts_ns,cam_dq_ns,pc_qbuf_ns,pc_dqbuf_ns,write_done_ns\n");
+    return 0;
+}
+
+static inline void frame_trace_add(struct frame_trace *tr, const struct frame_trace_rec *r)
+{
+    if (tr->n == tr->cap) {
+        size_t cap = tr->cap ? tr->cap * 2 : 1024;
+        struct frame_trace_rec *recs = realloc(tr->recs, cap * sizeof(*recs));
+        if (!recs)
+            return;
+        tr->recs = recs;
+        tr->cap = cap;
+    }
+    tr->recs[tr->n++] = *r;
+
+    if (tr->csv)
+        fprintf(tr->csv, "%u,%llu,%llu,%llu,%llu,%llu\n", r->seq,
+                (unsigned long long)r->t[TRACE_CAM_TS], (unsigned long long)r->t[TRACE_CAM_DQ],
+                (unsigned long long)r->t[TRACE_PC_Q], (unsigned long long)r->t[TRACE_PC_DQ],
+                (unsigned long long)r->t[TRACE_WR_DONE]);
+}
+
+static inline int frame_trace_cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static inline void frame_trace_stage(const struct frame_trace *tr, const char *name,
+                                     int from, int to, uint64_t *tmp)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < tr->n; i++)
+        if (tr->recs[i].t[from] && tr->recs[i].t[to] >= tr->recs[i].t[from])
+            tmp[n++] = tr->recs[i].t[to] - tr->recs[i].t[from];
+    if (!n)
+        return;
+
+    qsort(tmp, n, sizeof(*tmp), frame_trace_cmp_u64);
+    fprintf(stderr, "  %-16s p50 %9.1f  p99 %9.1f  max %9.1f us\n", name,
+            tmp[n / 2] / 1000.0, tmp[(size_t)(n * 0.99) < n ? (size_t)(n * 0.99) : n - 1] / 1000.0,
+            tmp[n - 1] / 1000.0);
+}
+
+static inline void frame_trace_close(struct frame_trace *tr)
+{
+    if (tr->csv)
+        fclose(tr->csv);
+    tr->csv = NULL;
+
+    uint64_t *tmp = tr->n ? malloc(tr->n * sizeof(*tmp)) : NULL;
+    if (tmp) {
+        fprintf(stderr, "Latency over %zu frames:\n", tr->n);
+        frame_trace_stage(tr, "camera->dqbuf",  TRACE_CAM_TS, TRACE_CAM_DQ,  tmp);
+        frame_trace_stage(tr, "dqbuf->privcam", TRACE_CAM_DQ, TRACE_PC_Q,    tmp);
+        frame_trace_stage(tr, "privcam",        TRACE_PC_Q,   TRACE_PC_DQ,   tmp);
+        frame_trace_stage(tr, "write",          TRACE_PC_DQ,  TRACE_WR_DONE, tmp);
+        frame_trace_stage(tr, "glass-to-disk",  TRACE_CAM_TS, TRACE_WR_DONE, tmp);
+
+        unsigned hist[FRAME_TRACE_HIST_BUCKETS] = { 0 };
+        unsigned peak = 0;
+        for (size_t i = 0; i < tr->n; i++) {
+            const struct frame_trace_rec *r = &tr->recs[i];
+            if (!r->t[TRACE_CAM_TS] || r->t[TRACE_WR_DONE] < r->t[TRACE_CAM_TS])
+                continue;
+            uint64_t us = (r->t[TRACE_WR_DONE] - r->t[TRACE_CAM_TS]) / 1000;
+            unsigned b = 0;
+            while (us > 1 && b < FRAME_TRACE_HIST_BUCKETS - 1) { us >>= 1; b++; }
+            if (++hist[b] > peak) peak = hist[b];
+        }
+
+        fprintf(stderr, "Glass-to-disk histogram:\n");
+        for (unsigned b = 0; b < FRAME_TRACE_HIST_BUCKETS; b++) {
+            if (!hist[b])
+                continue;
+            unsigned bar = peak ? (hist[b] * 50 + peak - 1) / peak : 0;
+            fprintf(stderr, "  <%9lluus %7u ", 2ull << b, hist[b]);
+            for (unsigned k = 0; k < bar; k++) fputc('#', stderr);
+            fputc('\n', stderr);
+        }
+    }
+
+    free(tmp);
+    free(tr->recs);
+    tr->recs = NULL;
+    tr->n = tr->cap = 0;
+}
+
+#endif // FRAME_TRACE_H
@@ -0,0 +1,92 @@
+// hugebuf.h
+// Anonymous frame memory backed by 2 MB pages, for queueing as V4L2_MEMORY_USERPTR.
+// hugebuf_alloc tries, in order:
+//   hugetlb  MAP_HUGETLB | MAP_HUGE_2MB from the reserved pool (vm.nr_hugepages)
+//   thp      a 2 MB aligned anonymous mapping with MADV_HUGEPAGE
+//   4k       plain anonymous pages, when huge pages were not asked for or are unavailable
+// The memory is prefaulted, so neither the pin at the first QBUF nor the first frame pays for
+// page faults. A 4K YUYV frame needs 8 TLB entries instead of ~4000.
+
+#ifndef HUGEBUF_H
+#define HUGEBUF_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+#define HUGEBUF_PAGE (2ul << 20)
+
+enum hugebuf_kind { HUGEBUF_4K, HUGEBUF_THP, HUGEBUF_HUGETLB };
+
+struct hugebuf {
+    void *addr;                     // usable, HUGEBUF_PAGE aligned unless kind == HUGEBUF_4K
+    size_t size;                    // usable length
+    void *map;                      // what munmap gets
+    size_t map_len;
+    enum hugebuf_kind kind;
+};
+
+static inline const char *hugebuf_kind_name(enum hugebuf_kind kind)
+{
+    return kind == HUGEBUF_HUGETLB ? "hugetlb" : kind == HUGEBUF_THP ? "thp" : "4k";
+}
+
+static inline void hugebuf_prefault(struct hugebuf *hb)
+{
+    // One write per 4K page is enough for 4K and THP; hugetlb is already populated
+    for (size_t off = 0; off < hb->size; off += 4096)
+        ((volatile uint8_t *)hb->addr)[off] = 0;
+}
+
+static inline int hugebuf_alloc(struct hugebuf *hb, size_t size, int huge)
+{
+    memset(hb, 0, sizeof(*hb));
+
+    if (huge) {
+        size_t len = (size + HUGEBUF_PAGE - 1) & ~(HUGEBUF_PAGE - 1);
+
+        void *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB | MAP_POPULATE, -1, 0);
+        if (p != MAP_FAILED) {
+            hb->addr = hb->map = p;
+            hb->size = hb->map_len = len;
+            hb->kind = HUGEBUF_HUGETLB;
+            return 0;
+        }
+
+        // No reserved pool: over-allocate so the range can be aligned for THP to back it
+        hb->map_len = len + HUGEBUF_PAGE;
+        hb->map = mmap(NULL, hb->map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (hb->map == MAP_FAILED) { perror("mmap frame memory"); hb->map = NULL; return -1; }
+
+        hb->addr = (void *)(((uintptr_t)hb->map + HUGEBUF_PAGE - 1) & ~(uintptr_t)(HUGEBUF_PAGE - 1));
+        hb->size = len;
+        hb->kind = madvise(hb->addr, len, MADV_HUGEPAGE) == 0 ? HUGEBUF_THP : HUGEBUF_4K;
+        hugebuf_prefault(hb);
+        return 0;
+    }
+
+    hb->map_len = hb->size = (size + 4095) & ~4095ul;
+    hb->map = mmap(NULL, hb->map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (hb->map == MAP_FAILED) { perror("mmap frame memory"); hb->map = NULL; return -1; }
+    hb->addr = hb->map;
+    hb->kind = HUGEBUF_4K;
+    hugebuf_prefault(hb);
+    return 0;
+}
+
+static inline void hugebuf_free(struct hugebuf *hb)
+{
+    if (hb->map) munmap(hb->map, hb->map_len);
+    memset(hb, 0, sizeof(*hb));
+}
+
+#endif // HUGEBUF_H
@@ -0,0 +1,251 @@
+// linked_capture.c
+// Stream a source through privcam with the in-kernel link (ratsv4l2_cam/privcam_link.h).
+//
+//   linked_capture [-s /dev/video0] [-d /dev/video2] [-S WxH] [-n frames] [-b bufs] [out.yuyv|out.pcraw]
+//
+// The source (v4l2_minimal or any capture driver that registers with privcam_link_register) is
+// set up once: S_FMT, REQBUFS, QBUF all, STREAMON. privcam's "Source Node" control binds the
+// context to it, after which the source pushes frames into privcam itself and recycles its own
+// buffers. The only per-frame syscalls left are privcam CAPTURE poll/DQBUF/QBUF, compared to
+// camera DQBUF/QBUF plus privcam OUTPUT QBUF/DQBUF on top of that in cam_to_privcam_dmabuf.
+//
+// gcc -O2 -Wall -Wextra -o linked_capture linked_capture.c
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/sysmacros.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pcraw.h"
+#include "../ratsv4l2_cam/privcam_source.h"
+
+#define LINKED_MAX_BUFS 32
+
+struct mmap_buf {
+    void  *addr;
+    size_t len;
+};
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+    int r;
+    do { r = ioctl(fd, req, arg); } while (r == -1 && errno == EINTR);
+    return r;
+}
+
+static void die(const char *msg)
+{
+    perror(msg);
+    exit(1);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t reqbufs(int fd, enum v4l2_buf_type type, uint32_t count)
+{
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = type;
+    req.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(fd, VIDIOC_REQBUFS, &req) == -1)
+        die("VIDIOC_REQBUFS");
+    if (req.count < 1 || req.count > LINKED_MAX_BUFS) {
+        fprintf(stderr, "REQBUFS returned count=%u\n", req.count);
+        exit(1);
+    }
+    return req.count;
+}
+
+static void stream(int fd, enum v4l2_buf_type type, int on)
+{
+    if (xioctl(fd, on ? VIDIOC_STREAMON : VIDIOC_STREAMOFF, &type) == -1)
+        die(on ? "VIDIOC_STREAMON" : "VIDIOC_STREAMOFF");
+}
+
+static void qbuf_capture(int fd, unsigned index)
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+    memset(&b, 0, sizeof(b));
+    memset(planes, 0, sizeof(planes));
+    b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    b.memory = V4L2_MEMORY_MMAP;
+    b.index = index;
+    b.length = 1;
+    b.m.planes = planes;
+    if (xioctl(fd, VIDIOC_QBUF, &b) == -1) die("VIDIOC_QBUF cap");
+}
+
+int main(int argc, char **argv)
+{
+    const char *src_dev = "/dev/video0", *pc_dev = "/dev/video2", *out_path = NULL;
+    uint32_t w = 640, h = 480, nframes = 300, nbufs = 4;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:d:S:n:b:")) != -1) {
+        switch (opt) {
+        case 's': src_dev = optarg; break;
+        case 'd': pc_dev = optarg; break;
+        case 'S': if (sscanf(optarg, "%ux%u", &w, &h) != 2) goto usage; break;
+        case 'n': nframes = (uint32_t)atoi(optarg); break;
+        case 'b': nbufs = (uint32_t)atoi(optarg); break;
+        default: goto usage;
+        }
+    }
+    if (optind < argc - 1 || !nframes || !nbufs) goto usage;
+    if (optind == argc - 1) out_path = argv[optind];
+
+    // ---- source: configured and primed once, then left alone ----
+    int sfd = open(src_dev, O_RDWR | O_CLOEXEC);
+    if (sfd < 0) die("open source");
+
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = w;
+    fmt.fmt.pix.height = h;
+    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    if (xioctl(sfd, VIDIOC_S_FMT, &fmt) == -1) die("source VIDIOC_S_FMT");
+    w = fmt.fmt.pix.width;
+    h = fmt.fmt.pix.height;
+
+    uint32_t scount = reqbufs(sfd, V4L2_BUF_TYPE_VIDEO_CAPTURE, nbufs);
+    for (uint32_t i = 0; i < scount; i++) {
+        struct v4l2_buffer b;
+        memset(&b, 0, sizeof(b));
+        b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        b.memory = V4L2_MEMORY_MMAP;
+        b.index = i;
+        if (xioctl(sfd, VIDIOC_QBUF, &b) == -1) die("source VIDIOC_QBUF");
+    }
+
+    // ---- privcam: CAPTURE only, fed by the source ----
+    int vfd = open(pc_dev, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (vfd < 0) die("open privcam");
+
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    fmt.fmt.pix_mp.width = w;
+    fmt.fmt.pix_mp.height = h;
+    fmt.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_YUYV;
+    fmt.fmt.pix_mp.num_planes = 1;
+    if (xioctl(vfd, VIDIOC_S_FMT, &fmt) == -1) die("privcam VIDIOC_S_FMT cap");
+    // Recorded frames are privcam's CAPTURE buffers, so their layout is privcam's, not the source's
+    uint32_t size = fmt.fmt.pix_mp.plane_fmt[0].sizeimage;
+    uint32_t bpl = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+
+    int nr = privcam_video_node_number(src_dev);
+    if (nr < 0 || privcam_set_source_node(vfd, nr) < 0) return 1;
+
+    uint32_t ccount = reqbufs(vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, nbufs);
+    struct mmap_buf cap[LINKED_MAX_BUFS];
+    for (uint32_t i = 0; i < ccount; i++) {
+        struct v4l2_buffer b;
+        struct v4l2_plane planes[VIDEO_MAX_PLANES];
+        memset(&b, 0, sizeof(b));
+        memset(planes, 0, sizeof(planes));
+        b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        b.memory = V4L2_MEMORY_MMAP;
+        b.index = i;
+        b.length = 1;
+        b.m.planes = planes;
+        if (xioctl(vfd, VIDIOC_QUERYBUF, &b) == -1) die("VIDIOC_QUERYBUF cap");
+        cap[i].len = planes[0].length;
+        cap[i].addr = mmap(NULL, planes[0].length, PROT_READ, MAP_SHARED, vfd, planes[0].m.mem_offset);
+        if (cap[i].addr == MAP_FAILED) die("mmap cap");
+        qbuf_capture(vfd, i);
+    }
+
+    FILE *raw = NULL;
+    struct pcraw rec;
+    int use_pcraw = out_path && pcraw_path(out_path);
+    if (use_pcraw) {
+        if (pcraw_create(&rec, out_path, w, h, V4L2_PIX_FMT_YUYV, 1, &bpl, &size, nframes) < 0) return 1;
+    } else if (out_path) {
+        raw = fopen(out_path, "wb");
+        if (!raw) die("open output");
+    }
+
+    stream(vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, 1);
+    stream(sfd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 1);
+
+    fprintf(stderr, "Linked %s (video%d) -> %s, %ux%u YUYV, %u frames\n", src_dev, nr, pc_dev, w, h, nframes);
+
+    uint64_t t0 = now_ns(), lat_sum = 0;
+    uint32_t last_seq = 0, gaps = 0;
+
+    for (uint32_t n = 0; n < nframes; ) {
+        struct pollfd pfd = { .fd = vfd, .events = POLLIN };
+        if (poll(&pfd, 1, 2000) <= 0) {
+            fprintf(stderr, "timeout waiting for linked frames (is the source registered with privcam?)\n");
+            return 1;
+        }
+
+        struct v4l2_buffer b;
+        struct v4l2_plane planes[VIDEO_MAX_PLANES];
+        memset(&b, 0, sizeof(b));
+        memset(planes, 0, sizeof(planes));
+        b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        b.memory = V4L2_MEMORY_MMAP;
+        b.length = 1;
+        b.m.planes = planes;
+        if (xioctl(vfd, VIDIOC_DQBUF, &b) == -1) {
+            if (errno == EAGAIN) continue;
+            die("VIDIOC_DQBUF cap");
+        }
+
+        uint64_t ts = (uint64_t)b.timestamp.tv_sec * 1000000000ull + (uint64_t)b.timestamp.tv_usec * 1000ull;
+        lat_sum += now_ns() - ts;
+        if (n && b.sequence != last_seq + 1) gaps++;
+        last_seq = b.sequence;
+
+        if (use_pcraw) {
+            const void *data[1] = { cap[b.index].addr };
+            if (pcraw_append(&rec, data, &planes[0].bytesused, ts, b.sequence) < 0) return 1;
+        } else if (raw) {
+            fwrite(cap[b.index].addr, 1, planes[0].bytesused, raw);
+        }
+
+        qbuf_capture(vfd, b.index);
+        n++;
+    }
+
+    double secs = (now_ns() - t0) / 1e9;
+    fprintf(stderr, "%u frames in %.2fs: %.1f fps, mean source->dqbuf %.1f us, %u sequence gaps\n",
+            nframes, secs, nframes / secs, lat_sum / 1000.0 / nframes, gaps);
+
+    stream(sfd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0);
+    privcam_set_source_node(vfd, -1);
+    stream(vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, 0);
+
+    if (use_pcraw) pcraw_close(&rec);
+    if (raw) fclose(raw);
+    for (uint32_t i = 0; i < ccount; i++)
+        munmap(cap[i].addr, cap[i].len);
+    close(vfd);
+    close(sfd);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-s /dev/video0] [-d /dev/video2] [-S WxH] [-n frames] [-b bufs] [out.yuyv|out.pcraw]\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,481 @@
+// multicam.c
+// Drive many camera -> privcam pipelines from one process.
+//
+//   multicam [-S WxH] [-n frames] [-b bufs] [-t threads] [-o outdir] cam:privcam [cam:privcam ...]
+//   multicam -S 1920x1080 -n 600 -t 2 /dev/video0:/dev/video2 /dev/video4:/dev/video2 ...
+//
+// Each pair is one stream with the same zero-copy path as cam_to_privcam_dmabuf.c (camera MMAP
+// buffers exported with EXPBUF and queued into privcam OUTPUT as DMABUF, privcam CAPTURE MMAP),
+// but nothing ever blocks: every fd is O_NONBLOCK and a stream only moves when epoll says one of
+// its fds is ready. The same privcam node may appear several times; each open is its own context.
+// With -t N the streams are split round-robin over N threads, each with its own epoll set, so a
+// 16-camera box runs in one process with N threads instead of 16 processes.
+//
+// Per stream state machine:
+//   RUNNING   camera frames go into privcam OUTPUT, CAPTURE frames are written out
+//   DRAINING  the frame budget is met; camera frames are dropped and we wait for privcam to
+//             hand back the camera buffers it still holds
+//   DONE      streams off, fds closed, removed from epoll
+// Events: camera readable -> DQBUF camera, QBUF privcam OUTPUT (same index)
+//         privcam readable -> DQBUF CAPTURE, write, QBUF CAPTURE
+//         privcam writable -> DQBUF OUTPUT, QBUF that camera buffer again
+//
+// gcc -O2 -Wall -Wextra -pthread -o multicam multicam.c
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MC_MAX_STREAMS  32
+#define MC_MAX_THREADS  16
+#define MC_MAX_BUFS     16
+
+enum stream_state { ST_RUNNING, ST_DRAINING, ST_DONE };
+
+struct stream {
+    unsigned id;
+    const char *cam_dev, *pc_dev;
+    int cam_fd, pc_fd, out_fd;
+    enum stream_state state;
+
+    uint32_t w, h, sizeimage;
+    unsigned cam_count, cap_count;
+    int dmabuf[MC_MAX_BUFS];
+    struct { void *addr; size_t len; } cap[MC_MAX_BUFS];
+    unsigned in_privcam;            // camera buffers currently queued on privcam OUTPUT
+
+    unsigned target, frames, dropped, errors;
+    uint64_t t_first, t_last;
+};
+
+struct worker {
+    pthread_t thread;
+    int epfd;
+    struct stream *streams[MC_MAX_STREAMS];
+    unsigned nstreams, live;
+};
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+    int r;
+    do { r = ioctl(fd, req, arg); } while (r == -1 && errno == EINTR);
+    return r;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Setup errors name the stream, then fail the whole run: a half-configured box is not useful
+static int fail(const struct stream *s, const char *what)
+{
+    fprintf(stderr, "stream %u (%s -> %s): %s: %s\n", s->id, s->cam_dev, s->pc_dev, what, strerror(errno));
+    return -1;
+}
+
+static int reqbufs(int fd, enum v4l2_buf_type type, enum v4l2_memory mem, unsigned count)
+{
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = type;
+    req.memory = mem;
+    if (xioctl(fd, VIDIOC_REQBUFS, &req) == -1) return -1;
+    if (req.count < 1 || req.count > MC_MAX_BUFS) { errno = ENOBUFS; return -1; }
+    return (int)req.count;
+}
+
+static int stream_onoff(int fd, enum v4l2_buf_type type, int on)
+{
+    return xioctl(fd, on ? VIDIOC_STREAMON : VIDIOC_STREAMOFF, &type);
+}
+
+static int qbuf_cam(struct stream *s, unsigned index)
+{
+    struct v4l2_buffer b;
+    memset(&b, 0, sizeof(b));
+    b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    b.memory = V4L2_MEMORY_MMAP;
+    b.index = index;
+    return xioctl(s->cam_fd, VIDIOC_QBUF, &b);
+}
+
+static int qbuf_cap(struct stream *s, unsigned index)
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+    memset(&b, 0, sizeof(b));
+    memset(planes, 0, sizeof(planes));
+    b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    b.memory = V4L2_MEMORY_MMAP;
+    b.index = index;
+    b.length = 1;
+    b.m.planes = planes;
+    return xioctl(s->pc_fd, VIDIOC_QBUF, &b);
+}
+
+static int qbuf_out(struct stream *s, const struct v4l2_buffer *cam)
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+    memset(&b, 0, sizeof(b));
+    memset(planes, 0, sizeof(planes));
+    b.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    b.memory = V4L2_MEMORY_DMABUF;
+    b.index = cam->index;
+    b.length = 1;
+    b.m.planes = planes;
+    b.timestamp = cam->timestamp;   // privcam copies it to the CAPTURE buffer
+    planes[0].m.fd = s->dmabuf[cam->index];
+    planes[0].bytesused = cam->bytesused ? cam->bytesused : s->sizeimage;
+    return xioctl(s->pc_fd, VIDIOC_QBUF, &b);
+}
+
+static int stream_setup(struct stream *s, unsigned nbufs, const char *outdir)
+{
+    s->cam_fd = open(s->cam_dev, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (s->cam_fd < 0) return fail(s, "open camera");
+    s->pc_fd = open(s->pc_dev, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (s->pc_fd < 0) return fail(s, "open privcam");
+
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = s->w;
+    fmt.fmt.pix.height = s->h;
+    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    if (xioctl(s->cam_fd, VIDIOC_S_FMT, &fmt) == -1) return fail(s, "camera VIDIOC_S_FMT");
+    s->w = fmt.fmt.pix.width;
+    s->h = fmt.fmt.pix.height;
+    s->sizeimage = fmt.fmt.pix.sizeimage;
+    uint32_t bpl = fmt.fmt.pix.bytesperline;
+
+    // privcam takes the camera's stride as is, so padded camera rows need no repack
+    for (int t = 0; t < 2; t++) {
+        memset(&fmt, 0, sizeof(fmt));
+        fmt.type = t ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        fmt.fmt.pix_mp.width = s->w;
+        fmt.fmt.pix_mp.height = s->h;
+        fmt.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_YUYV;
+        fmt.fmt.pix_mp.num_planes = 1;
+        fmt.fmt.pix_mp.plane_fmt[0].bytesperline = t ? 0 : bpl;
+        if (xioctl(s->pc_fd, VIDIOC_S_FMT, &fmt) == -1) return fail(s, "privcam VIDIOC_S_FMT");
+    }
+
+    int n = reqbufs(s->cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, V4L2_MEMORY_MMAP, nbufs);
+    if (n < 0) return fail(s, "camera VIDIOC_REQBUFS");
+    s->cam_count = (unsigned)n;
+
+    for (unsigned i = 0; i < s->cam_count; i++) {
+        struct v4l2_exportbuffer exp;
+        memset(&exp, 0, sizeof(exp));
+        exp.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        exp.index = i;
+        exp.flags = O_CLOEXEC;
+        if (xioctl(s->cam_fd, VIDIOC_EXPBUF, &exp) == -1) return fail(s, "camera VIDIOC_EXPBUF");
+        s->dmabuf[i] = exp.fd;
+    }
+
+    // OUTPUT slots mirror camera buffers one to one, so OUTPUT can never be the bottleneck
+    n = reqbufs(s->pc_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_DMABUF, s->cam_count);
+    if (n < 0 || (unsigned)n < s->cam_count) return fail(s, "privcam OUTPUT VIDIOC_REQBUFS");
+
+    n = reqbufs(s->pc_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_MEMORY_MMAP, nbufs);
+    if (n < 0) return fail(s, "privcam CAPTURE VIDIOC_REQBUFS");
+    s->cap_count = (unsigned)n;
+
+    for (unsigned i = 0; i < s->cap_count; i++) {
+        struct v4l2_buffer b;
+        struct v4l2_plane planes[VIDEO_MAX_PLANES];
+        memset(&b, 0, sizeof(b));
+        memset(planes, 0, sizeof(planes));
+        b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        b.memory = V4L2_MEMORY_MMAP;
+        b.index = i;
+        b.length = 1;
+        b.m.planes = planes;
+        if (xioctl(s->pc_fd, VIDIOC_QUERYBUF, &b) == -1) return fail(s, "VIDIOC_QUERYBUF");
+        s->cap[i].len = planes[0].length;
+        s->cap[i].addr = mmap(NULL, planes[0].length, PROT_READ, MAP_SHARED, s->pc_fd, planes[0].m.mem_offset);
+        if (s->cap[i].addr == MAP_FAILED) { s->cap[i].addr = NULL; return fail(s, "mmap CAPTURE"); }
+        if (qbuf_cap(s, i) == -1) return fail(s, "VIDIOC_QBUF CAPTURE");
+    }
+
+    for (unsigned i = 0; i < s->cam_count; i++)
+        if (qbuf_cam(s, i) == -1) return fail(s, "camera VIDIOC_QBUF");
+
+    if (outdir) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/stream%02u.yuyv", outdir, s->id);
+        s->out_fd = open(path, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+        if (s->out_fd < 0) return fail(s, "open output");
+    }
+
+    if (stream_onoff(s->pc_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, 1) == -1 ||
+        stream_onoff(s->pc_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, 1) == -1)
+        return fail(s, "privcam VIDIOC_STREAMON");
+    if (stream_onoff(s->cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 1) == -1)
+        return fail(s, "camera VIDIOC_STREAMON");
+    return 0;
+}
+
+static void stream_teardown(struct stream *s)
+{
+    if (s->cam_fd >= 0) stream_onoff(s->cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0);
+    if (s->pc_fd >= 0) {
+        stream_onoff(s->pc_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, 0);
+        stream_onoff(s->pc_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, 0);
+    }
+    for (unsigned i = 0; i < MC_MAX_BUFS; i++) {
+        if (s->cap[i].addr) munmap(s->cap[i].addr, s->cap[i].len);
+        if (s->dmabuf[i] >= 0) close(s->dmabuf[i]);
+    }
+    if (s->out_fd >= 0) close(s->out_fd);
+    if (s->pc_fd >= 0) close(s->pc_fd);
+    if (s->cam_fd >= 0) close(s->cam_fd);
+    s->cam_fd = s->pc_fd = s->out_fd = -1;
+    memset(s->cap, 0, sizeof(s->cap));
+    for (unsigned i = 0; i < MC_MAX_BUFS; i++) s->dmabuf[i] = -1;
+}
+
+static void stream_finish(struct worker *wk, struct stream *s)
+{
+    epoll_ctl(wk->epfd, EPOLL_CTL_DEL, s->cam_fd, NULL);
+    epoll_ctl(wk->epfd, EPOLL_CTL_DEL, s->pc_fd, NULL);
+    stream_teardown(s);
+    s->state = ST_DONE;
+    wk->live--;
+}
+
+// ---- event handlers; each drains its queue until EAGAIN (epoll is level-triggered) ----
+
+static void on_camera(struct stream *s)
+{
+    struct v4l2_buffer b;
+
+    for (;;) {
+        memset(&b, 0, sizeof(b));
+        b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        b.memory = V4L2_MEMORY_MMAP;
+        if (xioctl(s->cam_fd, VIDIOC_DQBUF, &b) == -1) {
+            if (errno != EAGAIN) s->errors++;
+            return;
+        }
+
+        if (s->state == ST_RUNNING && !(b.flags & V4L2_BUF_FLAG_ERROR) && qbuf_out(s, &b) == 0) {
+            s->in_privcam++;
+            continue;
+        }
+        if (s->state == ST_RUNNING) s->dropped++;
+        qbuf_cam(s, b.index);
+    }
+}
+
+static void on_privcam_capture(struct stream *s)
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+
+    while (s->state != ST_DONE) {
+        memset(&b, 0, sizeof(b));
+        memset(planes, 0, sizeof(planes));
+        b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        b.memory = V4L2_MEMORY_MMAP;
+        b.length = 1;
+        b.m.planes = planes;
+        if (xioctl(s->pc_fd, VIDIOC_DQBUF, &b) == -1) {
+            if (errno != EAGAIN) s->errors++;
+            return;
+        }
+
+        if (b.flags & V4L2_BUF_FLAG_ERROR) {
+            s->errors++;
+        } else if (s->state == ST_RUNNING) {
+            size_t len = planes[0].bytesused < s->cap[b.index].len ? planes[0].bytesused : s->cap[b.index].len;
+            if (s->out_fd >= 0 && write(s->out_fd, s->cap[b.index].addr, len) < 0) s->errors++;
+
+            s->t_last = now_ns();
+            if (!s->frames++) s->t_first = s->t_last;
+            if (s->frames == s->target) s->state = ST_DRAINING;
+        }
+        qbuf_cap(s, b.index);
+    }
+}
+
+static void on_privcam_output(struct stream *s)
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+
+    for (;;) {
+        memset(&b, 0, sizeof(b));
+        memset(planes, 0, sizeof(planes));
+        b.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        b.memory = V4L2_MEMORY_DMABUF;
+        b.length = 1;
+        b.m.planes = planes;
+        if (xioctl(s->pc_fd, VIDIOC_DQBUF, &b) == -1) {
+            if (errno != EAGAIN) s->errors++;
+            return;
+        }
+        s->in_privcam--;
+        qbuf_cam(s, b.index);
+    }
+}
+
+// epoll data: stream pointer with bit 0 set for the privcam fd (streams are at least 8-aligned)
+static void *worker_run(void *arg)
+{
+    struct worker *wk = arg;
+    struct epoll_event ev[64];
+
+    while (wk->live) {
+        int n = epoll_wait(wk->epfd, ev, 64, 2000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        if (n == 0) {
+            fprintf(stderr, "no events for 2s, giving up on %u stream(s)\n", wk->live);
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            struct stream *s = (struct stream *)(ev[i].data.u64 & ~1ull);
+            int is_pc = ev[i].data.u64 & 1;
+
+            if (s->state == ST_DONE) continue;
+            if (!is_pc) {
+                on_camera(s);
+            } else {
+                if (ev[i].events & EPOLLOUT) on_privcam_output(s);
+                if (ev[i].events & EPOLLIN) on_privcam_capture(s);
+            }
+
+            // Buffers still in privcam belong to the camera; streamoff only once they are back
+            if (s->state == ST_DRAINING && !s->in_privcam)
+                stream_finish(wk, s);
+        }
+    }
+
+    for (unsigned i = 0; i < wk->nstreams; i++)
+        if (wk->streams[i]->state != ST_DONE)
+            stream_finish(wk, wk->streams[i]);
+    return NULL;
+}
+
+static int worker_add(struct worker *wk, struct stream *s)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = (uint64_t)(uintptr_t)s };
+    if (epoll_ctl(wk->epfd, EPOLL_CTL_ADD, s->cam_fd, &ev) < 0) return fail(s, "epoll_ctl camera");
+
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.u64 = (uint64_t)(uintptr_t)s | 1;
+    if (epoll_ctl(wk->epfd, EPOLL_CTL_ADD, s->pc_fd, &ev) < 0) return fail(s, "epoll_ctl privcam");
+
+    wk->streams[wk->nstreams++] = s;
+    wk->live++;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t w = 640, h = 480;
+    unsigned nframes = 300, nbufs = 4, nthreads = 1;
+    const char *outdir = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "S:n:b:t:o:")) != -1) {
+        switch (opt) {
+        case 'S': if (sscanf(optarg, "%ux%u", &w, &h) != 2) goto usage; break;
+        case 'n': nframes = (unsigned)atoi(optarg); break;
+        case 'b': nbufs = (unsigned)atoi(optarg); break;
+        case 't': nthreads = (unsigned)atoi(optarg); break;
+        case 'o': outdir = optarg; break;
+        default: goto usage;
+        }
+    }
+    unsigned nstreams = (unsigned)(argc - optind);
+    if (!nstreams || nstreams > MC_MAX_STREAMS || !nframes || !nbufs || nbufs > MC_MAX_BUFS ||
+        !nthreads || nthreads > MC_MAX_THREADS)
+        goto usage;
+    if (nthreads > nstreams) nthreads = nstreams;
+
+    static struct stream streams[MC_MAX_STREAMS];
+    static struct worker workers[MC_MAX_THREADS];
+
+    for (unsigned i = 0; i < nstreams; i++) {
+        struct stream *s = &streams[i];
+        char *colon = strchr(argv[optind + i], ':');
+        if (!colon) goto usage;
+        *colon = '\0';
+
+        s->id = i;
+        s->cam_dev = argv[optind + i];
+        s->pc_dev = colon + 1;
+        s->cam_fd = s->pc_fd = s->out_fd = -1;
+        for (unsigned b = 0; b < MC_MAX_BUFS; b++) s->dmabuf[b] = -1;
+        s->w = w;
+        s->h = h;
+        s->target = nframes;
+    }
+
+    int ok = 1;
+    for (unsigned t = 0; t < nthreads; t++) {
+        workers[t].epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (workers[t].epfd < 0) { perror("epoll_create1"); return 1; }
+    }
+    for (unsigned i = 0; ok && i < nstreams; i++)
+        if (stream_setup(&streams[i], nbufs, outdir) < 0 || worker_add(&workers[i % nthreads], &streams[i]) < 0)
+            ok = 0;
+
+    if (!ok) {
+        for (unsigned i = 0; i < nstreams; i++) stream_teardown(&streams[i]);
+        return 1;
+    }
+
+    fprintf(stderr, "%u stream(s) at %ux%u YUYV on %u thread(s), %u frames each\n", nstreams, w, h, nthreads, nframes);
+
+    uint64_t t0 = now_ns();
+    for (unsigned t = 0; t < nthreads; t++)
+        pthread_create(&workers[t].thread, NULL, worker_run, &workers[t]);
+    for (unsigned t = 0; t < nthreads; t++) {
+        pthread_join(workers[t].thread, NULL);
+        close(workers[t].epfd);
+    }
+    double wall = (double)(now_ns() - t0) / 1e9;
+
+    unsigned long total = 0;
+    int failed = 0;
+    for (unsigned i = 0; i < nstreams; i++) {
+        const struct stream *s = &streams[i];
+        double secs = s->frames > 1 ? (double)(s->t_last - s->t_first) / 1e9 : 0.0;
+        fprintf(stderr, "stream %2u %s -> %s: %u frames, %.1f fps, %u dropped, %u errors\n",
+                s->id, s->cam_dev, s->pc_dev, s->frames, secs > 0 ? (s->frames - 1) / secs : 0.0,
+                s->dropped, s->errors);
+        total += s->frames;
+        if (s->frames < s->target) failed = 1;
+    }
+    fprintf(stderr, "total: %lu frames in %.2fs, %.1f fps aggregate\n", total, wall, total / wall);
+    return failed;
+
+usage:
+    fprintf(stderr, "usage: %s [-S WxH] [-n frames] [-b bufs] [-t threads] [-o outdir] cam:privcam [cam:privcam ...]\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,301 @@
+// pcraw.h
+// Indexed multi-frame raw container ("pcraw") for privcam inputs, outputs and recordings.
+//
+//   offset 0           struct pcraw_header, padded to one page
+//   header.index_off   index_cap fixed-size struct pcraw_index entries
+//   header.data_off    frame payloads, frame i at data_off + i * frame_stride
+//
+// Every frame and every plane inside it starts on a page boundary, so any frame or plane can
+// be mmap'd straight out of the file (or read with O_DIRECT into a dma-buf) without parsing
+// anything but the fixed-size header and index. The writer keeps header and index mapped
+// shared and bumps frame_count after each payload lands, so a crashed recording is still
+// readable up to its last complete frame.
+
+#ifndef PCRAW_H
+#define PCRAW_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PCRAW_MAGIC        "PCRAW\0\0\0"
+#define PCRAW_VERSION      1
+#define PCRAW_PAGE         4096u
+#define PCRAW_MAX_PLANES   3
+
+#define PCRAW_ALIGN(x)     (((x) + PCRAW_PAGE - 1) & ~(uint64_t)(PCRAW_PAGE - 1))
+
+struct pcraw_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fourcc;                                // V4L2 pixelformat
+    uint32_t num_planes;
+    uint32_t bytesperline[PCRAW_MAX_PLANES];
+    uint32_t plane_size[PCRAW_MAX_PLANES];          // nominal sizeimage per plane
+    uint32_t plane_offset[PCRAW_MAX_PLANES];        // page-aligned, from start of frame
+    uint32_t index_entry_size;
+    uint64_t frame_stride;                          // page-aligned
+    uint64_t index_off;
+    uint64_t index_cap;
+    uint64_t data_off;
+    uint64_t frame_count;
+};
+
+struct pcraw_index {
+    uint64_t offset;                                // file offset of the frame
+    uint64_t timestamp_ns;
+    uint32_t sequence;
+    uint32_t flags;
+    uint32_t bytesused[PCRAW_MAX_PLANES];
+    uint32_t reserved;
+};
+
+struct pcraw {
+    int fd;
+    int writable;
+    struct pcraw_header *hdr;                       // mapped header + index
+    struct pcraw_index *index;
+    size_t meta_len;
+};
+
+static inline int pcraw_map_meta(struct pcraw *c, int prot)
+{
+    c->hdr = mmap(NULL, c->meta_len, prot, MAP_SHARED, c->fd, 0);
+    if (c->hdr == MAP_FAILED) {
+        perror("mmap pcraw header");
+        c->hdr = NULL;
+        return -1;
+    }
+    c->index = (struct pcraw_index *)((uint8_t *)c->hdr + c->hdr->index_off);
+    return 0;
+}
+
+// Create a container for up to index_cap frames of the given per-plane layout.
+static inline int pcraw_create(struct pcraw *c, const char *path, uint32_t w, uint32_t h, uint32_t fourcc,
+                               uint32_t num_planes, const uint32_t bytesperline[], const uint32_t plane_size[],
+                               uint64_t index_cap)
+{
+    struct pcraw_header hdr;
+
+    if (num_planes < 1 || num_planes > PCRAW_MAX_PLANES || !index_cap) {
+        fprintf(stderr, "pcraw: bad layout\n");
+        return -1;
+    }
+
+    memset(c, 0, sizeof(*c));
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, PCRAW_MAGIC, sizeof(hdr.magic));
+    hdr.version = PCRAW_VERSION;
+    hdr.header_size = sizeof(hdr);
+    hdr.width = w;
+    hdr.height = h;
+    hdr.fourcc = fourcc;
+    hdr.num_planes = num_planes;
+    hdr.index_entry_size = sizeof(struct pcraw_index);
+
+    uint64_t off = 0;
+    for (uint32_t p = 0; p < num_planes; p++) {
+        hdr.bytesperline[p] = bytesperline[p];
+        hdr.plane_size[p] = plane_size[p];
+        hdr.plane_offset[p] = (uint32_t)off;
+        off = PCRAW_ALIGN(off + plane_size[p]);
+    }
+    hdr.frame_stride = off;
+    hdr.index_off = PCRAW_PAGE;
+    hdr.index_cap = index_cap;
+    hdr.data_off = PCRAW_ALIGN(hdr.index_off + index_cap * sizeof(struct pcraw_index));
+
+    c->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (c->fd < 0) { perror("open pcraw"); return -1; }
+
+    c->writable = 1;
+    c->meta_len = hdr.data_off;
+    if (ftruncate(c->fd, (off_t)c->meta_len) < 0) { perror("ftruncate pcraw"); close(c->fd); return -1; }
+    if (pwrite(c->fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) { perror("write pcraw header"); close(c->fd); return -1; }
+
+    if (pcraw_map_meta(c, PROT_READ | PROT_WRITE) < 0) { close(c->fd); return -1; }
+    return 0;
+}
+
+// The layout a reader relies on: index before data, every plane inside the frame stride, and
+// every counted frame inside the file. Returns a reason, or NULL if the header is sound.
+static inline const char *pcraw_check(const struct pcraw_header *h, uint64_t file_size)
+{
+    uint64_t index_end, data_end;
+
+    if (h->num_planes < 1 || h->num_planes > PCRAW_MAX_PLANES)
+        return "bad plane count";
+    if (!h->frame_stride || h->frame_stride % PCRAW_PAGE || h->data_off % PCRAW_PAGE)
+        return "unaligned frames";
+    if (h->index_off < sizeof(*h) || h->index_off % sizeof(uint64_t) ||
+        __builtin_mul_overflow(h->index_cap, (uint64_t)h->index_entry_size, &index_end) ||
+        __builtin_add_overflow(index_end, h->index_off, &index_end) || index_end > h->data_off)
+        return "index overlaps data";
+    if (h->frame_count > h->index_cap)
+        return "more frames than index entries";
+    for (uint32_t p = 0; p < h->num_planes; p++)
+        if ((uint64_t)h->plane_offset[p] + h->plane_size[p] > h->frame_stride)
+            return "plane outside frame";
+    if (__builtin_mul_overflow(h->frame_count, h->frame_stride, &data_end) ||
+        __builtin_add_overflow(data_end, h->data_off, &data_end) || data_end > file_size)
+        return "truncated";
+    return NULL;
+}
+
+static inline int pcraw_open(struct pcraw *c, const char *path)
+{
+    struct pcraw_header hdr;
+    struct stat st;
+    const char *bad;
+
+    memset(c, 0, sizeof(*c));
+    c->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (c->fd < 0) { perror("open pcraw"); return -1; }
+
+    if (pread(c->fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        memcmp(hdr.magic, PCRAW_MAGIC, sizeof(hdr.magic)) || hdr.version != PCRAW_VERSION ||
+        hdr.index_entry_size != sizeof(struct pcraw_index)) {
+        fprintf(stderr, "%s: not a pcraw v%u file\n", path, PCRAW_VERSION);
+        close(c->fd);
+        return -1;
+    }
+    if (fstat(c->fd, &st) < 0) { perror("stat pcraw"); close(c->fd); return -1; }
+    if ((bad = pcraw_check(&hdr, (uint64_t)st.st_size))) {
+        fprintf(stderr, "%s: corrupt pcraw file (%s)\n", path, bad);
+        close(c->fd);
+        return -1;
+    }
+
+    c->meta_len = hdr.data_off;
+    if (pcraw_map_meta(c, PROT_READ) < 0) { close(c->fd); return -1; }
+    return 0;
+}
+
+// Cheap check used by the apps to accept either a pcraw file or a headerless raw dump
+static inline int pcraw_probe(const char *path)
+{
+    char magic[8];
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    int ok = pread(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic) &&
+             !memcmp(magic, PCRAW_MAGIC, sizeof(magic));
+    close(fd);
+    return ok;
+}
+
+static inline uint64_t pcraw_frame_count(const struct pcraw *c)
+{
+    return __atomic_load_n(&c->hdr->frame_count, __ATOMIC_ACQUIRE);
+}
+
+// Append one frame. planes[p] holds bytesused[p] bytes of plane p.
+static inline int pcraw_append(struct pcraw *c, const void *const planes[], const uint32_t bytesused[],
+                               uint64_t timestamp_ns, uint32_t sequence)
+{
+    struct pcraw_header *h = c->hdr;
+    uint64_t n = h->frame_count;
+
+    if (!c->writable || n >= h->index_cap) {
+        fprintf(stderr, "pcraw: index full (%llu frames)\n", (unsigned long long)h->index_cap);
+        return -1;
+    }
+
+    struct pcraw_index *e = &c->index[n];
+    memset(e, 0, sizeof(*e));
+    e->offset = h->data_off + n * h->frame_stride;
+    e->timestamp_ns = timestamp_ns;
+    e->sequence = sequence;
+
+    for (uint32_t p = 0; p < h->num_planes; p++) {
+        uint32_t len = bytesused[p] < h->plane_size[p] ? bytesused[p] : h->plane_size[p];
+        const uint8_t *src = planes[p];
+        off_t pos = (off_t)(e->offset + h->plane_offset[p]);
+
+        e->bytesused[p] = len;
+        while (len) {
+            ssize_t r = pwrite(c->fd, src, len, pos);
+            if (r < 0) { if (errno == EINTR) continue; perror("pwrite pcraw"); return -1; }
+            src += r;
+            pos += r;
+            len -= (uint32_t)r;
+        }
+    }
+
+    // Keep the file size at a whole frame so the last frame can always be mapped
+    if (ftruncate(c->fd, (off_t)(e->offset + h->frame_stride)) < 0) { perror("ftruncate pcraw"); return -1; }
+
+    __atomic_store_n(&h->frame_count, n + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// Payload bytes of plane p in frame e: bytesused, or the nominal size when it was not
+// recorded, and never more than the plane's slot in the frame
+static inline uint32_t pcraw_plane_bytes(const struct pcraw *c, const struct pcraw_index *e, uint32_t p)
+{
+    uint32_t size = c->hdr->plane_size[p];
+    return e->bytesused[p] && e->bytesused[p] < size ? e->bytesused[p] : size;
+}
+
+// Map frame i read-only. *base receives the page-aligned mapping of the whole frame; plane p
+// is at *base + hdr->plane_offset[p]. Release with pcraw_unmap_frame().
+static inline int pcraw_map_frame(const struct pcraw *c, uint64_t i, void **base, const struct pcraw_index **entry)
+{
+    const struct pcraw_header *h = c->hdr;
+    struct stat st;
+
+    // frame_count and the index are read from the live mapping, so checked again here
+    if (i >= pcraw_frame_count(c) || i >= h->index_cap) {
+        fprintf(stderr, "pcraw: frame %llu out of range\n", (unsigned long long)i);
+        return -1;
+    }
+
+    const struct pcraw_index *e = &c->index[i];
+    if (e->offset != h->data_off + i * h->frame_stride || fstat(c->fd, &st) < 0 ||
+        (uint64_t)st.st_size < e->offset + h->frame_stride) {
+        fprintf(stderr, "pcraw: frame %llu is corrupt\n", (unsigned long long)i);
+        return -1;
+    }
+    void *p = mmap(NULL, c->hdr->frame_stride, PROT_READ, MAP_SHARED, c->fd, (off_t)e->offset);
+    if (p == MAP_FAILED) { perror("mmap pcraw frame"); return -1; }
+
+    *base = p;
+    if (entry) *entry = e;
+    return 0;
+}
+
+static inline void pcraw_unmap_frame(const struct pcraw *c, void *base)
+{
+    munmap(base, c->hdr->frame_stride);
+}
+
+static inline void pcraw_close(struct pcraw *c)
+{
+    if (c->hdr) {
+        if (c->writable)
+            msync(c->hdr, c->meta_len, MS_SYNC);
+        munmap(c->hdr, c->meta_len);
+    }
+    if (c->fd >= 0)
+        close(c->fd);
+    c->hdr = NULL;
+    c->index = NULL;
+    c->fd = -1;
+}
+
+// Path ends in ".pcraw": the apps write a container instead of a headerless dump
+static inline int pcraw_path(const char *path)
+{
+    size_t n = strlen(path);
+    return n > 6 && !strcmp(path + n - 6, ".pcraw");
+}
+
+#endif // PCRAW_H
@@ -0,0 +1,808 @@
+// privcam_bench.c
+// Throughput and latency benchmark for privcam. Drives one or more privcam contexts with
+// synthetic frames and sweeps memory mode x format x resolution x buffer count x contexts.
+// Every run reports fps, MB/s, process CPU time and p50/p99/p99.9 QBUF(OUTPUT)->DQBUF(CAPTURE)
+// latency. Results go to stdout as one JSON document, progress goes to stderr.
+//
+// Memory modes for the privcam OUTPUT queue (CAPTURE is MMAP unless noted):
+//   mmap      privcam's own MMAP buffers
+//   heap      DMABUF from /dev/dma_heap/system (one buffer per frame, planes at data_offset)
+//   export    DMABUF exported (VIDIOC_EXPBUF) from the CAPTURE queue of another device,
+//             by default a second privcam context
+//   userptr   USERPTR on both queues, carved from one anonymous 4K-page mapping
+//   hugepage  USERPTR on both queues, carved from 2 MB pages (hugetlb, else THP; see hugebuf.h)
+//
+// With -R N every context also maps an N-entry completion ring (ratsv4l2_cam/privcam_ring.h):
+// CAPTURE completions are reaped from shared memory and recycled without DQBUF/QBUF, and poll
+// is only called when the ring is empty.
+//
+// With -C the privcam OUTPUT MMAP queue is requested V4L2_MEMORY_FLAG_NON_COHERENT and queued
+// with cache hints: an OUTPUT buffer is cleaned on its first QBUF only (the pattern is written
+// once). CAPTURE is vmalloc memory with no cache maintenance, so it gets no hints.
+//
+// gcc -O2 -Wall -Wextra -pthread -o privcam_bench privcam_bench.c
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dmaheap_pool.h"
+#include "hugebuf.h"
+#include "../ratsv4l2_cam/privcam_ring.h"
+
+#define BENCH_MAX_BUFS   32
+#define BENCH_MAX_CTX    16
+#define BENCH_MAX_LIST   16
+
+enum bench_mode { MODE_MMAP, MODE_HEAP, MODE_EXPORT, MODE_USERPTR, MODE_HUGEPAGE };
+
+static const char *mode_names[] = { "mmap", "heap", "export", "userptr", "hugepage" };
+
+struct bench_opts {
+    const char *dev;
+    const char *heap;
+    const char *export_dev;
+    unsigned frames;
+    unsigned warmup;
+    unsigned ring;                  // completion ring entries, 0 = DQBUF path
+    int noncoherent;                // -C: non-coherent MMAP buffers plus cache hints
+
+    unsigned nmodes, nfmts, nres, nbufs, nctx;
+    enum bench_mode modes[BENCH_MAX_LIST];
+    uint32_t fmts[BENCH_MAX_LIST];
+    uint32_t res[BENCH_MAX_LIST][2];
+    unsigned bufs[BENCH_MAX_LIST];
+    unsigned ctxs[BENCH_MAX_LIST];
+};
+
+struct bench_cfg {
+    enum bench_mode mode;
+    uint32_t fourcc;
+    uint32_t w, h;
+    unsigned nbufs;
+    unsigned nctx;
+};
+
+struct plane_map {
+    void *addr;
+    size_t len;
+};
+
+struct out_buf {
+    int fd[3];                      // dmabuf fds (heap/export), -1 for MMAP/USERPTR
+    unsigned off[3];                // data_offset per plane
+    unsigned length[3];             // dmabuf length per plane
+    struct plane_map map[3];        // CPU mapping used to fill the synthetic frame
+    struct dmaheap_buf *hb;         // heap mode: pool buffer backing all planes
+    int cleaned;                    // -C: already cleaned once, later QBUFs skip it
+};
+
+struct bench_ctx {
+    const struct bench_opts *opts;
+    const struct bench_cfg *cfg;
+
+    int vfd;
+    int exp_fd;                     // export mode: the exporting device
+    enum v4l2_memory out_mem, cap_mem;
+    struct hugebuf ub;              // userptr/hugepage modes: backs every buffer of both queues
+    unsigned nplanes;
+    unsigned sizeimage[3];
+
+    struct plane_map cap[BENCH_MAX_BUFS][3];
+    struct out_buf out[BENCH_MAX_BUFS];
+
+    // OUTPUT QBUF times, FIFO: m2m completes jobs of one context in queue order
+    uint64_t qbuf_ns[BENCH_MAX_BUFS];
+    unsigned q_head, q_tail;
+
+    struct privcam_ring_hdr *ring;
+    size_t ring_len;
+
+    uint64_t *lat_ns;
+    unsigned nlat;
+    int err;
+};
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+    int r;
+    do { r = ioctl(fd, req, arg); } while (r == -1 && errno == EINTR);
+    return r;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static const char *fmt_name(uint32_t fourcc)
+{
+    return fourcc == V4L2_PIX_FMT_YUV420M ? "yuv420m" : "yuyv";
+}
+
+static int set_fmt_mp(int vfd, enum v4l2_buf_type type, uint32_t w, uint32_t h, uint32_t fourcc,
+                      struct v4l2_pix_format_mplane *out)
+{
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = type;
+    fmt.fmt.pix_mp.width = w;
+    fmt.fmt.pix_mp.height = h;
+    fmt.fmt.pix_mp.pixelformat = fourcc;
+    fmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+
+    if (xioctl(vfd, VIDIOC_S_FMT, &fmt) < 0) { perror("VIDIOC_S_FMT"); return -1; }
+    if (fmt.fmt.pix_mp.pixelformat != fourcc || fmt.fmt.pix_mp.width != w || fmt.fmt.pix_mp.height != h) {
+        fprintf(stderr, "Driver changed format to %ux%u %.4s\n",
+                fmt.fmt.pix_mp.width, fmt.fmt.pix_mp.height, (char *)&fmt.fmt.pix_mp.pixelformat);
+        return -1;
+    }
+    if (out) *out = fmt.fmt.pix_mp;
+    return 0;
+}
+
+static int reqbufs(int vfd, enum v4l2_buf_type type, enum v4l2_memory mem, unsigned count, unsigned flags)
+{
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.type = type;
+    req.memory = mem;
+    req.count = count;
+    req.flags = flags;
+
+    if (xioctl(vfd, VIDIOC_REQBUFS, &req) < 0) { perror("VIDIOC_REQBUFS"); return -1; }
+    if (req.count < count) { fprintf(stderr, "REQBUFS: requested %u got %u\n", count, req.count); return -1; }
+    return 0;
+}
+
+static unsigned mmap_flags(const struct bench_ctx *c)
+{
+    return c->opts->noncoherent ? V4L2_MEMORY_FLAG_NON_COHERENT : 0;
+}
+
+static int map_planes(int vfd, enum v4l2_buf_type type, unsigned index, unsigned nplanes,
+                      struct plane_map map[3])
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[3];
+    memset(&b, 0, sizeof(b));
+    memset(planes, 0, sizeof(planes));
+    b.type = type;
+    b.memory = V4L2_MEMORY_MMAP;
+    b.index = index;
+    b.length = nplanes;
+    b.m.planes = planes;
+
+    if (xioctl(vfd, VIDIOC_QUERYBUF, &b) < 0) { perror("VIDIOC_QUERYBUF"); return -1; }
+
+    for (unsigned p = 0; p < nplanes; p++) {
+        map[p].len = planes[p].length;
+        map[p].addr = mmap(NULL, map[p].len, PROT_READ | PROT_WRITE, MAP_SHARED, vfd, planes[p].m.mem_offset);
+        if (map[p].addr == MAP_FAILED) { perror("mmap plane"); map[p].addr = NULL; return -1; }
+    }
+    return 0;
+}
+
+static int export_plane(int vfd, enum v4l2_buf_type type, unsigned index, unsigned plane)
+{
+    struct v4l2_exportbuffer exp;
+    memset(&exp, 0, sizeof(exp));
+    exp.type = type;
+    exp.index = index;
+    exp.plane = plane;
+    exp.flags = O_RDWR | O_CLOEXEC;
+
+    if (xioctl(vfd, VIDIOC_EXPBUF, &exp) < 0) { perror("VIDIOC_EXPBUF"); return -1; }
+    return exp.fd;
+}
+
+static int qbuf_capture(struct bench_ctx *c, unsigned index)
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[3];
+    memset(&b, 0, sizeof(b));
+    memset(planes, 0, sizeof(planes));
+    b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    b.memory = c->cap_mem;
+    b.index = index;
+    b.length = c->nplanes;
+    b.m.planes = planes;
+
+    if (b.memory == V4L2_MEMORY_USERPTR) {
+        for (unsigned p = 0; p < c->nplanes; p++) {
+            planes[p].m.userptr = (unsigned long)c->cap[index][p].addr;
+            planes[p].length = (unsigned)c->cap[index][p].len;
+        }
+    }
+    if (xioctl(c->vfd, VIDIOC_QBUF, &b) < 0) { perror("VIDIOC_QBUF cap"); return -1; }
+    return 0;
+}
+
+static int qbuf_output(struct bench_ctx *c, unsigned index)
+{
+    struct out_buf *ob = &c->out[index];
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[3];
+    memset(&b, 0, sizeof(b));
+    memset(planes, 0, sizeof(planes));
+    b.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    b.memory = c->out_mem;
+    b.index = index;
+    b.length = c->nplanes;
+    b.m.planes = planes;
+
+    for (unsigned p = 0; p < c->nplanes; p++) {
+        planes[p].bytesused = ob->off[p] + c->sizeimage[p];
+        planes[p].data_offset = ob->off[p];
+        if (b.memory == V4L2_MEMORY_DMABUF) {
+            planes[p].m.fd = ob->fd[p];
+            planes[p].length = ob->length[p];
+        } else if (b.memory == V4L2_MEMORY_USERPTR) {
+            planes[p].m.userptr = (unsigned long)ob->map[p].addr;
+            planes[p].length = (unsigned)ob->map[p].len;
+        }
+    }
+
+    if (c->opts->noncoherent && b.memory == V4L2_MEMORY_MMAP) {
+        if (ob->cleaned) b.flags = V4L2_BUF_FLAG_NO_CACHE_CLEAN;
+        ob->cleaned = 1;
+    }
+
+    c->qbuf_ns[c->q_tail++ % BENCH_MAX_BUFS] = now_ns();
+    if (xioctl(c->vfd, VIDIOC_QBUF, &b) < 0) { perror("VIDIOC_QBUF out"); return -1; }
+    return 0;
+}
+
+static int dqbuf(struct bench_ctx *c, enum v4l2_buf_type type, enum v4l2_memory mem, unsigned *index)
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[3];
+    memset(&b, 0, sizeof(b));
+    memset(planes, 0, sizeof(planes));
+    b.type = type;
+    b.memory = mem;
+    b.length = c->nplanes;
+    b.m.planes = planes;
+
+    if (xioctl(c->vfd, VIDIOC_DQBUF, &b) < 0) { perror("VIDIOC_DQBUF"); return -1; }
+    if (b.flags & V4L2_BUF_FLAG_ERROR) fprintf(stderr, "buffer %u returned with error\n", b.index);
+    *index = b.index;
+    return 0;
+}
+
+static int ring_setup(struct bench_ctx *c)
+{
+    struct v4l2_control ctrl = { .id = PRIVCAM_CID_RING_ENTRIES, .value = (int)c->opts->ring };
+    if (xioctl(c->vfd, VIDIOC_S_CTRL, &ctrl) < 0) { perror("set Completion Ring Entries"); return -1; }
+
+    c->ring_len = privcam_ring_bytes(c->opts->ring);
+    c->ring = mmap(NULL, c->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED, c->vfd, PRIVCAM_RING_MMAP_OFFSET);
+    if (c->ring == MAP_FAILED) { perror("mmap completion ring"); c->ring = NULL; return -1; }
+    return 0;
+}
+
+static void fill_pattern(void *addr, size_t len, unsigned seed)
+{
+    uint8_t *p = addr;
+    for (size_t i = 0; i < len; i++)
+        p[i] = (uint8_t)(i + seed);
+}
+
+static int setup_output_mmap(struct bench_ctx *c)
+{
+    if (reqbufs(c->vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_MMAP, c->cfg->nbufs, mmap_flags(c)) < 0) return -1;
+    for (unsigned i = 0; i < c->cfg->nbufs; i++)
+        if (map_planes(c->vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, i, c->nplanes, c->out[i].map) < 0) return -1;
+    return 0;
+}
+
+static int setup_output_heap(struct bench_ctx *c, struct dmaheap_pool *pool)
+{
+    size_t frame = 0;
+    for (unsigned p = 0; p < c->nplanes; p++) frame += c->sizeimage[p];
+
+    if (reqbufs(c->vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_DMABUF, c->cfg->nbufs, 0) < 0) return -1;
+
+    for (unsigned i = 0; i < c->cfg->nbufs; i++) {
+        struct out_buf *ob = &c->out[i];
+        ob->hb = dmaheap_pool_get(pool, frame);
+        if (!ob->hb) return -1;
+
+        size_t off = 0;
+        for (unsigned p = 0; p < c->nplanes; p++) {
+            ob->fd[p] = ob->hb->fd;
+            ob->off[p] = (unsigned)off;
+            ob->length[p] = (unsigned)frame;
+            ob->map[p].addr = (uint8_t *)ob->hb->addr + off;
+            ob->map[p].len = c->sizeimage[p];
+            off += c->sizeimage[p];
+        }
+    }
+    return 0;
+}
+
+static int setup_output_export(struct bench_ctx *c)
+{
+    c->exp_fd = open(c->opts->export_dev, O_RDWR | O_CLOEXEC);
+    if (c->exp_fd < 0) { perror("open export device"); return -1; }
+
+    if (set_fmt_mp(c->exp_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, c->cfg->w, c->cfg->h, c->cfg->fourcc, NULL) < 0)
+        return -1;
+    if (reqbufs(c->exp_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_MEMORY_MMAP, c->cfg->nbufs, 0) < 0) return -1;
+    if (reqbufs(c->vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_DMABUF, c->cfg->nbufs, 0) < 0) return -1;
+
+    for (unsigned i = 0; i < c->cfg->nbufs; i++) {
+        struct out_buf *ob = &c->out[i];
+        for (unsigned p = 0; p < c->nplanes; p++) {
+            ob->fd[p] = export_plane(c->exp_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, i, p);
+            if (ob->fd[p] < 0) return -1;
+            ob->length[p] = c->sizeimage[p];
+            ob->map[p].len = c->sizeimage[p];
+            ob->map[p].addr = mmap(NULL, ob->map[p].len, PROT_READ | PROT_WRITE, MAP_SHARED, ob->fd[p], 0);
+            if (ob->map[p].addr == MAP_FAILED) { perror("mmap exported dmabuf"); ob->map[p].addr = NULL; return -1; }
+        }
+    }
+    return 0;
+}
+
+// Every plane of every buffer of both queues is a page-aligned slice of one mapping, so a
+// hugepage run touches a handful of 2 MB pages where the others walk thousands of 4K ones
+static int setup_userptr(struct bench_ctx *c, int huge)
+{
+    size_t frame = 0;
+    for (unsigned p = 0; p < c->nplanes; p++) frame += (c->sizeimage[p] + 4095) & ~4095u;
+
+    if (hugebuf_alloc(&c->ub, 2 * c->cfg->nbufs * frame, huge) < 0) return -1;
+    if (huge && c->ub.kind == HUGEBUF_4K)
+        fprintf(stderr, "hugepage: no hugetlb pool and THP unavailable, running on 4K pages\n");
+
+    uint8_t *at = c->ub.addr;
+    for (unsigned i = 0; i < c->cfg->nbufs; i++) {
+        for (unsigned p = 0; p < c->nplanes; p++) {
+            size_t slice = (c->sizeimage[p] + 4095) & ~4095u;
+
+            c->out[i].map[p].addr = at;
+            c->out[i].map[p].len = c->sizeimage[p];
+            at += slice;
+            c->cap[i][p].addr = at;
+            c->cap[i][p].len = c->sizeimage[p];
+            at += slice;
+        }
+    }
+
+    if (reqbufs(c->vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_USERPTR, c->cfg->nbufs, 0) < 0) return -1;
+    return reqbufs(c->vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_MEMORY_USERPTR, c->cfg->nbufs, 0);
+}
+
+static int ctx_setup(struct bench_ctx *c, struct dmaheap_pool *pool)
+{
+    const struct bench_cfg *cfg = c->cfg;
+    struct v4l2_pix_format_mplane pix;
+
+    c->vfd = open(c->opts->dev, O_RDWR | O_CLOEXEC);
+    if (c->vfd < 0) { perror("open privcam"); return -1; }
+
+    if (set_fmt_mp(c->vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, cfg->w, cfg->h, cfg->fourcc, &pix) < 0) return -1;
+    if (set_fmt_mp(c->vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, cfg->w, cfg->h, cfg->fourcc, NULL) < 0) return -1;
+
+    c->nplanes = pix.num_planes;
+    for (unsigned p = 0; p < c->nplanes; p++)
+        c->sizeimage[p] = pix.plane_fmt[p].sizeimage;
+
+    if (c->opts->ring && ring_setup(c) < 0) return -1;
+
+    int ret;
+    c->out_mem = cfg->mode == MODE_MMAP ? V4L2_MEMORY_MMAP : V4L2_MEMORY_DMABUF;
+    c->cap_mem = V4L2_MEMORY_MMAP;
+    switch (cfg->mode) {
+    case MODE_MMAP:     ret = setup_output_mmap(c); break;
+    case MODE_HEAP:     ret = setup_output_heap(c, pool); break;
+    case MODE_EXPORT:   ret = setup_output_export(c); break;
+    default:
+        c->out_mem = c->cap_mem = V4L2_MEMORY_USERPTR;
+        ret = setup_userptr(c, cfg->mode == MODE_HUGEPAGE);
+        break;
+    }
+    if (ret < 0) return -1;
+
+    if (c->cap_mem == V4L2_MEMORY_MMAP) {
+        if (reqbufs(c->vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_MEMORY_MMAP, cfg->nbufs, 0) < 0) return -1;
+        for (unsigned i = 0; i < cfg->nbufs; i++)
+            if (map_planes(c->vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, i, c->nplanes, c->cap[i]) < 0) return -1;
+    }
+
+    // Synthetic frames are written once; the benchmark measures privcam, not the producer
+    for (unsigned i = 0; i < cfg->nbufs; i++)
+        for (unsigned p = 0; p < c->nplanes; p++)
+            fill_pattern(c->out[i].map[p].addr, c->sizeimage[p], i * 16 + p);
+
+    c->lat_ns = calloc(c->opts->frames, sizeof(*c->lat_ns));
+    if (!c->lat_ns) { perror("calloc"); return -1; }
+    return 0;
+}
+
+static void ctx_teardown(struct bench_ctx *c)
+{
+    enum v4l2_buf_type t;
+
+    if (c->vfd >= 0) {
+        t = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        xioctl(c->vfd, VIDIOC_STREAMOFF, &t);
+        t = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        xioctl(c->vfd, VIDIOC_STREAMOFF, &t);
+    }
+
+    for (unsigned i = 0; !c->ub.map && i < BENCH_MAX_BUFS; i++) {
+        struct out_buf *ob = &c->out[i];
+        for (unsigned p = 0; p < 3; p++) {
+            if (c->cap[i][p].addr) munmap(c->cap[i][p].addr, c->cap[i][p].len);
+            if (ob->hb) continue;
+            if (ob->map[p].addr) munmap(ob->map[p].addr, ob->map[p].len);
+            if (ob->fd[p] >= 0) close(ob->fd[p]);
+        }
+        if (ob->hb) dmaheap_pool_put(ob->hb);
+    }
+
+    if (c->ring) munmap(c->ring, c->ring_len);
+    if (c->vfd >= 0) close(c->vfd);
+    hugebuf_free(&c->ub);
+    if (c->exp_fd >= 0) close(c->exp_fd);
+    free(c->lat_ns);
+}
+
+// Ring variant of the loop in ctx_run: CAPTURE buffers come back through the ring and are
+// recycled by advancing tail, OUTPUT buffers still need DQBUF before they can be requeued.
+static int ring_loop(struct bench_ctx *c, unsigned total)
+{
+    struct privcam_ring_hdr *r = c->ring;
+    struct privcam_cqe *cqes = privcam_ring_cqes(r);
+    const uint32_t mask = r->entries - 1;
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    unsigned done = 0, out_done = 0;
+
+    while (done < total) {
+        uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+        if (head == tail) {
+            struct pollfd pfd = { .fd = c->vfd, .events = POLLIN | POLLOUT };
+            if (poll(&pfd, 1, 2000) <= 0) { fprintf(stderr, "ring: no completions\n"); return -1; }
+            continue;
+        }
+
+        unsigned nout = 0;
+        for (; tail != head; tail++) {
+            const struct privcam_cqe *e = &cqes[tail & mask];
+
+            if (e->flags & PRIVCAM_CQE_F_ERROR) fprintf(stderr, "buffer %u returned with error\n", e->index);
+
+            if (e->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+                uint64_t t_dq = now_ns();
+                uint64_t t_q = c->qbuf_ns[c->q_head++ % BENCH_MAX_BUFS];
+                if (done >= c->opts->warmup)
+                    c->lat_ns[c->nlat++] = t_dq - t_q;
+                done++;
+
+                // Only failed buffers go through vb2; held ones are requeued by consuming the entry
+                if (!(e->flags & PRIVCAM_CQE_F_HELD)) {
+                    unsigned idx;
+                    if (dqbuf(c, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, c->cap_mem, &idx) < 0) return -1;
+                    if (qbuf_capture(c, idx) < 0) return -1;
+                }
+            } else {
+                nout++;
+            }
+        }
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+
+        for (unsigned i = 0; i < nout; i++, out_done++) {
+            unsigned out_idx;
+            if (dqbuf(c, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, c->out_mem, &out_idx) < 0) return -1;
+            if (out_done + c->cfg->nbufs < total && qbuf_output(c, out_idx) < 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static void *ctx_run(void *arg)
+{
+    struct bench_ctx *c = arg;
+    const unsigned total = c->opts->warmup + c->opts->frames;
+    enum v4l2_buf_type t;
+
+    for (unsigned i = 0; i < c->cfg->nbufs; i++)
+        if (qbuf_capture(c, i) < 0) goto fail;
+
+    t = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    if (xioctl(c->vfd, VIDIOC_STREAMON, &t) < 0) { perror("VIDIOC_STREAMON cap"); goto fail; }
+    t = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    if (xioctl(c->vfd, VIDIOC_STREAMON, &t) < 0) { perror("VIDIOC_STREAMON out"); goto fail; }
+
+    for (unsigned i = 0; i < c->cfg->nbufs; i++)
+        if (qbuf_output(c, i) < 0) goto fail;
+
+    if (c->ring) {
+        if (ring_loop(c, total) < 0) goto fail;
+        return NULL;
+    }
+
+    for (unsigned done = 0; done < total; done++) {
+        unsigned cap_idx, out_idx;
+
+        if (dqbuf(c, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, c->cap_mem, &cap_idx) < 0) goto fail;
+        uint64_t t_dq = now_ns();
+        uint64_t t_q = c->qbuf_ns[c->q_head++ % BENCH_MAX_BUFS];
+        if (done >= c->opts->warmup)
+            c->lat_ns[c->nlat++] = t_dq - t_q;
+
+        if (dqbuf(c, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, c->out_mem, &out_idx) < 0) goto fail;
+
+        // Keep the pipeline full but never queue more than we will dequeue
+        if (done + c->cfg->nbufs < total && qbuf_output(c, out_idx) < 0) goto fail;
+        if (qbuf_capture(c, cap_idx) < 0) goto fail;
+    }
+    return NULL;
+
+fail:
+    c->err = 1;
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double pct_us(const uint64_t *sorted, size_t n, double q)
+{
+    if (!n) return 0.0;
+    size_t i = (size_t)(q * (double)n);
+    if (i >= n) i = n - 1;
+    return (double)sorted[i] / 1000.0;
+}
+
+static double tv_s(struct timeval tv)
+{
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1e6;
+}
+
+static int run_one(const struct bench_opts *o, const struct bench_cfg *cfg, int first)
+{
+    struct bench_ctx *ctx = calloc(cfg->nctx, sizeof(*ctx));
+    pthread_t th[BENCH_MAX_CTX];
+    struct dmaheap_pool pool;
+    int pool_ok = 0, ok = 1;
+
+    if (!ctx) { perror("calloc"); return -1; }
+
+    fprintf(stderr, "run: mode=%s fmt=%s %ux%u bufs=%u ctx=%u\n",
+            mode_names[cfg->mode], fmt_name(cfg->fourcc), cfg->w, cfg->h, cfg->nbufs, cfg->nctx);
+
+    if (cfg->mode == MODE_HEAP) {
+        if (dmaheap_pool_init(&pool, o->heap, cfg->nbufs * cfg->nctx) < 0) ok = 0;
+        else pool_ok = 1;
+    }
+
+    for (unsigned i = 0; i < cfg->nctx; i++) {
+        ctx[i].opts = o;
+        ctx[i].cfg = cfg;
+        ctx[i].vfd = -1;
+        ctx[i].exp_fd = -1;
+        for (unsigned b = 0; b < BENCH_MAX_BUFS; b++)
+            for (unsigned p = 0; p < 3; p++)
+                ctx[i].out[b].fd[p] = -1;
+    }
+    for (unsigned i = 0; ok && i < cfg->nctx; i++)
+        if (ctx_setup(&ctx[i], &pool) < 0) ok = 0;
+
+    struct rusage ru0, ru1;
+    uint64_t t0 = 0, t1 = 0;
+
+    if (ok) {
+        getrusage(RUSAGE_SELF, &ru0);
+        t0 = now_ns();
+        for (unsigned i = 0; i < cfg->nctx; i++)
+            pthread_create(&th[i], NULL, ctx_run, &ctx[i]);
+        for (unsigned i = 0; i < cfg->nctx; i++) {
+            pthread_join(th[i], NULL);
+            if (ctx[i].err) ok = 0;
+        }
+        t1 = now_ns();
+        getrusage(RUSAGE_SELF, &ru1);
+    }
+
+    printf("%s\n    {\"mode\": \"%s\", \"format\": \"%s\", \"width\": %u, \"height\": %u, "
+           "\"buffers\": %u, \"contexts\": %u",
+           first ? "" : ",", mode_names[cfg->mode], fmt_name(cfg->fourcc),
+           cfg->w, cfg->h, cfg->nbufs, cfg->nctx);
+    if (ctx[0].ub.map)
+        printf(", \"pages\": \"%s\"", hugebuf_kind_name(ctx[0].ub.kind));
+
+    if (!ok) {
+        printf(", \"error\": true}");
+    } else {
+        size_t n = 0, frame_bytes = 0;
+        for (unsigned i = 0; i < cfg->nctx; i++) n += ctx[i].nlat;
+        for (unsigned p = 0; p < ctx[0].nplanes; p++) frame_bytes += ctx[0].sizeimage[p];
+
+        uint64_t *all = malloc((n ? n : 1) * sizeof(*all));
+        size_t k = 0;
+        for (unsigned i = 0; all && i < cfg->nctx; i++)
+            for (unsigned j = 0; j < ctx[i].nlat; j++)
+                all[k++] = ctx[i].lat_ns[j];
+        if (all) qsort(all, n, sizeof(*all), cmp_u64);
+
+        // Wall time includes the warmup frames, so count them for throughput too
+        double wall = (double)(t1 - t0) / 1e9;
+        double frames = (double)cfg->nctx * (o->frames + o->warmup);
+        double user = tv_s(ru1.ru_utime) - tv_s(ru0.ru_utime);
+        double sys = tv_s(ru1.ru_stime) - tv_s(ru0.ru_stime);
+
+        printf(", \"frame_bytes\": %zu, \"frames\": %zu, \"wall_s\": %.6f, \"fps\": %.2f, "
+               "\"mb_per_s\": %.2f, \"cpu_user_s\": %.6f, \"cpu_sys_s\": %.6f, "
+               "\"latency_us\": {\"p50\": %.1f, \"p99\": %.1f, \"p99_9\": %.1f, \"max\": %.1f}}",
+               frame_bytes, n, wall, frames / wall,
+               frames * (double)frame_bytes / wall / (1024.0 * 1024.0), user, sys,
+               all ? pct_us(all, n, 0.50) : 0.0, all ? pct_us(all, n, 0.99) : 0.0,
+               all ? pct_us(all, n, 0.999) : 0.0, (all && n) ? (double)all[n - 1] / 1000.0 : 0.0);
+        free(all);
+    }
+    fflush(stdout);
+
+    for (unsigned i = 0; i < cfg->nctx; i++)
+        ctx_teardown(&ctx[i]);
+    if (pool_ok)
+        dmaheap_pool_destroy(&pool);
+    free(ctx);
+    return ok ? 0 : -1;
+}
+
+static unsigned split_list(char *arg, char **items)
+{
+    unsigned n = 0;
+    for (char *tok = strtok(arg, ","); tok && n < BENCH_MAX_LIST; tok = strtok(NULL, ","))
+        items[n++] = tok;
+    return n;
+}
+
+static int parse_opts(int argc, char **argv, struct bench_opts *o)
+{
+    static const struct option longopts[] = {
+        { "device",      required_argument, NULL, 'd' },
+        { "heap",        required_argument, NULL, 'H' },
+        { "export-dev",  required_argument, NULL, 'e' },
+        { "modes",       required_argument, NULL, 'm' },
+        { "formats",     required_argument, NULL, 'f' },
+        { "resolutions", required_argument, NULL, 'r' },
+        { "buffers",     required_argument, NULL, 'b' },
+        { "contexts",    required_argument, NULL, 'c' },
+        { "frames",      required_argument, NULL, 'n' },
+        { "warmup",      required_argument, NULL, 'w' },
+        { "ring",        required_argument, NULL, 'R' },
+        { "noncoherent", no_argument,       NULL, 'C' },
+        { NULL, 0, NULL, 0 }
+    };
+    char modes[] = "mmap,heap,export", fmts[] = "yuyv,yuv420m";
+    char res[] = "640x480,1280x720,1920x1080,3840x2160", bufs[] = "2,4", ctxs[] = "1,2";
+    char *m = modes, *f = fmts, *r = res, *b = bufs, *c = ctxs;
+    char *items[BENCH_MAX_LIST];
+    int opt;
+
+    o->dev = "/dev/video2";
+    o->heap = "/dev/dma_heap/system";
+    o->export_dev = NULL;
+    o->frames = 300;
+    o->warmup = 10;
+
+    while ((opt = getopt_long(argc, argv, "d:H:e:m:f:r:b:c:n:w:R:C", longopts, NULL)) != -1) {
+        switch (opt) {
+        case 'd': o->dev = optarg; break;
+        case 'H': o->heap = optarg; break;
+        case 'e': o->export_dev = optarg; break;
+        case 'm': m = optarg; break;
+        case 'f': f = optarg; break;
+        case 'r': r = optarg; break;
+        case 'b': b = optarg; break;
+        case 'c': c = optarg; break;
+        case 'n': o->frames = (unsigned)atoi(optarg); break;
+        case 'w': o->warmup = (unsigned)atoi(optarg); break;
+        case 'R': o->ring = (unsigned)atoi(optarg); break;
+        case 'C': o->noncoherent = 1; break;
+        default: return -1;
+        }
+    }
+    if (!o->export_dev)
+        o->export_dev = o->dev;     // a second privcam context exports its CAPTURE buffers
+    if (!o->frames)
+        return -1;
+
+    o->nmodes = split_list(m, items);
+    for (unsigned i = 0; i < o->nmodes; i++) {
+        if (!strcmp(items[i], "mmap")) o->modes[i] = MODE_MMAP;
+        else if (!strcmp(items[i], "heap")) o->modes[i] = MODE_HEAP;
+        else if (!strcmp(items[i], "export")) o->modes[i] = MODE_EXPORT;
+        else if (!strcmp(items[i], "userptr")) o->modes[i] = MODE_USERPTR;
+        else if (!strcmp(items[i], "hugepage")) o->modes[i] = MODE_HUGEPAGE;
+        else { fprintf(stderr, "unknown mode %s\n", items[i]); return -1; }
+    }
+
+    o->nfmts = split_list(f, items);
+    for (unsigned i = 0; i < o->nfmts; i++) {
+        if (!strcmp(items[i], "yuyv")) o->fmts[i] = V4L2_PIX_FMT_YUYV;
+        else if (!strcmp(items[i], "yuv420m")) o->fmts[i] = V4L2_PIX_FMT_YUV420M;
+        else { fprintf(stderr, "unknown format %s\n", items[i]); return -1; }
+    }
+
+    o->nres = split_list(r, items);
+    for (unsigned i = 0; i < o->nres; i++)
+        if (sscanf(items[i], "%ux%u", &o->res[i][0], &o->res[i][1]) != 2) {
+            fprintf(stderr, "bad resolution %s\n", items[i]);
+            return -1;
+        }
+
+    o->nbufs = split_list(b, items);
+    for (unsigned i = 0; i < o->nbufs; i++) {
+        o->bufs[i] = (unsigned)atoi(items[i]);
+        if (o->bufs[i] < 1 || o->bufs[i] > BENCH_MAX_BUFS) { fprintf(stderr, "bad buffer count %s\n", items[i]); return -1; }
+        // Both queues post entries; a full ring would push completions back onto DQBUF
+        if (o->ring && o->ring < 2 * o->bufs[i]) { fprintf(stderr, "ring needs at least %u entries\n", 2 * o->bufs[i]); return -1; }
+    }
+    if (o->ring & (o->ring - 1)) { fprintf(stderr, "ring entries must be a power of two\n"); return -1; }
+
+    o->nctx = split_list(c, items);
+    for (unsigned i = 0; i < o->nctx; i++) {
+        o->ctxs[i] = (unsigned)atoi(items[i]);
+        if (o->ctxs[i] < 1 || o->ctxs[i] > BENCH_MAX_CTX) { fprintf(stderr, "bad context count %s\n", items[i]); return -1; }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_opts o;
+    memset(&o, 0, sizeof(o));
+
+    if (parse_opts(argc, argv, &o) < 0) {
+        fprintf(stderr,
+            "Usage: %s [-d /dev/video2] [-H heap] [-e export_dev] [-m mmap,heap,export,userptr,hugepage]\n"
+            "          [-f yuyv,yuv420m] [-r 640x480,...,3840x2160] [-b 2,4] [-c 1,2]\n"
+            "          [-n frames] [-w warmup] [-R ring_entries] [-C]\n", argv[0]);
+        return 1;
+    }
+
+    printf("{\"device\": \"%s\", \"frames_per_context\": %u, \"warmup\": %u, \"ring_entries\": %u, \"noncoherent\": %s, \"runs\": [",
+           o.dev, o.frames, o.warmup, o.ring, o.noncoherent ? "true" : "false");
+
+    int first = 1, failed = 0;
+    for (unsigned mi = 0; mi < o.nmodes; mi++)
+    for (unsigned fi = 0; fi < o.nfmts; fi++)
+    for (unsigned ri = 0; ri < o.nres; ri++)
+    for (unsigned bi = 0; bi < o.nbufs; bi++)
+    for (unsigned ci = 0; ci < o.nctx; ci++) {
+        struct bench_cfg cfg = {
+            .mode = o.modes[mi], .fourcc = o.fmts[fi],
+            .w = o.res[ri][0], .h = o.res[ri][1],
+            .nbufs = o.bufs[bi], .nctx = o.ctxs[ci],
+        };
+        if (run_one(&o, &cfg, first) < 0) failed++;
+        first = 0;
+    }
+
+    printf("\n]}\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,510 @@
+// recplay.c
+// Record a camera stream to a pcraw container and replay it through privcam.
+//
+//   recplay record [-d /dev/video0] [-s WxH] [-f yuyv|mjpeg|h264] [-n frames] out.pcraw
+//       Captures from the camera (MMAP, same path as cam_to_privcam_dmabuf) and stores every
+//       frame with its capture timestamp, sequence number and bytesused. Compressed frames keep
+//       their real size in the index, and replay queues exactly that many bytes.
+//
+//   recplay replay [-d /dev/video2] [-H heap] [-b bufs] [-l loops] [-F] [-o out.pcraw] in.pcraw
+//       Feeds the recording into privcam OUTPUT as DMABUF from the dma-heap pool. By default each
+//       frame is released at its original offset from the first frame, paced by an absolute
+//       CLOCK_MONOTONIC timerfd; -F pushes frames as fast as privcam takes them. Completions are
+//       reaped from the same poll loop, so pacing does not stall on DQBUF.
+//
+// gcc -O2 -Wall -Wextra -o recplay recplay.c
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dmaheap_pool.h"
+#include "pcraw.h"
+
+#define RECPLAY_MAX_BUFS 32
+#define RECPLAY_LATE_NS  1000000ull     // released more than 1 ms after its slot
+
+struct mmap_buf {
+    void  *addr;
+    size_t len;
+};
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+    int r;
+    do { r = ioctl(fd, req, arg); } while (r == -1 && errno == EINTR);
+    return r;
+}
+
+static void die(const char *msg)
+{
+    perror(msg);
+    exit(1);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t reqbufs(int fd, enum v4l2_buf_type type, enum v4l2_memory mem, uint32_t count)
+{
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = type;
+    req.memory = mem;
+
+    if (xioctl(fd, VIDIOC_REQBUFS, &req) == -1)
+        die("VIDIOC_REQBUFS");
+    if (req.count < 1) {
+        fprintf(stderr, "REQBUFS returned count=%u\n", req.count);
+        exit(1);
+    }
+    return req.count;
+}
+
+static void stream(int fd, enum v4l2_buf_type type, int on)
+{
+    if (xioctl(fd, on ? VIDIOC_STREAMON : VIDIOC_STREAMOFF, &type) == -1)
+        die(on ? "VIDIOC_STREAMON" : "VIDIOC_STREAMOFF");
+}
+
+/* ---- record ---- */
+
+static int do_record(int argc, char **argv)
+{
+    const char *cam_dev = "/dev/video0";
+    uint32_t w = 640, h = 480, nframes = 300, fourcc = V4L2_PIX_FMT_YUYV;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:s:f:n:")) != -1) {
+        switch (opt) {
+        case 'd': cam_dev = optarg; break;
+        case 's': if (sscanf(optarg, "%ux%u", &w, &h) != 2) return 2; break;
+        case 'f':
+            if (!strcmp(optarg, "yuyv")) fourcc = V4L2_PIX_FMT_YUYV;
+            else if (!strcmp(optarg, "mjpeg")) fourcc = V4L2_PIX_FMT_MJPEG;
+            else if (!strcmp(optarg, "h264")) fourcc = V4L2_PIX_FMT_H264;
+            else return 2;
+            break;
+        case 'n': nframes = (uint32_t)atoi(optarg); break;
+        default: return 2;
+        }
+    }
+    if (optind != argc - 1 || !nframes) return 2;
+    const char *out_path = argv[optind];
+
+    int cam_fd = open(cam_dev, O_RDWR | O_CLOEXEC);
+    if (cam_fd < 0) die("open camera");
+
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = w;
+    fmt.fmt.pix.height = h;
+    fmt.fmt.pix.pixelformat = fourcc;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    if (xioctl(cam_fd, VIDIOC_S_FMT, &fmt) == -1) die("VIDIOC_S_FMT");
+    if (fmt.fmt.pix.pixelformat != fourcc) {
+        fprintf(stderr, "%s does not capture %.4s\n", cam_dev, (char *)&fourcc);
+        return 1;
+    }
+
+    // Record what the camera actually negotiated, including padded strides. For compressed
+    // formats bytesperline is 0 and sizeimage is the largest frame the camera will produce.
+    int compressed = fourcc != V4L2_PIX_FMT_YUYV;
+    w = fmt.fmt.pix.width;
+    h = fmt.fmt.pix.height;
+    uint32_t bpl = compressed ? 0 : fmt.fmt.pix.bytesperline ? fmt.fmt.pix.bytesperline : w * 2;
+    uint32_t size = fmt.fmt.pix.sizeimage ? fmt.fmt.pix.sizeimage : w * h * 2;
+
+    uint32_t count = reqbufs(cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, V4L2_MEMORY_MMAP, 4);
+    struct mmap_buf *bufs = calloc(count, sizeof(*bufs));
+    if (!bufs) die("calloc");
+
+    for (uint32_t i = 0; i < count; i++) {
+        struct v4l2_buffer b;
+        memset(&b, 0, sizeof(b));
+        b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        b.memory = V4L2_MEMORY_MMAP;
+        b.index = i;
+        if (xioctl(cam_fd, VIDIOC_QUERYBUF, &b) == -1) die("VIDIOC_QUERYBUF");
+        bufs[i].len = b.length;
+        bufs[i].addr = mmap(NULL, b.length, PROT_READ, MAP_SHARED, cam_fd, b.m.offset);
+        if (bufs[i].addr == MAP_FAILED) die("mmap");
+        if (xioctl(cam_fd, VIDIOC_QBUF, &b) == -1) die("VIDIOC_QBUF");
+    }
+
+    struct pcraw rec;
+    if (pcraw_create(&rec, out_path, w, h, fourcc, 1, &bpl, &size, nframes) < 0) return 1;
+
+    fprintf(stderr, "Recording %u frames %ux%u %.4s from %s to %s\n", nframes, w, h, (char *)&fourcc, cam_dev, out_path);
+    stream(cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 1);
+
+    for (uint32_t n = 0; n < nframes; n++) {
+        struct v4l2_buffer b;
+        memset(&b, 0, sizeof(b));
+        b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        b.memory = V4L2_MEMORY_MMAP;
+        if (xioctl(cam_fd, VIDIOC_DQBUF, &b) == -1) die("camera VIDIOC_DQBUF");
+
+        const void *planes[1] = { bufs[b.index].addr };
+        uint32_t used = b.bytesused ? b.bytesused : size;
+        uint64_t ts = (uint64_t)b.timestamp.tv_sec * 1000000000ull + (uint64_t)b.timestamp.tv_usec * 1000ull;
+        if (pcraw_append(&rec, planes, &used, ts, b.sequence) < 0) return 1;
+
+        if (xioctl(cam_fd, VIDIOC_QBUF, &b) == -1) die("camera re-QBUF");
+    }
+
+    stream(cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0);
+    pcraw_close(&rec);
+    for (uint32_t i = 0; i < count; i++)
+        munmap(bufs[i].addr, bufs[i].len);
+    free(bufs);
+    close(cam_fd);
+    fprintf(stderr, "Recorded %u frames\n", nframes);
+    return 0;
+}
+
+/* ---- replay ---- */
+
+struct replay {
+    int vfd;
+    unsigned nplanes;
+    unsigned nbufs;
+    const struct pcraw *in;
+
+    struct dmaheap_buf *out[RECPLAY_MAX_BUFS];
+    unsigned free_out[RECPLAY_MAX_BUFS];        // stack of idle OUTPUT indices
+    unsigned nfree;
+
+    struct mmap_buf cap[RECPLAY_MAX_BUFS][PCRAW_MAX_PLANES];
+    struct pcraw *rec;                          // optional output recording
+
+    uint64_t done;
+};
+
+static void qbuf_capture(struct replay *r, unsigned index)
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[PCRAW_MAX_PLANES];
+    memset(&b, 0, sizeof(b));
+    memset(planes, 0, sizeof(planes));
+    b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    b.memory = V4L2_MEMORY_MMAP;
+    b.index = index;
+    b.length = r->nplanes;
+    b.m.planes = planes;
+    if (xioctl(r->vfd, VIDIOC_QBUF, &b) == -1) die("VIDIOC_QBUF cap");
+}
+
+// Load frame n straight from the file into an idle OUTPUT dmabuf and queue it. The dmabuf has
+// the pcraw frame layout, so one pread fills every plane and data_offset = plane_offset.
+static void queue_frame(struct replay *r, uint64_t n)
+{
+    const struct pcraw_header *hdr = r->in->hdr;
+    const struct pcraw_index *e = &r->in->index[n];
+    unsigned idx = r->free_out[--r->nfree];
+    struct dmaheap_buf *db = r->out[idx];
+
+    // Read only up to the end of the last plane's payload: compressed frames are much shorter
+    // than the stride reserved for them. pcraw_open() checked every plane fits the stride, which
+    // is the dmabuf size.
+    unsigned last = r->nplanes - 1;
+    size_t len = hdr->plane_offset[last] + pcraw_plane_bytes(r->in, e, last);
+
+    struct dma_buf_sync sync = { .flags = DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE };
+    xioctl(db->fd, DMA_BUF_IOCTL_SYNC, &sync);
+    if (pread(r->in->fd, db->addr, len, (off_t)e->offset) != (ssize_t)len)
+        die("pread frame");
+    sync.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE;
+    xioctl(db->fd, DMA_BUF_IOCTL_SYNC, &sync);
+
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[PCRAW_MAX_PLANES];
+    memset(&b, 0, sizeof(b));
+    memset(planes, 0, sizeof(planes));
+    b.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    b.memory = V4L2_MEMORY_DMABUF;
+    b.index = idx;
+    b.length = r->nplanes;
+    b.m.planes = planes;
+    b.timestamp.tv_sec = (time_t)(e->timestamp_ns / 1000000000ull);
+    b.timestamp.tv_usec = (suseconds_t)(e->timestamp_ns % 1000000000ull / 1000);
+
+    for (unsigned p = 0; p < r->nplanes; p++) {
+        planes[p].m.fd = db->fd;
+        planes[p].length = (uint32_t)db->size;
+        planes[p].data_offset = hdr->plane_offset[p];
+        planes[p].bytesused = hdr->plane_offset[p] + pcraw_plane_bytes(r->in, e, p);
+    }
+    if (xioctl(r->vfd, VIDIOC_QBUF, &b) == -1) die("VIDIOC_QBUF out");
+}
+
+// Reap whatever privcam has finished; returns without blocking
+static void reap(struct replay *r, short revents)
+{
+    struct v4l2_buffer b;
+    struct v4l2_plane planes[PCRAW_MAX_PLANES];
+
+    while (revents & POLLIN) {
+        memset(&b, 0, sizeof(b));
+        memset(planes, 0, sizeof(planes));
+        b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        b.memory = V4L2_MEMORY_MMAP;
+        b.length = r->nplanes;
+        b.m.planes = planes;
+        if (xioctl(r->vfd, VIDIOC_DQBUF, &b) == -1) {
+            if (errno == EAGAIN) break;
+            die("VIDIOC_DQBUF cap");
+        }
+
+        if (r->rec) {
+            const void *data[PCRAW_MAX_PLANES];
+            uint32_t used[PCRAW_MAX_PLANES];
+            for (unsigned p = 0; p < r->nplanes; p++) {
+                data[p] = r->cap[b.index][p].addr;
+                used[p] = planes[p].bytesused;
+            }
+            uint64_t ts = (uint64_t)b.timestamp.tv_sec * 1000000000ull + (uint64_t)b.timestamp.tv_usec * 1000ull;
+            if (pcraw_append(r->rec, data, used, ts, b.sequence) < 0) exit(1);
+        }
+        r->done++;
+        qbuf_capture(r, b.index);
+    }
+
+    while (revents & POLLOUT) {
+        memset(&b, 0, sizeof(b));
+        memset(planes, 0, sizeof(planes));
+        b.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        b.memory = V4L2_MEMORY_DMABUF;
+        b.length = r->nplanes;
+        b.m.planes = planes;
+        if (xioctl(r->vfd, VIDIOC_DQBUF, &b) == -1) {
+            if (errno == EAGAIN) break;
+            die("VIDIOC_DQBUF out");
+        }
+        r->free_out[r->nfree++] = b.index;
+    }
+}
+
+static void wait_events(struct replay *r, int tfd, int *timer_fired)
+{
+    struct pollfd pfd[2] = {
+        { .fd = r->vfd, .events = POLLIN | POLLOUT },
+        { .fd = tfd, .events = POLLIN },
+    };
+
+    if (poll(pfd, tfd >= 0 ? 2 : 1, -1) < 0) {
+        if (errno == EINTR) return;
+        die("poll");
+    }
+    if (pfd[0].revents & POLLERR) {
+        fprintf(stderr, "privcam poll error\n");
+        exit(1);
+    }
+    reap(r, pfd[0].revents);
+
+    if (tfd >= 0 && (pfd[1].revents & POLLIN)) {
+        uint64_t expirations;
+        if (read(tfd, &expirations, sizeof(expirations)) == (ssize_t)sizeof(expirations))
+            *timer_fired = 1;
+    }
+}
+
+static int do_replay(int argc, char **argv)
+{
+    const char *dev = "/dev/video2", *heap = "/dev/dma_heap/system", *out_path = NULL;
+    unsigned nbufs = 4, loops = 1;
+    int fast = 0, opt;
+
+    while ((opt = getopt(argc, argv, "d:H:b:l:Fo:")) != -1) {
+        switch (opt) {
+        case 'd': dev = optarg; break;
+        case 'H': heap = optarg; break;
+        case 'b': nbufs = (unsigned)atoi(optarg); break;
+        case 'l': loops = (unsigned)atoi(optarg); break;
+        case 'F': fast = 1; break;
+        case 'o': out_path = optarg; break;
+        default: return 2;
+        }
+    }
+    if (optind != argc - 1 || nbufs < 1 || nbufs > RECPLAY_MAX_BUFS || !loops) return 2;
+
+    struct pcraw in;
+    if (pcraw_open(&in, argv[optind]) < 0) return 1;
+    const struct pcraw_header *hdr = in.hdr;
+    const uint64_t nframes = pcraw_frame_count(&in);
+    if (!nframes) { fprintf(stderr, "empty recording\n"); return 1; }
+
+    struct replay r;
+    memset(&r, 0, sizeof(r));
+    r.in = &in;
+    r.nplanes = hdr->num_planes;
+    r.vfd = open(dev, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (r.vfd < 0) die("open privcam");
+
+    for (int q = 0; q < 2; q++) {
+        struct v4l2_format fmt;
+        memset(&fmt, 0, sizeof(fmt));
+        fmt.type = q ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        fmt.fmt.pix_mp.width = hdr->width;
+        fmt.fmt.pix_mp.height = hdr->height;
+        fmt.fmt.pix_mp.pixelformat = hdr->fourcc;
+        fmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+        fmt.fmt.pix_mp.num_planes = r.nplanes;
+        for (unsigned p = 0; p < r.nplanes; p++) {
+            fmt.fmt.pix_mp.plane_fmt[p].bytesperline = hdr->bytesperline[p];
+            fmt.fmt.pix_mp.plane_fmt[p].sizeimage = hdr->plane_size[p];
+        }
+        if (xioctl(r.vfd, VIDIOC_S_FMT, &fmt) == -1) die("VIDIOC_S_FMT");
+        if (fmt.fmt.pix_mp.pixelformat != hdr->fourcc || fmt.fmt.pix_mp.num_planes != r.nplanes) {
+            fprintf(stderr, "privcam does not take %.4s with %u planes\n", (char *)&hdr->fourcc, r.nplanes);
+            return 1;
+        }
+    }
+
+    // OUTPUT: pool buffers shaped like a pcraw frame
+    struct dmaheap_pool pool;
+    if (dmaheap_pool_init(&pool, heap, nbufs) < 0) return 1;
+    if (dmaheap_pool_reserve(&pool, hdr->frame_stride, nbufs) < 0) return 1;
+    r.nbufs = reqbufs(r.vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_DMABUF, nbufs);
+    if (r.nbufs > nbufs) r.nbufs = nbufs;
+    for (unsigned i = 0; i < r.nbufs; i++) {
+        r.out[i] = dmaheap_pool_get(&pool, hdr->frame_stride);
+        if (!r.out[i]) return 1;
+        r.free_out[r.nfree++] = i;
+    }
+
+    // CAPTURE: MMAP
+    uint32_t cap_count = reqbufs(r.vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_MEMORY_MMAP, nbufs);
+    if (cap_count > RECPLAY_MAX_BUFS) cap_count = RECPLAY_MAX_BUFS;
+    for (uint32_t i = 0; i < cap_count; i++) {
+        struct v4l2_buffer b;
+        struct v4l2_plane planes[PCRAW_MAX_PLANES];
+        memset(&b, 0, sizeof(b));
+        memset(planes, 0, sizeof(planes));
+        b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        b.memory = V4L2_MEMORY_MMAP;
+        b.index = i;
+        b.length = r.nplanes;
+        b.m.planes = planes;
+        if (xioctl(r.vfd, VIDIOC_QUERYBUF, &b) == -1) die("VIDIOC_QUERYBUF");
+        for (unsigned p = 0; p < r.nplanes; p++) {
+            r.cap[i][p].len = planes[p].length;
+            r.cap[i][p].addr = mmap(NULL, planes[p].length, PROT_READ, MAP_SHARED, r.vfd, planes[p].m.mem_offset);
+            if (r.cap[i][p].addr == MAP_FAILED) die("mmap cap");
+        }
+        qbuf_capture(&r, i);
+    }
+
+    struct pcraw rec;
+    if (out_path) {
+        uint32_t sizes[PCRAW_MAX_PLANES];
+        for (unsigned p = 0; p < r.nplanes; p++) sizes[p] = hdr->plane_size[p];
+        if (pcraw_create(&rec, out_path, hdr->width, hdr->height, hdr->fourcc, r.nplanes,
+                         hdr->bytesperline, sizes, nframes * loops) < 0)
+            return 1;
+        r.rec = &rec;
+    }
+
+    int tfd = -1;
+    if (!fast) {
+        tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if (tfd < 0) die("timerfd_create");
+    }
+
+    stream(r.vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, 1);
+    stream(r.vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, 1);
+
+    fprintf(stderr, "Replaying %llu frames x %u %ux%u %.4s %s\n", (unsigned long long)nframes, loops,
+            hdr->width, hdr->height, (char *)&hdr->fourcc, fast ? "as fast as possible" : "at recorded timing");
+
+    const uint64_t total = nframes * loops;
+    const uint64_t span = in.index[nframes - 1].timestamp_ns - in.index[0].timestamp_ns;
+    const uint64_t period = nframes > 1 ? span / (nframes - 1) : 0;
+    uint64_t start = now_ns(), late = 0;
+
+    for (uint64_t k = 0; k < total; k++) {
+        uint64_t n = k % nframes, loop = k / nframes;
+
+        if (!fast) {
+            // Absolute deadline keeps the schedule from drifting; loops continue one period on
+            uint64_t deadline = start + loop * (span + period) + (in.index[n].timestamp_ns - in.index[0].timestamp_ns);
+            struct itimerspec its;
+            memset(&its, 0, sizeof(its));
+            its.it_value.tv_sec = (time_t)(deadline / 1000000000ull);
+            its.it_value.tv_nsec = (long)(deadline % 1000000000ull);
+            if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) die("timerfd_settime");
+
+            int fired = 0;
+            while (!fired)
+                wait_events(&r, tfd, &fired);
+            if (now_ns() - deadline > RECPLAY_LATE_NS)
+                late++;
+        }
+
+        while (!r.nfree)
+            wait_events(&r, -1, NULL);
+        queue_frame(&r, n);
+    }
+
+    while (r.done < total)
+        wait_events(&r, -1, NULL);
+
+    double elapsed = (double)(now_ns() - start) / 1e9;
+    fprintf(stderr, "Replayed %llu frames in %.3f s: %.2f fps", (unsigned long long)r.done, elapsed,
+            (double)r.done / elapsed);
+    if (!fast)
+        fprintf(stderr, ", recorded %.2f fps, %llu late", period ? 1e9 / (double)period : 0.0,
+                (unsigned long long)late);
+    fprintf(stderr, "\n");
+
+    stream(r.vfd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, 0);
+    stream(r.vfd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, 0);
+
+    if (r.rec) pcraw_close(r.rec);
+    if (tfd >= 0) close(tfd);
+    for (uint32_t i = 0; i < cap_count; i++)
+        for (unsigned p = 0; p < r.nplanes; p++)
+            munmap(r.cap[i][p].addr, r.cap[i][p].len);
+    for (unsigned i = 0; i < r.nbufs; i++)
+        dmaheap_pool_put(r.out[i]);
+    dmaheap_pool_destroy(&pool);
+    close(r.vfd);
+    pcraw_close(&in);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = 2;
+
+    if (argc > 1 && !strcmp(argv[1], "record"))
+        ret = do_record(argc - 1, argv + 1);
+    else if (argc > 1 && !strcmp(argv[1], "replay"))
+        ret = do_replay(argc - 1, argv + 1);
+
+    if (ret == 2)
+        fprintf(stderr,
+            "Usage:\n"
+            "  %s record [-d /dev/video0] [-s WxH] [-f yuyv|mjpeg|h264] [-n frames] out.pcraw\n"
+            "  %s replay [-d /dev/video2] [-H heap] [-b bufs] [-l loops] [-F] [-o out.pcraw] in.pcraw\n",
+            argv[0], argv[0]);
+    return ret;
+}
@@ -0,0 +1,510 @@
+// yuvconv.c
+// YUYV <-> I420 converter and plane splitter for the resource/ corpus and camera dumps.
+// Works on whole multi-frame files (frame count = file size / frame size). Frame layouts:
+//   yuyv    packed 4:2:2, w*h*2 bytes per frame
+//   i420    planar 4:2:0 in one file, Y then U then V per frame
+//   planes  planar 4:2:0 split into <name>.y <name>.u <name>.v (what dma_multiplane_privcam reads)
+// YUYV -> 4:2:0 averages the chroma of each row pair, 4:2:0 -> YUYV repeats it on both rows.
+//
+// Row kernels come in scalar (reference), SSE2, AVX2 and NEON flavours; the fastest one the CPU
+// supports is picked at startup unless -k forces one. -V checks every frame against the scalar
+// path. With -H the output frame is converted straight into a dma-heap buffer (dmaheap_pool.h)
+// and written to disk from its mapping.
+//
+// gcc -O2 -Wall -Wextra -o yuvconv yuvconv.c
+// ./yuvconv -i yuyv -o planes -s 640x480 ../resource/frame.yuyv ../resource/in
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define YUVCONV_X86 1
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define YUVCONV_NEON 1
+#endif
+
+#include "dmaheap_pool.h"
+
+enum layout { LAYOUT_YUYV, LAYOUT_I420, LAYOUT_PLANES };
+
+// Convert one row pair. y0/y1 are luma rows, u/v the shared chroma row, w is even.
+typedef void (*pack_rows_fn)(const uint8_t *s0, const uint8_t *s1,
+                             uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v, unsigned w);
+typedef void (*unpack_rows_fn)(const uint8_t *y0, const uint8_t *y1, const uint8_t *u, const uint8_t *v,
+                               uint8_t *d0, uint8_t *d1, unsigned w);
+
+struct kernel {
+    const char *name;
+    pack_rows_fn yuyv_to_420;
+    unpack_rows_fn i420_to_yuyv;
+};
+
+/* ---- scalar reference ---- */
+
+static void yuyv_to_420_scalar(const uint8_t *s0, const uint8_t *s1,
+                               uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v, unsigned w)
+{
+    for (unsigned x = 0; x < w; x += 2) {
+        const uint8_t *a = s0 + x * 2, *b = s1 + x * 2;
+        y0[x] = a[0]; y0[x + 1] = a[2];
+        y1[x] = b[0]; y1[x + 1] = b[2];
+        u[x / 2] = (uint8_t)((a[1] + b[1] + 1) >> 1);
+        v[x / 2] = (uint8_t)((a[3] + b[3] + 1) >> 1);
+    }
+}
+
+static void i420_to_yuyv_scalar(const uint8_t *y0, const uint8_t *y1, const uint8_t *u, const uint8_t *v,
+                                uint8_t *d0, uint8_t *d1, unsigned w)
+{
+    for (unsigned x = 0; x < w; x += 2) {
+        uint8_t *a = d0 + x * 2, *b = d1 + x * 2;
+        a[0] = y0[x]; a[1] = u[x / 2]; a[2] = y0[x + 1]; a[3] = v[x / 2];
+        b[0] = y1[x]; b[1] = u[x / 2]; b[2] = y1[x + 1]; b[3] = v[x / 2];
+    }
+}
+
+/* ---- SSE2 / AVX2 ---- */
+
+#ifdef YUVCONV_X86
+__attribute__((target("sse2")))
+static void yuyv_to_420_sse2(const uint8_t *s0, const uint8_t *s1,
+                             uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v, unsigned w)
+{
+    const __m128i lo = _mm_set1_epi16(0x00ff);
+    unsigned x = 0;
+
+    for (; x + 16 <= w; x += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(s0 + x * 2));
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(s0 + x * 2 + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(s1 + x * 2));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(s1 + x * 2 + 16));
+
+        _mm_storeu_si128((__m128i *)(y0 + x), _mm_packus_epi16(_mm_and_si128(a0, lo), _mm_and_si128(a1, lo)));
+        _mm_storeu_si128((__m128i *)(y1 + x), _mm_packus_epi16(_mm_and_si128(b0, lo), _mm_and_si128(b1, lo)));
+
+        // U0 V0 U1 V1 ... for each row, then the rounded vertical average
+        __m128i ca = _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(a1, 8));
+        __m128i cb = _mm_packus_epi16(_mm_srli_epi16(b0, 8), _mm_srli_epi16(b1, 8));
+        __m128i c = _mm_avg_epu8(ca, cb);
+
+        __m128i cu = _mm_packus_epi16(_mm_and_si128(c, lo), _mm_setzero_si128());
+        __m128i cv = _mm_packus_epi16(_mm_srli_epi16(c, 8), _mm_setzero_si128());
+        _mm_storel_epi64((__m128i *)(u + x / 2), cu);
+        _mm_storel_epi64((__m128i *)(v + x / 2), cv);
+    }
+    if (x < w)
+        yuyv_to_420_scalar(s0 + x * 2, s1 + x * 2, y0 + x, y1 + x, u + x / 2, v + x / 2, w - x);
+}
+
+__attribute__((target("sse2")))
+static void i420_to_yuyv_sse2(const uint8_t *y0, const uint8_t *y1, const uint8_t *u, const uint8_t *v,
+                              uint8_t *d0, uint8_t *d1, unsigned w)
+{
+    unsigned x = 0;
+
+    for (; x + 16 <= w; x += 16) {
+        __m128i ya = _mm_loadu_si128((const __m128i *)(y0 + x));
+        __m128i yb = _mm_loadu_si128((const __m128i *)(y1 + x));
+        __m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(u + x / 2)),
+                                       _mm_loadl_epi64((const __m128i *)(v + x / 2)));
+
+        _mm_storeu_si128((__m128i *)(d0 + x * 2), _mm_unpacklo_epi8(ya, uv));
+        _mm_storeu_si128((__m128i *)(d0 + x * 2 + 16), _mm_unpackhi_epi8(ya, uv));
+        _mm_storeu_si128((__m128i *)(d1 + x * 2), _mm_unpacklo_epi8(yb, uv));
+        _mm_storeu_si128((__m128i *)(d1 + x * 2 + 16), _mm_unpackhi_epi8(yb, uv));
+    }
+    if (x < w)
+        i420_to_yuyv_scalar(y0 + x, y1 + x, u + x / 2, v + x / 2, d0 + x * 2, d1 + x * 2, w - x);
+}
+
+__attribute__((target("avx2")))
+static void yuyv_to_420_avx2(const uint8_t *s0, const uint8_t *s1,
+                             uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v, unsigned w)
+{
+    const __m256i lo = _mm256_set1_epi16(0x00ff);
+    unsigned x = 0;
+
+    // 256-bit packs work per 128-bit lane; permute4x64(0xd8) restores linear order
+    for (; x + 32 <= w; x += 32) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(s0 + x * 2));
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)(s0 + x * 2 + 32));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(s1 + x * 2));
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(s1 + x * 2 + 32));
+
+        __m256i ya = _mm256_packus_epi16(_mm256_and_si256(a0, lo), _mm256_and_si256(a1, lo));
+        __m256i yb = _mm256_packus_epi16(_mm256_and_si256(b0, lo), _mm256_and_si256(b1, lo));
+        _mm256_storeu_si256((__m256i *)(y0 + x), _mm256_permute4x64_epi64(ya, 0xd8));
+        _mm256_storeu_si256((__m256i *)(y1 + x), _mm256_permute4x64_epi64(yb, 0xd8));
+
+        __m256i ca = _mm256_packus_epi16(_mm256_srli_epi16(a0, 8), _mm256_srli_epi16(a1, 8));
+        __m256i cb = _mm256_packus_epi16(_mm256_srli_epi16(b0, 8), _mm256_srli_epi16(b1, 8));
+        __m256i c = _mm256_permute4x64_epi64(_mm256_avg_epu8(ca, cb), 0xd8);
+
+        __m256i cu = _mm256_packus_epi16(_mm256_and_si256(c, lo), _mm256_setzero_si256());
+        __m256i cv = _mm256_packus_epi16(_mm256_srli_epi16(c, 8), _mm256_setzero_si256());
+        _mm_storeu_si128((__m128i *)(u + x / 2), _mm256_castsi256_si128(_mm256_permute4x64_epi64(cu, 0xd8)));
+        _mm_storeu_si128((__m128i *)(v + x / 2), _mm256_castsi256_si128(_mm256_permute4x64_epi64(cv, 0xd8)));
+    }
+    if (x < w)
+        yuyv_to_420_sse2(s0 + x * 2, s1 + x * 2, y0 + x, y1 + x, u + x / 2, v + x / 2, w - x);
+}
+
+__attribute__((target("avx2")))
+static void i420_to_yuyv_avx2(const uint8_t *y0, const uint8_t *y1, const uint8_t *u, const uint8_t *v,
+                              uint8_t *d0, uint8_t *d1, unsigned w)
+{
+    unsigned x = 0;
+
+    for (; x + 32 <= w; x += 32) {
+        __m256i ya = _mm256_loadu_si256((const __m256i *)(y0 + x));
+        __m256i yb = _mm256_loadu_si256((const __m256i *)(y1 + x));
+        __m128i cu = _mm_loadu_si128((const __m128i *)(u + x / 2));
+        __m128i cv = _mm_loadu_si128((const __m128i *)(v + x / 2));
+        __m256i uv = _mm256_set_m128i(_mm_unpackhi_epi8(cu, cv), _mm_unpacklo_epi8(cu, cv));
+
+        // unpack per lane gives pixels {0-7,16-23} and {8-15,24-31}; recombine lanes
+        __m256i la = _mm256_unpacklo_epi8(ya, uv), ha = _mm256_unpackhi_epi8(ya, uv);
+        __m256i lb = _mm256_unpacklo_epi8(yb, uv), hb = _mm256_unpackhi_epi8(yb, uv);
+        _mm256_storeu_si256((__m256i *)(d0 + x * 2), _mm256_permute2x128_si256(la, ha, 0x20));
+        _mm256_storeu_si256((__m256i *)(d0 + x * 2 + 32), _mm256_permute2x128_si256(la, ha, 0x31));
+        _mm256_storeu_si256((__m256i *)(d1 + x * 2), _mm256_permute2x128_si256(lb, hb, 0x20));
+        _mm256_storeu_si256((__m256i *)(d1 + x * 2 + 32), _mm256_permute2x128_si256(lb, hb, 0x31));
+    }
+    if (x < w)
+        i420_to_yuyv_sse2(y0 + x, y1 + x, u + x / 2, v + x / 2, d0 + x * 2, d1 + x * 2, w - x);
+}
+#endif
+
+/* ---- NEON ---- */
+
+#ifdef YUVCONV_NEON
+static void yuyv_to_420_neon(const uint8_t *s0, const uint8_t *s1,
+                             uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v, unsigned w)
+{
+    unsigned x = 0;
+
+    // vld4 splits 32 pixels into Y even, U, Y odd, V
+    for (; x + 32 <= w; x += 32) {
+        uint8x16x4_t a = vld4q_u8(s0 + x * 2);
+        uint8x16x4_t b = vld4q_u8(s1 + x * 2);
+        uint8x16x2_t ya = { { a.val[0], a.val[2] } };
+        uint8x16x2_t yb = { { b.val[0], b.val[2] } };
+
+        vst2q_u8(y0 + x, ya);
+        vst2q_u8(y1 + x, yb);
+        vst1q_u8(u + x / 2, vrhaddq_u8(a.val[1], b.val[1]));
+        vst1q_u8(v + x / 2, vrhaddq_u8(a.val[3], b.val[3]));
+    }
+    if (x < w)
+        yuyv_to_420_scalar(s0 + x * 2, s1 + x * 2, y0 + x, y1 + x, u + x / 2, v + x / 2, w - x);
+}
+
+static void i420_to_yuyv_neon(const uint8_t *y0, const uint8_t *y1, const uint8_t *u, const uint8_t *v,
+                              uint8_t *d0, uint8_t *d1, unsigned w)
+{
+    unsigned x = 0;
+
+    for (; x + 32 <= w; x += 32) {
+        uint8x16x2_t ya = vld2q_u8(y0 + x);
+        uint8x16x2_t yb = vld2q_u8(y1 + x);
+        uint8x16_t cu = vld1q_u8(u + x / 2);
+        uint8x16_t cv = vld1q_u8(v + x / 2);
+        uint8x16x4_t a = { { ya.val[0], cu, ya.val[1], cv } };
+        uint8x16x4_t b = { { yb.val[0], cu, yb.val[1], cv } };
+
+        vst4q_u8(d0 + x * 2, a);
+        vst4q_u8(d1 + x * 2, b);
+    }
+    if (x < w)
+        i420_to_yuyv_scalar(y0 + x, y1 + x, u + x / 2, v + x / 2, d0 + x * 2, d1 + x * 2, w - x);
+}
+#endif
+
+static const struct kernel kernels[] = {
+    { "scalar", yuyv_to_420_scalar, i420_to_yuyv_scalar },
+#ifdef YUVCONV_X86
+    { "sse2",   yuyv_to_420_sse2,   i420_to_yuyv_sse2 },
+    { "avx2",   yuyv_to_420_avx2,   i420_to_yuyv_avx2 },
+#endif
+#ifdef YUVCONV_NEON
+    { "neon",   yuyv_to_420_neon,   i420_to_yuyv_neon },
+#endif
+};
+
+#define NUM_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+static int kernel_supported(const struct kernel *k)
+{
+#ifdef YUVCONV_X86
+    if (!strcmp(k->name, "sse2")) return __builtin_cpu_supports("sse2");
+    if (!strcmp(k->name, "avx2")) return __builtin_cpu_supports("avx2");
+#endif
+    (void)k;
+    return 1;
+}
+
+static const struct kernel *pick_kernel(const char *name)
+{
+    const struct kernel *best = &kernels[0];
+
+    for (unsigned i = 0; i < NUM_KERNELS; i++) {
+        if (name && !strcmp(kernels[i].name, name))
+            return kernel_supported(&kernels[i]) ? &kernels[i] : NULL;
+        if (!name && kernel_supported(&kernels[i]))
+            best = &kernels[i];         // table is ordered slowest to fastest
+    }
+    return name ? NULL : best;
+}
+
+/* ---- frames and files ---- */
+
+struct frame {
+    uint8_t *p[3];      // yuyv uses p[0] only
+};
+
+struct mapped_file {
+    uint8_t *addr;
+    size_t len;
+};
+
+static size_t layout_frame_size(enum layout l, unsigned w, unsigned h)
+{
+    return l == LAYOUT_YUYV ? (size_t)w * h * 2 : (size_t)w * h * 3 / 2;
+}
+
+static int map_input(const char *path, struct mapped_file *mf)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { perror(path); return -1; }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) { perror("fstat"); close(fd); return -1; }
+
+    mf->len = (size_t)st.st_size;
+    mf->addr = mf->len ? mmap(NULL, mf->len, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (mf->addr == MAP_FAILED) { perror("mmap input"); return -1; }
+    if (mf->addr) madvise(mf->addr, mf->len, MADV_SEQUENTIAL);
+    return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    while (len) {
+        ssize_t r = write(fd, p, len);
+        if (r < 0) { if (errno == EINTR) continue; perror("write"); return -1; }
+        p += r;
+        len -= (size_t)r;
+    }
+    return 0;
+}
+
+static void planar_frame(uint8_t *base, unsigned w, unsigned h, struct frame *f)
+{
+    f->p[0] = base;
+    f->p[1] = base + (size_t)w * h;
+    f->p[2] = f->p[1] + (size_t)w * h / 4;
+}
+
+static void convert_frame(const struct kernel *k, enum layout in, enum layout out,
+                          const struct frame *src, struct frame *dst, unsigned w, unsigned h)
+{
+    const size_t ysz = (size_t)w * h, csz = ysz / 4;
+
+    if (in == LAYOUT_YUYV && out == LAYOUT_YUYV) {
+        memcpy(dst->p[0], src->p[0], ysz * 2);
+    } else if (in == LAYOUT_YUYV) {
+        for (unsigned r = 0; r < h; r += 2)
+            k->yuyv_to_420(src->p[0] + (size_t)r * w * 2, src->p[0] + (size_t)(r + 1) * w * 2,
+                           dst->p[0] + (size_t)r * w, dst->p[0] + (size_t)(r + 1) * w,
+                           dst->p[1] + (size_t)r / 2 * w / 2, dst->p[2] + (size_t)r / 2 * w / 2, w);
+    } else if (out == LAYOUT_YUYV) {
+        for (unsigned r = 0; r < h; r += 2)
+            k->i420_to_yuyv(src->p[0] + (size_t)r * w, src->p[0] + (size_t)(r + 1) * w,
+                            src->p[1] + (size_t)r / 2 * w / 2, src->p[2] + (size_t)r / 2 * w / 2,
+                            dst->p[0] + (size_t)r * w * 2, dst->p[0] + (size_t)(r + 1) * w * 2, w);
+    } else {
+        // i420 <-> planes: same samples, different files
+        memcpy(dst->p[0], src->p[0], ysz);
+        memcpy(dst->p[1], src->p[1], csz);
+        memcpy(dst->p[2], src->p[2], csz);
+    }
+}
+
+static enum layout parse_layout(const char *s)
+{
+    if (!strcmp(s, "yuyv")) return LAYOUT_YUYV;
+    if (!strcmp(s, "i420")) return LAYOUT_I420;
+    if (!strcmp(s, "planes")) return LAYOUT_PLANES;
+    fprintf(stderr, "unknown layout %s\n", s);
+    exit(1);
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s -i yuyv|i420|planes -o yuyv|i420|planes -s WxH [-k scalar|sse2|avx2|neon]\n"
+        "          [-H /dev/dma_heap/system] [-V] input output\n"
+        "  'planes' input/output names are prefixes for <name>.y <name>.u <name>.v\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    enum layout in_l = LAYOUT_YUYV, out_l = LAYOUT_I420;
+    unsigned w = 640, h = 480;
+    const char *kname = NULL, *heap = NULL;
+    int verify = 0, opt;
+
+    while ((opt = getopt(argc, argv, "i:o:s:k:H:V")) != -1) {
+        switch (opt) {
+        case 'i': in_l = parse_layout(optarg); break;
+        case 'o': out_l = parse_layout(optarg); break;
+        case 's':
+            if (sscanf(optarg, "%ux%u", &w, &h) != 2) { usage(argv[0]); return 1; }
+            break;
+        case 'k': kname = optarg; break;
+        case 'H': heap = optarg; break;
+        case 'V': verify = 1; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (argc - optind != 2 || !w || !h || (w | h) & 1) { usage(argv[0]); return 1; }
+
+    const char *in_path = argv[optind], *out_path = argv[optind + 1];
+    const struct kernel *k = pick_kernel(kname);
+    if (!k) { fprintf(stderr, "kernel %s not available on this CPU\n", kname); return 1; }
+
+    const size_t ysz = (size_t)w * h, csz = ysz / 4;
+    const size_t in_fs = layout_frame_size(in_l, w, h), out_fs = layout_frame_size(out_l, w, h);
+    static const char *ext[3] = { "y", "u", "v" };
+    char name[3][4096];
+
+    // Inputs: one file, or three plane files
+    struct mapped_file in[3];
+    memset(in, 0, sizeof(in));
+    size_t nframes;
+    if (in_l == LAYOUT_PLANES) {
+        for (int p = 0; p < 3; p++) {
+            snprintf(name[p], sizeof(name[p]), "%s.%s", in_path, ext[p]);
+            if (map_input(name[p], &in[p]) < 0) return 1;
+        }
+        nframes = in[0].len / ysz;
+        if (in[1].len / csz < nframes) nframes = in[1].len / csz;
+        if (in[2].len / csz < nframes) nframes = in[2].len / csz;
+    } else {
+        if (map_input(in_path, &in[0]) < 0) return 1;
+        nframes = in[0].len / in_fs;
+        if (in[0].len % in_fs)
+            fprintf(stderr, "warning: %zu trailing bytes ignored\n", in[0].len % in_fs);
+    }
+
+    // Outputs: one file, or three plane files
+    int out_fd[3] = { -1, -1, -1 };
+    for (int p = 0; p < (out_l == LAYOUT_PLANES ? 3 : 1); p++) {
+        if (out_l == LAYOUT_PLANES)
+            snprintf(name[p], sizeof(name[p]), "%s.%s", out_path, ext[p]);
+        else
+            snprintf(name[p], sizeof(name[p]), "%s", out_path);
+        out_fd[p] = open(name[p], O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+        if (out_fd[p] < 0) { perror(name[p]); return 1; }
+    }
+
+    // Destination frame: a dma-heap buffer when asked for, else plain memory
+    struct dmaheap_pool pool;
+    struct dmaheap_buf *hb = NULL;
+    uint8_t *dst_base, *ref_base = NULL;
+    if (heap) {
+        if (dmaheap_pool_init(&pool, heap, 1) < 0) return 1;
+        hb = dmaheap_pool_get(&pool, out_fs);
+        if (!hb) return 1;
+        dst_base = hb->addr;
+    } else {
+        dst_base = malloc(out_fs);
+        if (!dst_base) { perror("malloc"); return 1; }
+    }
+    if (verify && !(ref_base = malloc(out_fs))) { perror("malloc"); return 1; }
+
+    fprintf(stderr, "%zu frames %ux%u, kernel %s%s\n", nframes, w, h, k->name, heap ? ", dma-heap" : "");
+
+    double t_conv = 0.0;
+    size_t mismatches = 0;
+    for (size_t n = 0; n < nframes; n++) {
+        struct frame src, dst, ref;
+
+        if (in_l == LAYOUT_YUYV) {
+            src.p[0] = in[0].addr + n * in_fs;
+        } else if (in_l == LAYOUT_I420) {
+            planar_frame(in[0].addr + n * in_fs, w, h, &src);
+        } else {
+            src.p[0] = in[0].addr + n * ysz;
+            src.p[1] = in[1].addr + n * csz;
+            src.p[2] = in[2].addr + n * csz;
+        }
+        if (out_l == LAYOUT_YUYV) dst.p[0] = dst_base;
+        else planar_frame(dst_base, w, h, &dst);
+
+        if (hb && dmabuf_sync(hb->fd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE) < 0) return 1;
+        double t0 = now_s();
+        convert_frame(k, in_l, out_l, &src, &dst, w, h);
+        t_conv += now_s() - t0;
+        if (hb && dmabuf_sync(hb->fd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE) < 0) return 1;
+
+        if (verify) {
+            if (out_l == LAYOUT_YUYV) ref.p[0] = ref_base;
+            else planar_frame(ref_base, w, h, &ref);
+            convert_frame(&kernels[0], in_l, out_l, &src, &ref, w, h);
+            if (memcmp(ref_base, dst_base, out_fs)) {
+                fprintf(stderr, "frame %zu: %s differs from scalar\n", n, k->name);
+                mismatches++;
+            }
+        }
+
+        if (out_l == LAYOUT_PLANES) {
+            if (write_all(out_fd[0], dst.p[0], ysz) < 0) return 1;
+            if (write_all(out_fd[1], dst.p[1], csz) < 0) return 1;
+            if (write_all(out_fd[2], dst.p[2], csz) < 0) return 1;
+        } else if (write_all(out_fd[0], dst_base, out_fs) < 0) {
+            return 1;
+        }
+    }
+
+    if (nframes && t_conv > 0.0)
+        fprintf(stderr, "convert: %.3f ms/frame, %.1f MB/s (input)\n",
+                t_conv * 1e3 / (double)nframes, (double)nframes * (double)in_fs / t_conv / (1024.0 * 1024.0));
+    if (verify)
+        fprintf(stderr, "verify: %zu of %zu frames differ\n", mismatches, nframes);
+
+    for (int p = 0; p < 3; p++) {
+        if (out_fd[p] >= 0) close(out_fd[p]);
+        if (in[p].addr) munmap(in[p].addr, in[p].len);
+    }
+    if (hb) {
+        dmaheap_pool_put(hb);
+        dmaheap_pool_destroy(&pool);
+    } else {
+        free(dst_base);
+    }
+    free(ref_base);
+    return mismatches ? 1 : 0;
+}
@@ -7,6 +7,11 @@
 #include <linux/mutex.h>
 #include <linux/dma-buf.h>
 #include <linux/scatterlist.h>
+#include <linux/workqueue.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/overflow.h>
+#include <linux/random.h>
 
 #include <media/v4l2-dev.h>
 #include <media/v4l2-device.h>
@@ -18,12 +23,28 @@
 #include <media/videobuf2-dma-contig.h>
 #include <media/videobuf2-vmalloc.h>
 #include <media/videobuf2-dma-sg.h>
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <crypto/skcipher.h>
+
+#include "privcam_link.h"
+#include "privcam_meta.h"
+#include "privcam_ring.h"
+#include "privcam_source.h"
 
 #define PRIVCAM_DEF_WIDTH 640
 #define PRIVCAM_DEF_HEIGHT 480
 #define PRIVCAM_DEF_PIXFMT V4L2_PIX_FMT_YUYV
 #define PRIVCAM_BPP 2
 
+/* Default row alignment: one cacheline, so SIMD consumers never split a load across rows */
+#define PRIVCAM_BPL_ALIGN 64
+/* Most padding a client may add beyond the default stride */
+#define PRIVCAM_MAX_BPL_PAD 4096
+
+#define PRIVCAM_MAX_WIDTH 8192
+#define PRIVCAM_MAX_HEIGHT 8192
+
 #define PRIVCAM_CAPS (V4L2_CAP_VIDEO_M2M_MPLANE | V4L2_CAP_DEVICE_CAPS | V4L2_CAP_STREAMING)
 
 #define BUFTYPE_OUT V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE
@@ -31,6 +52,20 @@
 
 #define USE_DMABUF 1
 
+/* Upper bound for a compressed frame buffer requested through sizeimage */
+#define PRIVCAM_MAX_COMPRESSED_SIZE (32 * 1024 * 1024)
+
+#define PRIVCAM_CID_PREVIEW_SCALE (V4L2_CID_USER_BASE + 0x1102)
+#define PRIVCAM_CID_DECIMATION (V4L2_CID_USER_BASE + 0x1104)
+#define PRIVCAM_CID_MAX_FPS (V4L2_CID_USER_BASE + 0x1105)
+#define PRIVCAM_LINK_DEPTH 4
+
+/* Rotation and flips as set by the controls */
+struct privcam_xform_cfg {
+    u32 rotate;                     /* clockwise degrees: 0, 90, 180, 270 */
+    bool hflip, vflip;
+};
+
 struct privcam_dev {
     struct v4l2_device v4l2_dev;
     struct video_device vdev;
@@ -48,12 +83,210 @@ struct privcam_ctx {
     struct v4l2_pix_format_mplane cap_fmt;
     
     u32 sequence;
+    u32 out_sequence;               /* OUTPUT buffers queued, decimated ones included */
     spinlock_t qlock; /* vb2 queue lock */
+
+    struct v4l2_ctrl_handler ctrl_handler;
+
+    /* In-kernel source link, see privcam_link.h. Bindings and the FIFO are under privcam_link_lock. */
+    struct list_head link_node;
+    int source_nr;
+    struct privcam_source *source;
+    struct privcam_link_frame *link_fifo[PRIVCAM_LINK_DEPTH];
+    unsigned int link_head, link_count;
+    u32 link_dropped;
+    struct work_struct link_work;
+
+    u32 frames_dropped;             /* since the last CAPTURE buffer produced, for privcam_frame_info */
+
+    /* Source frame decimation, see privcam_decimate(). Under privcam_link_lock. */
+    u32 decimate;                   /* keep every Nth source frame, 1 = all */
+    u32 max_fps;                    /* keep at most this many frames per second by timestamp, 0 = off */
+    u32 decim_count;
+    u64 decim_due_ns;               /* earliest timestamp the next kept frame may have */
+
+    /* Completion ring, see privcam_ring.h. Kernel-side cursors and held buffers are under qlock. */
+    struct privcam_ring_hdr *ring;
+    s16 *ring_shadow;               /* held CAPTURE index per posted entry, or -1 */
+    u32 ring_entries;
+    u32 ring_head;
+    u32 ring_reclaim;               /* entries before this have been consumed and processed */
+    struct vb2_v4l2_buffer *ring_held[VB2_MAX_FRAME];
+    u64 cap_mmap_bytes;             /* upper bound of the CAPTURE mmap offsets handed out */
+
+    /* Extra CAPTURE planes, see privcam_set_extra_planes() */
+    u32 preview_scale;              /* YUYV preview plane downscaled by this factor, 1 = off */
+    bool meta_plane;                /* trailing struct privcam_meta plane */
+
+    /* Geometric transform of each frame; jobs work from a snapshot, see privcam_xform_get() */
+    struct privcam_xform_cfg xform;
+
+    /* OUTPUT -> CAPTURE format conversion row, see privcam_conv */
+    u8 *conv_row;
+    u32 conv_row_size;
+
+    /* Frame encryption, set by privcam_crypt_setup(). Changed only while CAPTURE has no buffers. */
+    u32 crypt_mode;                 /* PRIVCAM_CRYPT_* */
+    u8 crypt_key[32];
+    struct crypto_sync_skcipher *crypt_tfm;     /* NULL when off */
+    u8 *crypt_ks;                   /* PRIVCAM_CRYPT_CHUNK bytes of keystream */
+    u8 crypt_nonce[8];
+    u32 crypt_frames;
+    /* Kernel-only staging for rows that are not encrypted straight from OUTPUT */
+    u8 *crypt_bounce;
+    size_t crypt_bounce_size;
 };
 
+/* Both queues: the vb2 buffer plus when it was queued, for privcam_frame_info */
+struct privcam_buf {
+    struct vb2_v4l2_buffer vb;
+    u64 qbuf_ns;
+};
+
+static inline struct privcam_buf *to_privcam_buf(struct vb2_v4l2_buffer *vbuf)
+{
+    return container_of(vbuf, struct privcam_buf, vb);
+}
+
 static struct privcam_dev *privcam;
 static struct platform_device *pdev;
 
+struct privcam_fmt {
+    u32 fourcc;
+    u8 num_planes;
+    bool compressed;    /* variable-size payload, passed through as is */
+    u8 depth;           /* bits per sample, 0 for compressed */
+};
+
+static const struct privcam_fmt privcam_formats[] = {
+    { V4L2_PIX_FMT_YUYV,    1, false, 8 },
+    { V4L2_PIX_FMT_YUV420M, 3, false, 8 },
+    { V4L2_PIX_FMT_P010,    1, false, 10 },     /* Y then CbCr, 16-bit samples, one buffer */
+    { V4L2_PIX_FMT_Y10,     1, false, 10 },     /* 16-bit samples, low bits */
+    { V4L2_PIX_FMT_Y12,     1, false, 12 },
+    { V4L2_PIX_FMT_Y10P,    1, false, 10 },     /* 4 pixels in 5 bytes */
+    { V4L2_PIX_FMT_MJPEG,   1, true, 0 },
+    { V4L2_PIX_FMT_H264,    1, true, 0 },
+};
+
+static const struct privcam_fmt *privcam_find_fmt(u32 fourcc)
+{
+    for (unsigned int i = 0; i < ARRAY_SIZE(privcam_formats); i++)
+        if (privcam_formats[i].fourcc == fourcc)
+            return &privcam_formats[i];
+    return NULL;
+}
+
+static bool privcam_fmt_compressed(u32 fourcc)
+{
+    const struct privcam_fmt *fmt = privcam_find_fmt(fourcc);
+
+    return fmt && fmt->compressed;
+}
+
+/* 8-bit luma that the statistics, preview and transforms can read directly */
+static bool privcam_fmt_8bit(u32 fourcc)
+{
+    const struct privcam_fmt *fmt = privcam_find_fmt(fourcc);
+
+    return fmt && fmt->depth == 8;
+}
+
+/* Active (unpadded) bytes per row and number of rows of plane p of a raw format */
+static void privcam_plane_geometry(const struct v4l2_pix_format_mplane *mp, unsigned int p,
+                                   u32 *row_bytes, u32 *rows)
+{
+    switch (mp->pixelformat) {
+    case V4L2_PIX_FMT_YUV420M:
+        *row_bytes = p ? mp->width / 2 : mp->width;
+        *rows = p ? mp->height / 2 : mp->height;
+        break;
+    case V4L2_PIX_FMT_P010:
+        /* Half-height CbCr rows follow the luma rows at the same stride */
+        *row_bytes = mp->width * 2;
+        *rows = mp->height + mp->height / 2;
+        break;
+    case V4L2_PIX_FMT_Y10P:
+        *row_bytes = mp->width / 4 * 5;
+        *rows = mp->height;
+        break;
+    default:
+        /* YUYV, Y10, Y12 */
+        *row_bytes = mp->width * PRIVCAM_BPP;
+        *rows = mp->height;
+        break;
+    }
+}
+
+/*
+ * Padded strides the client asked for are kept, up to PRIVCAM_MAX_BPL_PAD past the default;
+ * anything else gets cacheline-aligned rows
+ */
+static u32 privcam_bpl(const u32 *req_bpl, unsigned int p, u32 min_bpl)
+{
+    u32 def = ALIGN(min_bpl, PRIVCAM_BPL_ALIGN);
+
+    if (req_bpl && req_bpl[p] >= min_bpl && req_bpl[p] <= def + PRIVCAM_MAX_BPL_PAD)
+        return req_bpl[p];
+    return def;
+}
+
+/* Stride and size of a plane of rows rows; a stride whose plane overflows u32 gets the default */
+static void privcam_set_plane(struct v4l2_plane_pix_format *pf, const u32 *req_bpl, unsigned int p,
+                              u32 min_bpl, u32 rows)
+{
+    pf->bytesperline = privcam_bpl(req_bpl, p, min_bpl);
+    if (check_mul_overflow(pf->bytesperline, rows, &pf->sizeimage)) {
+        pf->bytesperline = ALIGN(min_bpl, PRIVCAM_BPL_ALIGN);
+        pf->sizeimage = pf->bytesperline * rows;
+    }
+}
+
+/*
+ * Extra CAPTURE planes, after the image planes and in this order:
+ *  - preview: YUYV only, the frame downscaled by preview_scale
+ *  - metadata: one struct privcam_meta, see privcam_meta.h
+ * Both are produced in the same pass over the source as the copy itself (privcam_rowwork).
+ */
+static void privcam_set_extra_planes(struct privcam_ctx *ctx, struct v4l2_pix_format_mplane *mp,
+                                     const u32 *req_bpl)
+{
+    const struct privcam_fmt *fmt = privcam_find_fmt(mp->pixelformat);
+    unsigned int n = fmt ? fmt->num_planes : 1;
+    u32 pw = (mp->width / ctx->preview_scale) & ~1U;
+    u32 ph = mp->height / ctx->preview_scale;
+
+    memset(&mp->plane_fmt[n], 0, (VIDEO_MAX_PLANES - n) * sizeof(mp->plane_fmt[0]));
+
+    if (mp->pixelformat == V4L2_PIX_FMT_YUYV && ctx->preview_scale > 1 && pw && ph) {
+        privcam_set_plane(&mp->plane_fmt[n], req_bpl, n, pw * PRIVCAM_BPP, ph);
+        n++;
+    }
+    if (ctx->meta_plane) {
+        mp->plane_fmt[n].sizeimage = sizeof(struct privcam_meta);
+        n++;
+    }
+    mp->num_planes = n;
+}
+
+static int privcam_preview_plane(const struct privcam_ctx *ctx)
+{
+    const struct v4l2_pix_format_mplane *mp = &ctx->cap_fmt;
+
+    return mp->pixelformat == V4L2_PIX_FMT_YUYV && mp->plane_fmt[1].bytesperline ? 1 : -1;
+}
+
+static int privcam_meta_plane(const struct privcam_ctx *ctx)
+{
+    return ctx->meta_plane ? ctx->cap_fmt.num_planes - 1 : -1;
+}
+
+/* privcam_link_mutex serialises bind/unbind; privcam_link_lock guards the hot push path */
+static DEFINE_MUTEX(privcam_link_mutex);
+static DEFINE_SPINLOCK(privcam_link_lock);
+static LIST_HEAD(privcam_sources);
+static LIST_HEAD(privcam_link_ctxs);
+
 /* static size_t privcam_sg_copy(struct sg_table *src, struct sg_table *dst, size_t bytes)
 {
     struct sg_mapping_iter s, d;
@@ -184,6 +417,169 @@ finish:
     v4l2_m2m_job_finish(ctx->dev->m2m_dev, ctx->m2m_ctx);
 } */
 
+/* Requeue the CAPTURE buffers of every entry userspace has consumed. Called with qlock held. */
+static void __privcam_ring_reclaim(struct privcam_ctx *ctx)
+{
+    u32 tail = smp_load_acquire(&ctx->ring->tail);
+
+    /* Never trust tail beyond what was posted */
+    if (tail - ctx->ring_reclaim > ctx->ring_head - ctx->ring_reclaim)
+        tail = ctx->ring_head;
+
+    while (ctx->ring_reclaim != tail) {
+        s16 idx = ctx->ring_shadow[ctx->ring_reclaim++ & (ctx->ring_entries - 1)];
+
+        if (idx >= 0 && ctx->ring_held[idx]) {
+            to_privcam_buf(ctx->ring_held[idx])->qbuf_ns = ktime_get_ns();
+            v4l2_m2m_buf_queue(ctx->m2m_ctx, ctx->ring_held[idx]);
+            ctx->ring_held[idx] = NULL;
+        }
+    }
+}
+
+static void privcam_ring_reclaim(struct privcam_ctx *ctx)
+{
+    unsigned long flags;
+
+    if (!ctx->ring)
+        return;
+
+    spin_lock_irqsave(&ctx->qlock, flags);
+    __privcam_ring_reclaim(ctx);
+    spin_unlock_irqrestore(&ctx->qlock, flags);
+}
+
+/* Post a completion; returns true if the ring now holds the buffer instead of vb2 */
+static bool privcam_ring_post(struct privcam_ctx *ctx, struct vb2_v4l2_buffer *vbuf,
+                              enum vb2_buffer_state state)
+{
+    struct vb2_buffer *vb = &vbuf->vb2_buf;
+    bool hold = vb->type == BUFTYPE_CAP && state == VB2_BUF_STATE_DONE;
+    struct privcam_cqe *cqe;
+    unsigned long flags;
+
+    spin_lock_irqsave(&ctx->qlock, flags);
+    __privcam_ring_reclaim(ctx);
+
+    if (ctx->ring_head - ctx->ring_reclaim >= ctx->ring_entries) {
+        WRITE_ONCE(ctx->ring->overflow, ctx->ring->overflow + 1);
+        spin_unlock_irqrestore(&ctx->qlock, flags);
+        return false;
+    }
+
+    cqe = &privcam_ring_cqes(ctx->ring)[ctx->ring_head & (ctx->ring_entries - 1)];
+    memset(cqe, 0, sizeof(*cqe));
+    cqe->type = vb->type;
+    cqe->index = vb->index;
+    cqe->sequence = vbuf->sequence;
+    cqe->timestamp_ns = vb->timestamp;
+    cqe->flags = (state == VB2_BUF_STATE_ERROR ? PRIVCAM_CQE_F_ERROR : 0) |
+                 (hold ? PRIVCAM_CQE_F_HELD : 0);
+    for (unsigned int p = 0; p < min_t(unsigned int, vb->num_planes, 3); p++)
+        cqe->bytesused[p] = vb2_get_plane_payload(vb, p);
+
+    ctx->ring_shadow[ctx->ring_head & (ctx->ring_entries - 1)] = hold ? vb->index : -1;
+    if (hold)
+        ctx->ring_held[vb->index] = vbuf;
+
+    ctx->ring_head++;
+    smp_store_release(&ctx->ring->head, ctx->ring_head);
+    spin_unlock_irqrestore(&ctx->qlock, flags);
+
+    return hold;
+}
+
+/*
+ * Returns true if a source frame should be skipped: not the decimate-th one, or earlier than
+ * the max_fps schedule allows. The schedule advances by whole periods so the output rate does
+ * not drift, tolerates an eighth of a period of timestamp jitter, and restarts after a gap
+ * rather than bursting to catch up.
+ */
+static bool privcam_decimate(struct privcam_ctx *ctx, u64 ts)
+{
+    u64 period, slack;
+
+    if (ctx->decimate > 1 && ctx->decim_count++ % ctx->decimate)
+        return true;
+    if (!ctx->max_fps)
+        return false;
+
+    period = div_u64(NSEC_PER_SEC, ctx->max_fps);
+    slack = period / 8;
+    if (ctx->decim_due_ns && ts + slack < ctx->decim_due_ns)
+        return true;
+    if (!ctx->decim_due_ns || ts > ctx->decim_due_ns + period)
+        ctx->decim_due_ns = ts;
+    ctx->decim_due_ns += period;
+    return false;
+}
+
+static void privcam_decimate_reset(struct privcam_ctx *ctx)
+{
+    ctx->decim_count = 0;
+    ctx->decim_due_ns = 0;
+}
+
+/* Every finished buffer of either queue goes through here */
+static void privcam_buf_complete(struct privcam_ctx *ctx, struct vb2_v4l2_buffer *vbuf,
+                                 enum vb2_buffer_state state)
+{
+    if (ctx->ring && privcam_ring_post(ctx, vbuf, state))
+        return;
+
+    v4l2_m2m_buf_done(vbuf, state);
+}
+
+static int privcam_ring_alloc(struct privcam_ctx *ctx, u32 entries)
+{
+    if (!entries)
+        return 0;
+    if (!is_power_of_2(entries))
+        return -ERANGE;
+    /* The mapping cannot be resized or freed under userspace, so the ring is set up once per open */
+    if (ctx->ring || vb2_is_busy(v4l2_m2m_get_dst_vq(ctx->m2m_ctx)))
+        return -EBUSY;
+
+    ctx->ring_shadow = kmalloc_array(entries, sizeof(*ctx->ring_shadow), GFP_KERNEL);
+    if (!ctx->ring_shadow)
+        return -ENOMEM;
+
+    ctx->ring = vmalloc_user(privcam_ring_bytes(entries));
+    if (!ctx->ring) {
+        kfree(ctx->ring_shadow);
+        ctx->ring_shadow = NULL;
+        return -ENOMEM;
+    }
+
+    ctx->ring->entries = entries;
+    ctx->ring->entry_size = sizeof(struct privcam_cqe);
+    ctx->ring_entries = entries;
+    ctx->cap_mmap_bytes = 0;
+    return 0;
+}
+
+/*
+ * CAPTURE mmap cookies start at DST_QUEUE_OFF_BASE and, on kernels that number them by size,
+ * grow with every buffer allocated. Returns how many of nbufs buffers of the given plane sizes
+ * fit below PRIVCAM_RING_MMAP_OFFSET, so no CAPTURE plane can ever alias the ring.
+ */
+static unsigned int privcam_ring_cap_fit(struct privcam_ctx *ctx, unsigned int nbufs,
+                                         unsigned int nplanes, const unsigned int sizes[])
+{
+    u64 room = PRIVCAM_RING_MMAP_OFFSET - DST_QUEUE_OFF_BASE;
+    u64 per_buf = 0;
+
+    for (unsigned int i = 0; i < nplanes; i++)
+        per_buf += PAGE_ALIGN(sizes[i]);
+
+    if (!ctx->ring || !per_buf)
+        return nbufs;
+    if (ctx->cap_mmap_bytes >= room)
+        return 0;
+    return min_t(u64, nbufs, div64_u64(room - ctx->cap_mmap_bytes, per_buf));
+}
+
+/* Pure readiness check; consumed ring entries are reclaimed in poll, buf_queue and device_run */
 static int privcam_job_ready(void *priv)
 {
     struct privcam_ctx *ctx = priv;
@@ -192,63 +588,975 @@ static int privcam_job_ready(void *priv)
             (v4l2_m2m_num_dst_bufs_ready(ctx->m2m_ctx) > 0);
 }
 
+/*
+ * Frame encryption. The cipher only produces keystream, PRIVCAM_CRYPT_CHUNK bytes at a time
+ * into crypt_ks, which stays in L1; the copy loops XOR it in as they move the frame, so the
+ * plaintext is read once, the ciphertext written once, and no plaintext ever reaches a
+ * CAPTURE buffer. Rotated bands and converted rows are built in crypt_bounce first and
+ * encrypted out of it; a frame the cipher fails on is zeroed (privcam_crypt_scrub). The tfm is synchronous, so this works from any device_run context; with
+ * AES-NI or ARMv8 CE the block cipher under ctr() is the accelerated one.
+ *
+ * Keystream offsets are byte offsets within the CAPTURE plane, padding included, so userspace
+ * decrypts each plane as one linear CTR stream; see privcam_meta.h for the counter layout.
+ */
+#define PRIVCAM_CRYPT_CHUNK 4096
+
+struct privcam_crypt_stream {
+    struct privcam_ctx *ctx;
+    u32 frame;                      /* frame number, counter block word 2 */
+    u32 ctr0;                       /* counter block word 3 at plane offset 0 */
+    size_t ks_base;                 /* plane offset of crypt_ks[0], SIZE_MAX if none */
+};
+
+/* Counter block: nonce (8 bytes), frame number, block counter; big-endian words */
+static void privcam_crypt_iv(const struct privcam_crypt_stream *cs, u32 ctr, __be32 iv[4])
+{
+    memcpy(iv, cs->ctx->crypt_nonce, sizeof(cs->ctx->crypt_nonce));
+    iv[2] = cpu_to_be32(cs->frame);
+    iv[3] = cpu_to_be32(ctr);
+}
+
+static void privcam_crypt_free(struct privcam_ctx *ctx)
+{
+    if (ctx->crypt_tfm)
+        crypto_free_sync_skcipher(ctx->crypt_tfm);
+    kfree_sensitive(ctx->crypt_ks);
+    kvfree_sensitive(ctx->crypt_bounce, ctx->crypt_bounce_size);
+    ctx->crypt_tfm = NULL;
+    ctx->crypt_ks = NULL;
+    ctx->crypt_bounce = NULL;
+    ctx->crypt_bounce_size = 0;
+}
+
+/*
+ * Switches to mode with key; only while CAPTURE has no buffers. Nothing in ctx changes unless
+ * it succeeds, so a failed switch leaves the previous mode fully working. A key that is all
+ * zeroes over the bytes the mode uses, as before one is written, is not a key.
+ */
+static int privcam_crypt_setup(struct privcam_ctx *ctx, u32 mode, const u8 *key)
+{
+    unsigned int key_len = mode == PRIVCAM_CRYPT_AES256_CTR ? 32 : 16;
+    struct crypto_sync_skcipher *tfm;
+    u8 *ks;
+    int ret;
+
+    if (mode == PRIVCAM_CRYPT_OFF) {
+        privcam_crypt_free(ctx);
+        ctx->crypt_mode = mode;
+        return 0;
+    }
+    if (!memchr_inv(key, 0, key_len))
+        return -EACCES;
+
+    tfm = crypto_alloc_sync_skcipher("ctr(aes)", 0, 0);
+    if (IS_ERR(tfm))
+        return PTR_ERR(tfm);
+    ks = kmalloc(PRIVCAM_CRYPT_CHUNK, GFP_KERNEL);
+    ret = ks ? crypto_sync_skcipher_setkey(tfm, key, key_len) : -ENOMEM;
+    if (ret) {
+        kfree(ks);
+        crypto_free_sync_skcipher(tfm);
+        return ret;
+    }
+
+    privcam_crypt_free(ctx);
+    ctx->crypt_tfm = tfm;
+    ctx->crypt_ks = ks;
+    ctx->crypt_mode = mode;
+    /* A new key starts a new nonce */
+    ctx->crypt_frames = 0;
+    return 0;
+}
+
+/*
+ * Starts encrypting a frame; false when encryption is off. Every attempt takes a new frame
+ * number, failed ones included, so no two frames ever share keystream. The nonce is redrawn
+ * at STREAMON, on a new key and when the frame number wraps.
+ */
+static bool privcam_crypt_frame(struct privcam_ctx *ctx, struct privcam_crypt_stream *cs)
+{
+    if (!ctx->crypt_tfm)
+        return false;
+
+    if (!ctx->crypt_frames)
+        get_random_bytes(ctx->crypt_nonce, sizeof(ctx->crypt_nonce));
+
+    cs->ctx = ctx;
+    cs->frame = ctx->crypt_frames++;
+    cs->ctr0 = 0;
+    cs->ks_base = SIZE_MAX;
+    return true;
+}
+
+/* Plane p counts from block p << 28, so planes up to 4 GiB never overlap */
+static void privcam_crypt_plane(struct privcam_crypt_stream *cs, unsigned int p)
+{
+    cs->ctr0 = p << 28;
+    cs->ks_base = SIZE_MAX;
+}
+
+static int privcam_crypt_refill(struct privcam_crypt_stream *cs, size_t base)
+{
+    struct privcam_ctx *ctx = cs->ctx;
+    SYNC_SKCIPHER_REQUEST_ON_STACK(req, ctx->crypt_tfm);
+    struct scatterlist sg;
+    __be32 iv[4];
+    int ret;
+
+    privcam_crypt_iv(cs, cs->ctr0 + base / AES_BLOCK_SIZE, iv);
+
+    /* CTR over zeros is the keystream itself */
+    memset(ctx->crypt_ks, 0, PRIVCAM_CRYPT_CHUNK);
+    sg_init_one(&sg, ctx->crypt_ks, PRIVCAM_CRYPT_CHUNK);
+    skcipher_request_set_sync_tfm(req, ctx->crypt_tfm);
+    skcipher_request_set_callback(req, 0, NULL, NULL);
+    skcipher_request_set_crypt(req, &sg, &sg, PRIVCAM_CRYPT_CHUNK, (u8 *)iv);
+    ret = crypto_skcipher_encrypt(req);
+    skcipher_request_zero(req);
+
+    cs->ks_base = ret ? SIZE_MAX : base;
+    return ret;
+}
+
+/* dst = src ^ keystream at plane offset off, n bytes; src may be dst. False if the cipher failed. */
+static bool privcam_crypt_xor(struct privcam_crypt_stream *cs, u8 *dst, const u8 *src, size_t off, size_t n)
+{
+    while (n) {
+        size_t base = off & ~(size_t)(PRIVCAM_CRYPT_CHUNK - 1);
+        size_t at = off - base;
+        size_t m = min_t(size_t, n, PRIVCAM_CRYPT_CHUNK - at);
+
+        if (cs->ks_base != base && privcam_crypt_refill(cs, base))
+            return false;
+
+        crypto_xor_cpy(dst, src, cs->ctx->crypt_ks + at, m);
+        dst += m;
+        src += m;
+        off += m;
+        n -= m;
+    }
+    return true;
+}
+
+/* An encrypted frame that failed part way may hold a partial stream; none of it goes out */
+static void privcam_crypt_scrub(struct vb2_v4l2_buffer *dst)
+{
+    for (unsigned int p = 0; p < dst->vb2_buf.num_planes; p++) {
+        void *vaddr = vb2_plane_vaddr(&dst->vb2_buf, p);
+
+        if (vaddr)
+            memset(vaddr, 0, vb2_plane_size(&dst->vb2_buf, p));
+        vb2_set_plane_payload(&dst->vb2_buf, p, 0);
+    }
+}
+
+/* SG -> linear copy of len bytes starting skip bytes into the table; with cs, the copy encrypts */
+static size_t privcam_sg_to_linear(struct sg_table *sgt, size_t skip, void *dst, size_t len,
+                                   struct privcam_crypt_stream *cs)
+{
+    struct sg_mapping_iter it;
+    size_t copied = 0;
+    u8 *out = dst;
+
+    sg_miter_start(&it, sgt->sgl, sgt->nents, SG_MITER_FROM_SG);
+    if (skip && !sg_miter_skip(&it, skip))
+        goto out;
+
+    while (copied < len && sg_miter_next(&it)) {
+        size_t chunk = min_t(size_t, it.length, len - copied);
+
+        if (!cs)
+            memcpy(out, it.addr, chunk);
+        else if (!privcam_crypt_xor(cs, out, it.addr, copied, chunk))
+            break;
+        out += chunk;
+        copied += chunk;
+    }
+out:
+    sg_miter_stop(&it);
+    return copied;
+}
+
+/* Work done on each plane-0 row right after it is copied, while it is still in L1 */
+struct privcam_rowwork {
+    u8 *pv_dst;                     /* preview plane, NULL when off */
+    u32 pv_bpl, pv_width, pv_rows, pv_scale;
+    u32 pv_done;                    /* preview rows written */
+
+    struct privcam_meta *meta;      /* metadata plane, NULL when off */
+    struct privcam_stats *stats;    /* &meta->stats for raw formats, NULL otherwise */
+    struct privcam_frame_info *info;    /* &meta->info, NULL when off */
+    u32 y_step;                     /* bytes between luma samples */
+    u32 y_rows;                     /* image height, splits rows into grid bands */
+    u32 band_rows[PRIVCAM_STATS_GRID];
+};
+
+/*
+ * Called as the copy starts; src is NULL for linked sources. rows_ok: the copy yields whole
+ * CAPTURE rows, so the preview and the statistics can be derived from them.
+ * Returns false if a plane the work needs has no kernel mapping.
+ */
+static bool privcam_rowwork_init(struct privcam_ctx *ctx, struct vb2_v4l2_buffer *src,
+                                 struct vb2_v4l2_buffer *dst, struct privcam_rowwork *rw, bool rows_ok)
+{
+    const struct v4l2_pix_format_mplane *mp = &ctx->cap_fmt;
+    int pv = privcam_preview_plane(ctx);
+    int mt = privcam_meta_plane(ctx);
+
+    memset(rw, 0, sizeof(*rw));
+
+    if (pv >= 0 && rows_ok) {
+        rw->pv_dst = vb2_plane_vaddr(&dst->vb2_buf, pv);
+        if (!rw->pv_dst)
+            return false;
+        rw->pv_bpl = mp->plane_fmt[pv].bytesperline;
+        rw->pv_width = (mp->width / ctx->preview_scale) & ~1U;
+        rw->pv_rows = mp->height / ctx->preview_scale;
+        rw->pv_scale = ctx->preview_scale;
+    }
+
+    if (mt >= 0) {
+        rw->meta = vb2_plane_vaddr(&dst->vb2_buf, mt);
+        if (!rw->meta)
+            return false;
+        memset(rw->meta, 0, sizeof(*rw->meta));
+        rw->meta->version = PRIVCAM_META_VERSION;
+        rw->meta->size = sizeof(*rw->meta);
+        rw->meta->flags = PRIVCAM_META_F_TIMING;
+
+        rw->info = &rw->meta->info;
+        rw->info->out_qbuf_ns = src ? to_privcam_buf(src)->qbuf_ns : 0;
+        rw->info->cap_qbuf_ns = to_privcam_buf(dst)->qbuf_ns;
+        rw->info->run_start_ns = ktime_get_ns();
+        rw->info->cpu = raw_smp_processor_id();
+
+        if (rows_ok && privcam_fmt_8bit(mp->pixelformat) && mp->width >= PRIVCAM_STATS_GRID &&
+            mp->height >= PRIVCAM_STATS_GRID) {
+            rw->stats = &rw->meta->stats;
+            rw->stats->width = mp->width;
+            rw->stats->y_min = 255;
+            rw->y_step = mp->pixelformat == V4L2_PIX_FMT_YUYV ? 2 : 1;
+            rw->y_rows = mp->height;
+            rw->meta->flags |= PRIVCAM_META_F_STATS;
+        }
+    }
+    return true;
+}
+
+static bool privcam_rowwork_active(const struct privcam_rowwork *rw)
+{
+    return rw->pv_dst || rw->stats;
+}
+
+/* Nearest-neighbour YUYV downscale of one row: every scale-th pixel pair, chroma of the first */
+static void privcam_preview_row(u8 *out, const u8 *in, u32 width, u32 scale)
+{
+    for (u32 x = 0; x < width; x += 2, in += 4 * scale, out += 4) {
+        out[0] = in[0];
+        out[1] = in[1];
+        out[2] = in[2 * scale];
+        out[3] = in[3];
+    }
+}
+
+/* Luma histogram, extremes and grid block sums of one row; block sums become means at finish */
+static void privcam_stats_row(struct privcam_rowwork *rw, u32 row, const u8 *line)
+{
+    struct privcam_stats *st = rw->stats;
+    u32 band = row * PRIVCAM_STATS_GRID / rw->y_rows;
+    u32 *blk = &st->block_mean[band * PRIVCAM_STATS_GRID];
+    u32 lo = st->y_min, hi = st->y_max, x = 0;
+    u64 sum = 0;
+
+    for (u32 bx = 0; bx < PRIVCAM_STATS_GRID; bx++) {
+        u32 end = (bx + 1) * st->width / PRIVCAM_STATS_GRID;
+        u32 bsum = 0;
+
+        for (; x < end; x++) {
+            u8 y = line[x * rw->y_step];
+
+            st->hist[y]++;
+            bsum += y;
+            lo = min_t(u32, lo, y);
+            hi = max_t(u32, hi, y);
+        }
+        blk[bx] += bsum;
+        sum += bsum;
+    }
+
+    st->y_min = lo;
+    st->y_max = hi;
+    st->y_sum += sum;
+    st->height++;
+    rw->band_rows[band]++;
+}
+
+static void privcam_rowwork_copied(struct privcam_rowwork *rw, unsigned int p, size_t bytes)
+{
+    if (rw->info && p < ARRAY_SIZE(rw->info->copy_bytes))
+        rw->info->copy_bytes[p] = bytes;
+}
+
+static void privcam_row_done(struct privcam_rowwork *rw, u32 row, const u8 *line)
+{
+    if (rw->pv_dst && row % rw->pv_scale == 0 && rw->pv_done < rw->pv_rows)
+        privcam_preview_row(rw->pv_dst + (size_t)rw->pv_done++ * rw->pv_bpl, line, rw->pv_width, rw->pv_scale);
+    if (rw->stats)
+        privcam_stats_row(rw, row, line);
+}
+
+/*
+ * After the copy, once dst has its sequence: finish the statistics, set extra plane payloads.
+ * Hands the pending drop count to this frame.
+ */
+static void privcam_rowwork_finish(struct privcam_ctx *ctx, struct vb2_v4l2_buffer *dst,
+                                   struct privcam_rowwork *rw, u32 dropped)
+{
+    struct privcam_stats *st = rw->stats;
+    int pv = privcam_preview_plane(ctx);
+    int mt = privcam_meta_plane(ctx);
+
+    if (pv >= 0)
+        vb2_set_plane_payload(&dst->vb2_buf, pv, rw->pv_done * rw->pv_bpl);
+
+    if (st && st->height) {
+        st->y_mean = div64_u64(st->y_sum, (u64)st->width * st->height);
+        for (u32 by = 0; by < PRIVCAM_STATS_GRID; by++) {
+            for (u32 bx = 0; bx < PRIVCAM_STATS_GRID; bx++) {
+                u32 cols = (bx + 1) * st->width / PRIVCAM_STATS_GRID - bx * st->width / PRIVCAM_STATS_GRID;
+                u32 n = cols * rw->band_rows[by];
+                u32 *b = &st->block_mean[by * PRIVCAM_STATS_GRID + bx];
+
+                *b = n ? *b / n : 0;
+            }
+        }
+    } else if (st) {
+        st->y_min = 0;
+    }
+
+    if (mt >= 0) {
+        rw->info->dropped = dropped;
+        rw->info->run_end_ns = ktime_get_ns();
+        rw->meta->sequence = dst->sequence;
+        vb2_set_plane_payload(&dst->vb2_buf, mt, sizeof(*rw->meta));
+    }
+}
+
+/* The metadata plane carries the frame's plane-0 counter block so userspace can decrypt */
+static void privcam_crypt_meta(struct privcam_rowwork *rw, const struct privcam_crypt_stream *cs)
+{
+    __be32 iv[4];
+
+    if (!rw->meta || !cs)
+        return;
+    privcam_crypt_iv(cs, 0, iv);
+    memcpy(rw->meta->iv, iv, sizeof(rw->meta->iv));
+    rw->meta->flags |= PRIVCAM_META_F_ENCRYPTED;
+}
+
+/*
+ * 10-bit packing, 4 pixels per 5-byte group (Y10P, MIPI CSI-2 RAW10): bytes 0-3 hold bits 9:2
+ * of each pixel, byte 4 holds bits 1:0 of pixel i at bit 2i. Y10 stores each pixel in the low
+ * bits of a little-endian u16. Both kernels move a whole group through one u64 with shifts and
+ * masks (SWAR), 4 pixels per load and store, which the compiler can widen further.
+ */
+/* Unaligned little-endian access; memcpy compiles to a plain load/store where that is legal */
+static inline u64 privcam_ld_le(const u8 *p, unsigned int n)
+{
+    __le64 v = 0;
+
+    memcpy(&v, p, n);
+    return le64_to_cpu(v);
+}
+
+static inline void privcam_st_le(u8 *p, u64 x, unsigned int n)
+{
+    __le64 v = cpu_to_le64(x);
+
+    memcpy(p, &v, n);
+}
+
+static void privcam_unpack_y10p(u8 *dst, const u8 *src, u32 width)
+{
+    for (u32 x = 0; x < width; x += 4, src += 5, dst += 8) {
+        u64 v = privcam_ld_le(src, 4);
+        u64 lo = src[4];
+
+        /* Spread the four high bytes into 16-bit lanes, then drop the low bits in below */
+        v = (v | v << 16) & 0x0000ffff0000ffffULL;
+        v = (v | v << 8) & 0x00ff00ff00ff00ffULL;
+        lo = (lo | lo << 28) & 0x0000000f0000000fULL;
+        lo = (lo | lo << 14) & 0x0003000300030003ULL;
+        privcam_st_le(dst, v << 2 | lo, 8);
+    }
+}
+
+static void privcam_pack_y10p(u8 *dst, const u8 *src, u32 width)
+{
+    for (u32 x = 0; x < width; x += 4, src += 8, dst += 5) {
+        u64 v = privcam_ld_le(src, 8);
+        u64 hi = v >> 2 & 0x00ff00ff00ff00ffULL;
+        u64 lo = v & 0x0003000300030003ULL;
+
+        hi = (hi | hi >> 8) & 0x0000ffff0000ffffULL;
+        hi = (hi | hi >> 16) & 0xffffffffULL;
+        lo = (lo | lo >> 14) & 0x0000000f0000000fULL;
+        lo = (lo | lo >> 28) & 0xff;
+        privcam_st_le(dst, hi, 4);
+        dst[4] = lo;
+    }
+}
+
+/*
+ * Converting copy between OUTPUT and CAPTURE formats: each source row is gathered into row,
+ * which stays in L1, and fn writes the CAPTURE row from it, so the frame is read and written
+ * once. row holds one source row, allocated at STREAMON (privcam_conv_alloc).
+ */
+typedef void (*privcam_conv_fn_t)(u8 *dst, const u8 *src, u32 width);
+
+struct privcam_conv {
+    privcam_conv_fn_t fn;
+    u8 *row;
+    u32 width;
+    u32 out_bytes;                  /* CAPTURE bytes fn writes per row */
+    u8 *bounce;                     /* with encryption: where fn writes, see crypt_bounce */
+};
+
+static privcam_conv_fn_t privcam_conv_fn(const struct privcam_ctx *ctx)
+{
+    const struct v4l2_pix_format_mplane *out = &ctx->out_fmt, *cap = &ctx->cap_fmt;
+
+    if (out->width != cap->width || out->height != cap->height)
+        return NULL;
+    if (out->pixelformat == V4L2_PIX_FMT_Y10P && cap->pixelformat == V4L2_PIX_FMT_Y10)
+        return privcam_unpack_y10p;
+    if (out->pixelformat == V4L2_PIX_FMT_Y10 && cap->pixelformat == V4L2_PIX_FMT_Y10P)
+        return privcam_pack_y10p;
+    return NULL;
+}
+
+static int privcam_conv_alloc(struct privcam_ctx *ctx)
+{
+    u32 row_bytes, rows;
+
+    kfree(ctx->conv_row);
+    ctx->conv_row = NULL;
+    ctx->conv_row_size = 0;
+    if (!privcam_conv_fn(ctx))
+        return 0;
+
+    privcam_plane_geometry(&ctx->out_fmt, 0, &row_bytes, &rows);
+    ctx->conv_row = kmalloc(row_bytes, GFP_KERNEL);
+    if (!ctx->conv_row)
+        return -ENOMEM;
+    ctx->conv_row_size = row_bytes;
+    return 0;
+}
+
+/*
+ * Row-by-row SG -> linear copy for planes whose strides differ: rows of row_bytes start every
+ * src_bpl bytes from skip in the table and land every dst_bpl bytes in dst. Padding is skipped
+ * without being mapped or copied. With cv, rows are converted on the way (see privcam_conv).
+ * With cs, they are encrypted on the way. With rw, each finished row also goes through
+ * privcam_row_done.
+ */
+static size_t privcam_sg_to_linear_rows(struct sg_table *sgt, size_t skip, u32 src_bpl,
+                                        u8 *dst, u32 dst_bpl, u32 row_bytes, u32 rows,
+                                        struct privcam_rowwork *rw, const struct privcam_conv *cv,
+                                        struct privcam_crypt_stream *cs)
+{
+    struct sg_mapping_iter it;
+    const u8 *in = NULL;
+    size_t avail = 0, gap = 0, copied = 0;
+    u32 row = 0, in_row = 0;
+
+    sg_miter_start(&it, sgt->sgl, sgt->nents, SG_MITER_FROM_SG);
+    if (skip && !sg_miter_skip(&it, skip))
+        goto out;
+
+    while (row < rows) {
+        if (!avail) {
+            if (!sg_miter_next(&it))
+                break;
+            in = it.addr;
+            avail = it.length;
+        }
+
+        if (gap) {
+            size_t n = min(gap, avail);
+
+            in += n;
+            avail -= n;
+            gap -= n;
+            continue;
+        }
+
+        size_t n = min_t(size_t, row_bytes - in_row, avail);
+
+        size_t at = (size_t)row * dst_bpl + in_row;
+
+        if (cv || !cs)
+            memcpy((cv ? cv->row + in_row : dst + at), in, n);
+        else if (!privcam_crypt_xor(cs, dst + at, in, at, n))
+            break;
+        in += n;
+        avail -= n;
+        in_row += n;
+        copied += n;
+
+        if (in_row == row_bytes) {
+            u8 *out = dst + (size_t)row * dst_bpl;
+
+            if (cv && !cs) {
+                cv->fn(out, cv->row, cv->width);
+            } else if (cv) {
+                /* Converted in the kernel-only bounce, so only ciphertext reaches CAPTURE */
+                cv->fn(cv->bounce, cv->row, cv->width);
+                if (!privcam_crypt_xor(cs, out, cv->bounce, (size_t)row * dst_bpl, cv->out_bytes)) {
+                    copied -= n;
+                    break;
+                }
+            }
+            /* Derive from the row just written while it is still in L1, not the source again */
+            if (rw)
+                privcam_row_done(rw, row, out);
+            in_row = 0;
+            row++;
+            gap = src_bpl - row_bytes;
+        }
+    }
+out:
+    sg_miter_stop(&it);
+    return copied;
+}
+
+/*
+ * Rotation and flips. Each output pixel reads the source pixel given by an affine map with
+ * coefficients in {-1, 0, 1}; 90 and 270 degrees transpose the image, so CAPTURE must be set
+ * to the OUTPUT size with width and height swapped.
+ *
+ * A transposed copy walks the source down a column, which misses cache on every read when done
+ * a row at a time. The kernels below work in PRIVCAM_XFORM_TILE x PRIVCAM_XFORM_TILE output
+ * blocks instead: the TILE source lines and TILE output lines a block touches stay in L1 across
+ * the block, so every cacheline is loaded once and a rotated frame costs close to a plain copy.
+ */
+#define PRIVCAM_XFORM_TILE 32
+
+/* Output pixel (ox, oy) reads source pixel (x0 + ox*xx + oy*xy, y0 + ox*yx + oy*yy) */
+struct privcam_xform {
+    int x0, xx, xy;
+    int y0, yx, yy;
+};
+
+/*
+ * Flips may be toggled while streaming. A job takes one snapshot and derives everything from it,
+ * so the origin and the steps of its map can never disagree and point outside the source.
+ */
+static struct privcam_xform_cfg privcam_xform_get(const struct privcam_ctx *ctx)
+{
+    struct privcam_xform_cfg x = {
+        .rotate = READ_ONCE(ctx->xform.rotate),
+        .hflip = READ_ONCE(ctx->xform.hflip),
+        .vflip = READ_ONCE(ctx->xform.vflip),
+    };
+
+    return x;
+}
+
+static bool privcam_xform_active(const struct privcam_xform_cfg *x)
+{
+    return x->rotate || x->hflip || x->vflip;
+}
+
+static bool privcam_xform_transposed(const struct privcam_xform_cfg *x)
+{
+    return x->rotate == 90 || x->rotate == 270;
+}
+
+/* Output pixel -> pixel of a w x h source. Flips apply to the rotated image, as displayed. */
+static void privcam_xform_point(const struct privcam_xform_cfg *x, int w, int h, int ox, int oy,
+                                int *sx, int *sy)
+{
+    bool t = privcam_xform_transposed(x);
+
+    if (x->hflip)
+        ox = (t ? h : w) - 1 - ox;
+    if (x->vflip)
+        oy = (t ? w : h) - 1 - oy;
+
+    switch (x->rotate) {
+    case 90:
+        *sx = oy;
+        *sy = h - 1 - ox;
+        break;
+    case 180:
+        *sx = w - 1 - ox;
+        *sy = h - 1 - oy;
+        break;
+    case 270:
+        *sx = w - 1 - oy;
+        *sy = ox;
+        break;
+    default:
+        *sx = ox;
+        *sy = oy;
+        break;
+    }
+}
+
+static void privcam_xform_init(const struct privcam_xform_cfg *x, u32 w, u32 h, struct privcam_xform *m)
+{
+    int sx, sy;
+
+    privcam_xform_point(x, w, h, 0, 0, &m->x0, &m->y0);
+    privcam_xform_point(x, w, h, 1, 0, &sx, &sy);
+    m->xx = sx - m->x0;
+    m->yx = sy - m->y0;
+    privcam_xform_point(x, w, h, 0, 1, &sx, &sy);
+    m->xy = sx - m->x0;
+    m->yy = sy - m->y0;
+}
+
+/*
+ * 0 if the current formats can be transformed. The source is OUTPUT, or for a linked source the
+ * CAPTURE size un-rotated. YUYV needs even sizes so macropixels map onto macropixels.
+ */
+static int privcam_xform_check(const struct privcam_ctx *ctx, const struct privcam_xform_cfg *x, bool linked)
+{
+    const struct v4l2_pix_format_mplane *out = &ctx->out_fmt, *cap = &ctx->cap_fmt;
+    bool t = privcam_xform_transposed(x);
+    u32 w = t ? cap->height : cap->width;
+    u32 h = t ? cap->width : cap->height;
+
+    if (!privcam_fmt_8bit(cap->pixelformat))
+        return -EINVAL;
+    if (cap->pixelformat == V4L2_PIX_FMT_YUYV && ((w | h) & 1))
+        return -EINVAL;
+    if (linked)
+        return cap->pixelformat == V4L2_PIX_FMT_YUYV ? 0 : -EINVAL;
+    if (out->pixelformat != cap->pixelformat || out->width != w || out->height != h)
+        return -EINVAL;
+    return 0;
+}
+
+/*
+ * One band of the widest CAPTURE plane, at STREAMON. Zeroed, so padding the kernels never
+ * write goes out as keystream.
+ */
+static int privcam_crypt_bounce_alloc(struct privcam_ctx *ctx)
+{
+    size_t sz = (size_t)PRIVCAM_XFORM_TILE * ctx->cap_fmt.plane_fmt[0].bytesperline;
+
+    kvfree_sensitive(ctx->crypt_bounce, ctx->crypt_bounce_size);
+    ctx->crypt_bounce = NULL;
+    ctx->crypt_bounce_size = 0;
+    if (!ctx->crypt_tfm || !sz)
+        return 0;
+
+    ctx->crypt_bounce = kvzalloc(sz, GFP_KERNEL);
+    if (!ctx->crypt_bounce)
+        return -ENOMEM;
+    ctx->crypt_bounce_size = sz;
+    return 0;
+}
+
+/*
+ * The kernels fill one band of output rows [ty, ye), a tile at a time, into out (row ty,
+ * obpl bytes per row). Bands go either straight to CAPTURE or, when encrypting, through
+ * crypt_bounce: tiles finish out of row order, and plaintext must not be stored in a buffer
+ * userspace can map, even for the length of a band.
+ */
+
+/* ow output pixels per row of an 8-bit plane */
+static void privcam_xform_band8(const u8 *src, u32 sbpl, u8 *out, u32 obpl, u32 ow, u32 ty, u32 ye,
+                                const struct privcam_xform *m)
+{
+    long dx = m->xx + (long)m->yx * sbpl;       /* source bytes per output pixel */
+    long dy = m->xy + (long)m->yy * sbpl;       /* source bytes per output row */
+    const u8 *o = src + m->x0 + (long)m->y0 * sbpl;
+
+    for (u32 tx = 0; tx < ow; tx += PRIVCAM_XFORM_TILE) {
+        u32 xe = min(tx + PRIVCAM_XFORM_TILE, ow);
+
+        for (u32 y = ty; y < ye; y++) {
+            const u8 *s = o + tx * dx + y * dy;
+            u8 *d = out + (size_t)(y - ty) * obpl;
+
+            if (dx == 1) {
+                memcpy(d + tx, s, xe - tx);
+                continue;
+            }
+            for (u32 x = tx; x < xe; x++, s += dx)
+                d[x] = *s;
+        }
+    }
+}
+
+/*
+ * YUYV, ow output pixels per row, ow even. Luma is mapped per pixel; each output pair takes
+ * the chroma of the source macropixel its first pixel came from.
+ */
+static void privcam_xform_band_yuyv(const u8 *src, u32 sbpl, u8 *out, u32 obpl, u32 ow, u32 ty, u32 ye,
+                               const struct privcam_xform *m)
+{
+    long dx = 2 * m->xx + (long)m->yx * sbpl;   /* source luma bytes per output pixel */
+
+    for (u32 tx = 0; tx < ow; tx += PRIVCAM_XFORM_TILE) {
+        u32 xe = min(tx + PRIVCAM_XFORM_TILE, ow);
+
+        for (u32 y = ty; y < ye; y++) {
+            int sx = m->x0 + (int)tx * m->xx + (int)y * m->xy;
+            int sy = m->y0 + (int)tx * m->yx + (int)y * m->yy;
+            u8 *d = out + (size_t)(y - ty) * obpl + 2 * tx;
+
+            /* Rows that only move vertically stay whole macropixels */
+            if (dx == 2) {
+                memcpy(d, src + (size_t)sy * sbpl + 2 * sx, 2 * (xe - tx));
+                continue;
+            }
+            for (u32 x = tx; x < xe; x += 2, d += 4, sx += 2 * m->xx, sy += 2 * m->yx) {
+                const u8 *line = src + (size_t)sy * sbpl;
+                const u8 *c = line + (sx & ~1) * 2;
+
+                d[0] = line[2 * sx];
+                d[1] = c[1];
+                d[2] = line[2 * sx + dx];
+                d[3] = c[3];
+            }
+        }
+    }
+}
+
+/*
+ * Plane p of a w x h source frame; rw gets plane 0 rows. With cs, the plane is encrypted band
+ * by band out of crypt_bounce, so returns false if the cipher fails.
+ */
+static bool privcam_xform_plane(const struct privcam_ctx *ctx, const struct privcam_xform_cfg *x,
+                                unsigned int p, u32 w, u32 h, const u8 *src, u32 sbpl, u8 *dst, u32 dbpl,
+                                struct privcam_rowwork *rw, struct privcam_crypt_stream *cs)
+{
+    struct privcam_xform m;
+    bool t = privcam_xform_transposed(x);
+    bool yuyv = ctx->cap_fmt.pixelformat == V4L2_PIX_FMT_YUYV;
+    u32 ow, oh, rb;
+
+    if (p) {
+        w /= 2;
+        h /= 2;
+    }
+    privcam_xform_init(x, w, h, &m);
+    ow = t ? h : w;
+    oh = t ? w : h;
+    rb = yuyv ? 2 * ow : ow;
+
+    if (cs && (!ctx->crypt_bounce || (size_t)PRIVCAM_XFORM_TILE * dbpl > ctx->crypt_bounce_size))
+        return false;
+
+    for (u32 ty = 0; ty < oh; ty += PRIVCAM_XFORM_TILE) {
+        u32 ye = min(ty + PRIVCAM_XFORM_TILE, oh);
+        u8 *band = dst + (size_t)ty * dbpl;
+        u8 *out = cs ? ctx->crypt_bounce : band;
+
+        if (yuyv)
+            privcam_xform_band_yuyv(src, sbpl, out, dbpl, ow, ty, ye, &m);
+        else
+            privcam_xform_band8(src, sbpl, out, dbpl, ow, ty, ye, &m);
+
+        if (!cs) {
+            for (u32 r = ty; !p && rw && r < ye; r++)
+                privcam_row_done(rw, r, dst + (size_t)r * dbpl);
+            continue;
+        }
+        /* The bounce is shared by planes of different strides; padding goes out as zeroes */
+        if (dbpl > rb)
+            for (u32 r = 0; r < ye - ty; r++)
+                memset(out + (size_t)r * dbpl + rb, 0, dbpl - rb);
+        if (!privcam_crypt_xor(cs, band, out, (size_t)ty * dbpl, (size_t)(ye - ty) * dbpl))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * m2m job with a transform. Reads the OUTPUT planes through their kernel mapping (vmap of the
+ * sg pages, or dma_buf_vmap for imported buffers), since a transpose needs random row access.
+ */
+static bool privcam_xform_run(struct privcam_ctx *ctx, const struct privcam_xform_cfg *x,
+                              struct vb2_v4l2_buffer *src, struct vb2_v4l2_buffer *dst,
+                              struct privcam_rowwork *rw, struct privcam_crypt_stream *cs)
+{
+    const struct privcam_fmt *fmt = privcam_find_fmt(ctx->cap_fmt.pixelformat);
+
+    /* Flips may change while streaming; whatever the formats are now must still fit */
+    if (privcam_xform_check(ctx, x, false))
+        return false;
+
+    for (unsigned int p = 0; p < fmt->num_planes; p++) {
+        u8 *s = vb2_plane_vaddr(&src->vb2_buf, p);
+        u8 *d = vb2_plane_vaddr(&dst->vb2_buf, p);
+        u32 off = src->vb2_buf.planes[p].data_offset;
+        u32 used = vb2_get_plane_payload(&src->vb2_buf, p) - off;
+        u32 sbpl = ctx->out_fmt.plane_fmt[p].bytesperline;
+        u32 dbpl = ctx->cap_fmt.plane_fmt[p].bytesperline;
+        u32 src_rb, src_rows, dst_rb, dst_rows;
+
+        privcam_plane_geometry(&ctx->out_fmt, p, &src_rb, &src_rows);
+        privcam_plane_geometry(&ctx->cap_fmt, p, &dst_rb, &dst_rows);
+
+        /* Any source row may be read first, so the whole plane must be there */
+        if (!s || !d || !src_rows || used < (size_t)(src_rows - 1) * sbpl + src_rb ||
+            vb2_plane_size(&dst->vb2_buf, p) < (size_t)dst_rows * dbpl)
+            return false;
+
+        if (cs)
+            privcam_crypt_plane(cs, p);
+        if (!privcam_xform_plane(ctx, x, p, ctx->out_fmt.width, ctx->out_fmt.height, s + off, sbpl,
+                                 d, dbpl, rw, cs))
+            return false;
+        vb2_set_plane_payload(&dst->vb2_buf, p, dst_rows * dbpl);
+        privcam_rowwork_copied(rw, p, (size_t)dst_rows * dst_rb);
+    }
+    return true;
+}
+
+/* Linked frame with a transform into YUYV CAPTURE plane 0; returns false if the frame is short */
+static bool privcam_xform_link(struct privcam_ctx *ctx, const struct privcam_xform_cfg *x,
+                               struct privcam_link_frame *f, u8 *dst, struct privcam_rowwork *rw,
+                               struct privcam_crypt_stream *cs, u32 *payload)
+{
+    bool t = privcam_xform_transposed(x);
+    u32 w = t ? ctx->cap_fmt.height : ctx->cap_fmt.width;
+    u32 h = t ? ctx->cap_fmt.width : ctx->cap_fmt.height;
+    u32 dbpl = ctx->cap_fmt.plane_fmt[0].bytesperline;
+
+    if (privcam_xform_check(ctx, x, true) || f->bytesperline < w * PRIVCAM_BPP ||
+        f->bytesused < (size_t)(h - 1) * f->bytesperline + w * PRIVCAM_BPP)
+        return false;
+
+    if (!privcam_xform_plane(ctx, x, 0, w, h, f->vaddr, f->bytesperline, dst, dbpl, rw, cs))
+        return false;
+    *payload = ctx->cap_fmt.height * dbpl;
+    privcam_rowwork_copied(rw, 0, (size_t)w * h * PRIVCAM_BPP);
+    return true;
+}
+
 static void privcam_device_run(void *priv)
 {
     struct privcam_ctx *ctx = priv;
     struct vb2_v4l2_buffer *src, *dst;
+    bool compressed = privcam_fmt_compressed(ctx->out_fmt.pixelformat);
+    struct privcam_rowwork rw;
+    struct privcam_conv conv = { privcam_conv_fn(ctx), ctx->conv_row, ctx->cap_fmt.width };
+    struct privcam_crypt_stream crypt;
+    struct privcam_crypt_stream *cs = privcam_crypt_frame(ctx, &crypt) ? &crypt : NULL;
+    struct privcam_xform_cfg xf = privcam_xform_get(ctx);
+    bool xform = privcam_xform_active(&xf);
+    bool same = xform ? !privcam_xform_check(ctx, &xf, false) :
+                ctx->out_fmt.pixelformat == ctx->cap_fmt.pixelformat &&
+                ctx->out_fmt.width == ctx->cap_fmt.width && ctx->out_fmt.height == ctx->cap_fmt.height;
 
     src = v4l2_m2m_src_buf_remove(ctx->m2m_ctx);
     dst = v4l2_m2m_dst_buf_remove(ctx->m2m_ctx);
     if (!src || !dst)
         goto finish;
 
-    for (unsigned int p = 0; p < src->vb2_buf.num_planes; p++) {
-        struct sg_table *src_sgt = vb2_dma_sg_plane_desc(&src->vb2_buf, p);
-        void *dst_vaddr = vb2_plane_vaddr(&dst->vb2_buf, p);
+    /* Preview and statistics would give away what encryption hides */
+    if (!privcam_rowwork_init(ctx, src, dst, &rw, same && !cs))
+        goto fail;
 
-        u32 sz = min(vb2_get_plane_payload(&src->vb2_buf, p),
-                     vb2_plane_size(&dst->vb2_buf, p));
+    if (xform) {
+        if (!privcam_xform_run(ctx, &xf, src, dst, &rw, cs))
+            goto fail;
+        goto done;
+    }
 
-        if (!src_sgt || !dst_vaddr) {
-            v4l2_m2m_buf_done(src, VB2_BUF_STATE_ERROR);
-            v4l2_m2m_buf_done(dst, VB2_BUF_STATE_ERROR);
-            goto finish;
-        }
+    /* Extra CAPTURE planes are filled by the row work, never copied into */
+    unsigned int nplanes = min_t(unsigned int, src->vb2_buf.num_planes,
+                                 privcam_find_fmt(ctx->cap_fmt.pixelformat)->num_planes);
 
-        /* SG -> linear copy */
-        size_t copied = 0;
-        struct sg_mapping_iter it;
-        size_t remain = sz;
-        u8 *out = dst_vaddr;
+    for (unsigned int p = 0; p < nplanes; p++) {
+        struct sg_table *src_sgt = vb2_dma_sg_plane_desc(&src->vb2_buf, p);
+        void *dst_vaddr = vb2_plane_vaddr(&dst->vb2_buf, p);
 
-        sg_miter_start(&it, src_sgt->sgl, src_sgt->nents, SG_MITER_FROM_SG);
-        while (remain && sg_miter_next(&it)) {
-            size_t chunk = it.length;
-            if (chunk > remain) chunk = remain;
-            memcpy(out, it.addr, chunk);
-            out += chunk;
-            remain -= chunk;
-            copied += chunk;
+        /*
+         * Planes may share one dma-buf, each starting at its own data_offset. Only the
+         * producer's bytesused is copied, so a compressed frame costs its real size.
+         */
+        u32 off = src->vb2_buf.planes[p].data_offset;
+        u32 used = vb2_get_plane_payload(&src->vb2_buf, p) - off;
+        u32 sz = min(used, (u32)vb2_plane_size(&dst->vb2_buf, p));
+        u32 src_bpl = ctx->out_fmt.plane_fmt[p].bytesperline;
+        u32 dst_bpl = ctx->cap_fmt.plane_fmt[p].bytesperline;
+        struct privcam_rowwork *hook = p == 0 && privcam_rowwork_active(&rw) ? &rw : NULL;
+        const struct privcam_conv *cv = p == 0 && conv.fn ? &conv : NULL;
+        size_t copied;
+
+        /* A truncated compressed frame is garbage; a short raw plane is just short */
+        if (!src_sgt || !dst_vaddr || (sz < used && compressed))
+            goto fail;
+        if (cs)
+            privcam_crypt_plane(cs, p);
+
+        if (compressed || (src_bpl == dst_bpl && !hook && !cv)) {
+            copied = privcam_sg_to_linear(src_sgt, off, dst_vaddr, sz, cs);
+            privcam_rowwork_copied(&rw, p, copied);
+        } else {
+            u32 src_rb, src_rows, dst_rb, dst_rows;
+
+            privcam_plane_geometry(&ctx->out_fmt, p, &src_rb, &src_rows);
+            privcam_plane_geometry(&ctx->cap_fmt, p, &dst_rb, &dst_rows);
+
+            /* A conversion gathers whole source rows; the CAPTURE row is whatever fn makes of one */
+            u32 row_bytes = cv ? src_rb : min(src_rb, dst_rb);
+            u32 rows = min(src_rows, dst_rows);
+
+            if (cv && (!cv->row || src_rb > ctx->conv_row_size))
+                goto fail;
+            if (cv && cs && (!ctx->crypt_bounce || dst_rb > ctx->crypt_bounce_size))
+                goto fail;
+            conv.out_bytes = dst_rb;
+            conv.bounce = ctx->crypt_bounce;
+
+            /* Only rows the producer actually filled; the last one may come without padding */
+            if (used < row_bytes)
+                rows = 0;
+            else
+                rows = min(rows, (used - row_bytes) / src_bpl + 1);
+
+            sz = rows * row_bytes;
+            copied = privcam_sg_to_linear_rows(src_sgt, off, src_bpl, dst_vaddr, dst_bpl, row_bytes, rows,
+                                               hook, cv, cs);
+            privcam_rowwork_copied(&rw, p, copied);
+            if (copied == sz)
+                sz = copied = rows * dst_bpl;
         }
-        sg_miter_stop(&it);
 
-        if (copied != sz) {
-            v4l2_m2m_buf_done(src, VB2_BUF_STATE_ERROR);
-            v4l2_m2m_buf_done(dst, VB2_BUF_STATE_ERROR);
-            goto finish;
-        }
+        if (copied != sz)
+            goto fail;
 
         vb2_set_plane_payload(&dst->vb2_buf, p, sz);
     }
 
+done:
     dst->vb2_buf.timestamp = src->vb2_buf.timestamp;
     dst->sequence = ctx->sequence++;
-    src->sequence = dst->sequence;
-
-    v4l2_m2m_buf_done(src, VB2_BUF_STATE_DONE);
-    v4l2_m2m_buf_done(dst, VB2_BUF_STATE_DONE);
-
+    privcam_rowwork_finish(ctx, dst, &rw, ctx->frames_dropped);
+    privcam_crypt_meta(&rw, cs);
+    ctx->frames_dropped = 0;
+
+    privcam_buf_complete(ctx, src, VB2_BUF_STATE_DONE);
+    privcam_buf_complete(ctx, dst, VB2_BUF_STATE_DONE);
+    goto finish;
+
+fail:
+    ctx->frames_dropped++;
+    if (cs)
+        privcam_crypt_scrub(dst);
+    privcam_buf_complete(ctx, src, VB2_BUF_STATE_ERROR);
+    privcam_buf_complete(ctx, dst, VB2_BUF_STATE_ERROR);
 finish:
+    /* So job_finish sees the buffers userspace consumed while this job ran */
+    privcam_ring_reclaim(ctx);
     v4l2_m2m_job_finish(ctx->dev->m2m_dev, ctx->m2m_ctx);
 }
 
@@ -264,6 +1572,401 @@ static const struct v4l2_m2m_ops privcam_m2m_ops = {
     .job_abort = privcam_job_abort,
 };
 
+/* Copy queued source frames into CAPTURE buffers while both are available */
+static void privcam_link_work(struct work_struct *work)
+{
+    struct privcam_ctx *ctx = container_of(work, struct privcam_ctx, link_work);
+    struct privcam_link_frame *f;
+    struct vb2_v4l2_buffer *dst;
+    unsigned long flags;
+    u32 dropped;
+
+    for (;;) {
+        privcam_ring_reclaim(ctx);
+
+        spin_lock_irqsave(&privcam_link_lock, flags);
+        if (!ctx->link_count || !v4l2_m2m_num_dst_bufs_ready(ctx->m2m_ctx)) {
+            spin_unlock_irqrestore(&privcam_link_lock, flags);
+            break;
+        }
+        f = ctx->link_fifo[ctx->link_head];
+        ctx->link_head = (ctx->link_head + 1) % PRIVCAM_LINK_DEPTH;
+        ctx->link_count--;
+        spin_unlock_irqrestore(&privcam_link_lock, flags);
+
+        /* The OUTPUT queue is not streaming, so m2m never runs a job and we own the dst queue */
+        dst = v4l2_m2m_dst_buf_remove(ctx->m2m_ctx);
+        if (!dst) {
+            f->release(f);
+            break;
+        }
+
+        const struct privcam_fmt *fmt = privcam_find_fmt(ctx->cap_fmt.pixelformat);
+        void *dst_vaddr = vb2_plane_vaddr(&dst->vb2_buf, 0);
+        struct privcam_rowwork rw;
+        u32 cap_rb, cap_rows;
+
+        /* Link frames are single-plane; whole rows only when the source stride covers ours */
+        privcam_plane_geometry(&ctx->cap_fmt, 0, &cap_rb, &cap_rows);
+        struct privcam_crypt_stream crypt;
+        struct privcam_crypt_stream *cs = privcam_crypt_frame(ctx, &crypt) ? &crypt : NULL;
+        struct privcam_xform_cfg xf = privcam_xform_get(ctx);
+        bool xform = privcam_xform_active(&xf);
+        bool rows_ok = !cs && (xform ? !privcam_xform_check(ctx, &xf, true) :
+                       !privcam_fmt_compressed(ctx->cap_fmt.pixelformat) && f->bytesperline >= cap_rb);
+        bool ok = fmt && fmt->num_planes == 1 && dst_vaddr && privcam_rowwork_init(ctx, NULL, dst, &rw, rows_ok);
+        u32 sz = min_t(size_t, f->bytesused, vb2_plane_size(&dst->vb2_buf, 0));
+        u32 dst_bpl = ctx->cap_fmt.plane_fmt[0].bytesperline;
+
+        if (ok && xform) {
+            ok = privcam_xform_link(ctx, &xf, f, dst_vaddr, &rw, cs, &sz);
+        } else if (ok && (privcam_rowwork_active(&rw) ||
+                          (f->bytesperline && dst_bpl && f->bytesperline != dst_bpl &&
+                           !privcam_fmt_compressed(ctx->cap_fmt.pixelformat)))) {
+            u32 row_bytes, rows;
+
+            privcam_plane_geometry(&ctx->cap_fmt, 0, &row_bytes, &rows);
+            row_bytes = min(row_bytes, f->bytesperline);
+            rows = min_t(size_t, rows, f->bytesused / f->bytesperline);
+            rows = min_t(size_t, rows, vb2_plane_size(&dst->vb2_buf, 0) / dst_bpl);
+
+            for (u32 r = 0; r < rows && ok; r++) {
+                u8 *row = dst_vaddr + (size_t)r * dst_bpl;
+                const u8 *in = f->vaddr + (size_t)r * f->bytesperline;
+
+                if (cs)
+                    ok = privcam_crypt_xor(cs, row, in, (size_t)r * dst_bpl, row_bytes);
+                else
+                    memcpy(row, in, row_bytes);
+                if (privcam_rowwork_active(&rw))
+                    privcam_row_done(&rw, r, row);
+            }
+            privcam_rowwork_copied(&rw, 0, (size_t)rows * row_bytes);
+            sz = rows * dst_bpl;
+        } else if (ok) {
+            if (cs)
+                ok = privcam_crypt_xor(cs, dst_vaddr, f->vaddr, 0, sz);
+            else
+                memcpy(dst_vaddr, f->vaddr, sz);
+            privcam_rowwork_copied(&rw, 0, sz);
+        }
+
+        if (!ok) {
+            spin_lock_irqsave(&privcam_link_lock, flags);
+            ctx->frames_dropped++;
+            spin_unlock_irqrestore(&privcam_link_lock, flags);
+            if (cs)
+                privcam_crypt_scrub(dst);
+            f->release(f);
+            privcam_buf_complete(ctx, dst, VB2_BUF_STATE_ERROR);
+            continue;
+        }
+        vb2_set_plane_payload(&dst->vb2_buf, 0, sz);
+        dst->vb2_buf.timestamp = f->timestamp;
+        /* The source's numbering, so frames dropped on the way show up as gaps */
+        dst->sequence = f->sequence;
+
+        spin_lock_irqsave(&privcam_link_lock, flags);
+        dropped = ctx->frames_dropped;
+        ctx->frames_dropped = 0;
+        spin_unlock_irqrestore(&privcam_link_lock, flags);
+        privcam_rowwork_finish(ctx, dst, &rw, dropped);
+        privcam_crypt_meta(&rw, cs);
+        f->release(f);
+
+        privcam_buf_complete(ctx, dst, VB2_BUF_STATE_DONE);
+    }
+}
+
+/* Called with privcam_link_mutex held */
+static void privcam_link_bind(struct privcam_ctx *ctx, struct privcam_source *src)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&privcam_link_lock, flags);
+    ctx->source = src;
+    ctx->link_head = 0;
+    ctx->link_count = 0;
+    ctx->link_dropped = 0;
+    ctx->frames_dropped = 0;
+    privcam_decimate_reset(ctx);
+    src->sink = ctx;
+    spin_unlock_irqrestore(&privcam_link_lock, flags);
+
+    pr_info("privcam: linked to source /dev/video%d\n", src->video_nr);
+}
+
+/* Called with privcam_link_mutex held; on return no frame of the source is left in privcam */
+static void privcam_link_unbind(struct privcam_ctx *ctx)
+{
+    struct privcam_link_frame *pending[PRIVCAM_LINK_DEPTH];
+    struct privcam_source *src;
+    unsigned int n = 0;
+    unsigned long flags;
+
+    spin_lock_irqsave(&privcam_link_lock, flags);
+    src = ctx->source;
+    if (src)
+        src->sink = NULL;
+    ctx->source = NULL;
+    while (ctx->link_count) {
+        pending[n++] = ctx->link_fifo[ctx->link_head];
+        ctx->link_head = (ctx->link_head + 1) % PRIVCAM_LINK_DEPTH;
+        ctx->link_count--;
+    }
+    spin_unlock_irqrestore(&privcam_link_lock, flags);
+
+    if (!src)
+        return;
+
+    for (unsigned int i = 0; i < n; i++)
+        pending[i]->release(pending[i]);
+    flush_work(&ctx->link_work);
+
+    pr_info("privcam: unlinked from /dev/video%d, %u frames dropped\n", src->video_nr, ctx->link_dropped);
+}
+
+int privcam_link_register(struct privcam_source *src)
+{
+    struct privcam_ctx *ctx;
+
+    mutex_lock(&privcam_link_mutex);
+    src->sink = NULL;
+    list_add_tail(&src->list, &privcam_sources);
+
+    list_for_each_entry(ctx, &privcam_link_ctxs, link_node) {
+        if (ctx->source_nr == src->video_nr && !ctx->source) {
+            privcam_link_bind(ctx, src);
+            break;
+        }
+    }
+    mutex_unlock(&privcam_link_mutex);
+    return 0;
+}
+EXPORT_SYMBOL_GPL(privcam_link_register);
+
+void privcam_link_unregister(struct privcam_source *src)
+{
+    mutex_lock(&privcam_link_mutex);
+    if (src->sink)
+        privcam_link_unbind(src->sink);
+    list_del(&src->list);
+    mutex_unlock(&privcam_link_mutex);
+}
+EXPORT_SYMBOL_GPL(privcam_link_unregister);
+
+int privcam_link_push(struct privcam_source *src, struct privcam_link_frame *frame)
+{
+    struct privcam_link_frame *drop = NULL;
+    struct privcam_ctx *ctx;
+    unsigned long flags;
+
+    spin_lock_irqsave(&privcam_link_lock, flags);
+    ctx = src->sink;
+    if (!ctx) {
+        spin_unlock_irqrestore(&privcam_link_lock, flags);
+        return -ENOLINK;
+    }
+
+    /* Decimated away: never queued, never copied */
+    if (privcam_decimate(ctx, frame->timestamp)) {
+        spin_unlock_irqrestore(&privcam_link_lock, flags);
+        frame->release(frame);
+        return 0;
+    }
+
+    /* Full: drop the oldest frame so the newest one is what userspace sees next */
+    if (ctx->link_count == PRIVCAM_LINK_DEPTH) {
+        drop = ctx->link_fifo[ctx->link_head];
+        ctx->link_head = (ctx->link_head + 1) % PRIVCAM_LINK_DEPTH;
+        ctx->link_count--;
+        ctx->link_dropped++;
+        ctx->frames_dropped++;
+    }
+    ctx->link_fifo[(ctx->link_head + ctx->link_count) % PRIVCAM_LINK_DEPTH] = frame;
+    ctx->link_count++;
+    queue_work(system_highpri_wq, &ctx->link_work);
+    spin_unlock_irqrestore(&privcam_link_lock, flags);
+
+    if (drop)
+        drop->release(drop);
+    return 0;
+}
+EXPORT_SYMBOL_GPL(privcam_link_push);
+
+/* Source Node control: -1 unlinks, N binds to the source registered as /dev/videoN */
+static int privcam_link_set_source(struct privcam_ctx *ctx, int nr)
+{
+    struct privcam_source *src;
+
+    if (nr >= 0 && vb2_is_streaming(v4l2_m2m_get_src_vq(ctx->m2m_ctx)))
+        return -EBUSY;
+
+    mutex_lock(&privcam_link_mutex);
+    privcam_link_unbind(ctx);
+    ctx->source_nr = nr;
+
+    list_for_each_entry(src, &privcam_sources, list) {
+        if (src->video_nr == nr && !src->sink) {
+            privcam_link_bind(ctx, src);
+            break;
+        }
+    }
+    mutex_unlock(&privcam_link_mutex);
+    return 0;
+}
+
+static const s64 privcam_preview_scales[] = { 1, 2, 4, 8 };
+
+static int privcam_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+    struct privcam_ctx *ctx = container_of(ctrl->handler, struct privcam_ctx, ctrl_handler);
+    unsigned long flags;
+
+    switch (ctrl->id) {
+    case PRIVCAM_CID_SOURCE_NODE:
+        return privcam_link_set_source(ctx, ctrl->val);
+    case PRIVCAM_CID_RING_ENTRIES:
+        return privcam_ring_alloc(ctx, ctrl->val);
+    case PRIVCAM_CID_PREVIEW_SCALE:
+        /* Changes the CAPTURE plane layout, so only while no buffers exist */
+        if (vb2_is_busy(v4l2_m2m_get_dst_vq(ctx->m2m_ctx)))
+            return -EBUSY;
+        ctx->preview_scale = privcam_preview_scales[ctrl->val];
+        privcam_set_extra_planes(ctx, &ctx->cap_fmt, NULL);
+        return 0;
+    case PRIVCAM_CID_META_PLANE:
+        if (vb2_is_busy(v4l2_m2m_get_dst_vq(ctx->m2m_ctx)))
+            return -EBUSY;
+        ctx->meta_plane = ctrl->val;
+        privcam_set_extra_planes(ctx, &ctx->cap_fmt, NULL);
+        return 0;
+    case PRIVCAM_CID_DECIMATION:
+    case PRIVCAM_CID_MAX_FPS:
+        /* A linked source decimates from its own thread */
+        spin_lock_irqsave(&privcam_link_lock, flags);
+        if (ctrl->id == PRIVCAM_CID_DECIMATION)
+            ctx->decimate = ctrl->val;
+        else
+            ctx->max_fps = ctrl->val;
+        privcam_decimate_reset(ctx);
+        spin_unlock_irqrestore(&privcam_link_lock, flags);
+        return 0;
+    case V4L2_CID_ROTATE:
+        /* May swap the CAPTURE size, so only while no buffers exist */
+        if (vb2_is_busy(v4l2_m2m_get_dst_vq(ctx->m2m_ctx)))
+            return -EBUSY;
+        WRITE_ONCE(ctx->xform.rotate, ctrl->val);
+        return 0;
+    case PRIVCAM_CID_ENCRYPTION:
+        if (vb2_is_busy(v4l2_m2m_get_dst_vq(ctx->m2m_ctx)))
+            return -EBUSY;
+        return privcam_crypt_setup(ctx, ctrl->val, ctx->crypt_key);
+    case PRIVCAM_CID_ENCRYPTION_KEY: {
+        int ret = 0;
+
+        if (vb2_is_busy(v4l2_m2m_get_dst_vq(ctx->m2m_ctx)))
+            return -EBUSY;
+        /* While encrypting, a key that does not take keeps the old one */
+        if (ctx->crypt_mode != PRIVCAM_CRYPT_OFF)
+            ret = privcam_crypt_setup(ctx, ctx->crypt_mode, ctrl->p_new.p_u8);
+        if (!ret)
+            memcpy(ctx->crypt_key, ctrl->p_new.p_u8, sizeof(ctx->crypt_key));
+        /* Only the driver keeps it */
+        memset(ctrl->p_new.p_u8, 0, sizeof(ctx->crypt_key));
+        return ret;
+    }
+    case V4L2_CID_HFLIP:
+        WRITE_ONCE(ctx->xform.hflip, ctrl->val);
+        return 0;
+    case V4L2_CID_VFLIP:
+        WRITE_ONCE(ctx->xform.vflip, ctrl->val);
+        return 0;
+    }
+
+    return -EINVAL;
+}
+
+static const struct v4l2_ctrl_ops privcam_ctrl_ops = {
+    .s_ctrl = privcam_s_ctrl,
+};
+
+static const struct v4l2_ctrl_config privcam_ctrl_source_node = {
+    .ops = &privcam_ctrl_ops,
+    .id = PRIVCAM_CID_SOURCE_NODE,
+    .name = "Source Node",
+    .type = V4L2_CTRL_TYPE_INTEGER,
+    .min = -1, .max = 255, .step = 1, .def = -1,
+};
+
+static const struct v4l2_ctrl_config privcam_ctrl_ring_entries = {
+    .ops = &privcam_ctrl_ops,
+    .id = PRIVCAM_CID_RING_ENTRIES,
+    .name = "Completion Ring Entries",
+    .type = V4L2_CTRL_TYPE_INTEGER,
+    .min = 0, .max = PRIVCAM_RING_MAX_ENTRIES, .step = 1, .def = 0,
+};
+
+static const struct v4l2_ctrl_config privcam_ctrl_preview_scale = {
+    .ops = &privcam_ctrl_ops,
+    .id = PRIVCAM_CID_PREVIEW_SCALE,
+    .name = "Preview Scale",
+    .type = V4L2_CTRL_TYPE_INTEGER_MENU,
+    .max = ARRAY_SIZE(privcam_preview_scales) - 1,
+    .qmenu_int = privcam_preview_scales,
+};
+
+static const struct v4l2_ctrl_config privcam_ctrl_meta_plane = {
+    .ops = &privcam_ctrl_ops,
+    .id = PRIVCAM_CID_META_PLANE,
+    .name = "Metadata Plane",
+    .type = V4L2_CTRL_TYPE_BOOLEAN,
+    .min = 0, .max = 1, .step = 1, .def = 0,
+};
+
+static const struct v4l2_ctrl_config privcam_ctrl_decimation = {
+    .ops = &privcam_ctrl_ops,
+    .id = PRIVCAM_CID_DECIMATION,
+    .name = "Decimation",
+    .type = V4L2_CTRL_TYPE_INTEGER,
+    .min = 1, .max = 120, .step = 1, .def = 1,
+};
+
+static const struct v4l2_ctrl_config privcam_ctrl_max_fps = {
+    .ops = &privcam_ctrl_ops,
+    .id = PRIVCAM_CID_MAX_FPS,
+    .name = "Max Frame Rate",
+    .type = V4L2_CTRL_TYPE_INTEGER,
+    .min = 0, .max = 1000, .step = 1, .def = 0,
+};
+
+static const char * const privcam_crypt_modes[] = {
+    [PRIVCAM_CRYPT_OFF] = "Off",
+    [PRIVCAM_CRYPT_AES128_CTR] = "AES-128-CTR",
+    [PRIVCAM_CRYPT_AES256_CTR] = "AES-256-CTR",
+    NULL,
+};
+
+static const struct v4l2_ctrl_config privcam_ctrl_crypt_mode = {
+    .ops = &privcam_ctrl_ops,
+    .id = PRIVCAM_CID_ENCRYPTION,
+    .name = "Encryption",
+    .type = V4L2_CTRL_TYPE_MENU,
+    .max = PRIVCAM_CRYPT_AES256_CTR,
+    .def = PRIVCAM_CRYPT_OFF,
+    .qmenu = privcam_crypt_modes,
+};
+
+static const struct v4l2_ctrl_config privcam_ctrl_crypt_key = {
+    .ops = &privcam_ctrl_ops,
+    .id = PRIVCAM_CID_ENCRYPTION_KEY,
+    .name = "Encryption Key",
+    .type = V4L2_CTRL_TYPE_U8,
+    .min = 0, .max = 255, .step = 1, .def = 0,
+    .dims = { 32 },
+    .flags = V4L2_CTRL_FLAG_WRITE_ONLY | V4L2_CTRL_FLAG_EXECUTE_ON_WRITE,
+};
+
 static inline struct privcam_ctx *fh_to_ctx(struct v4l2_fh *fh)
 {
     return container_of(fh, struct privcam_ctx, fh);
@@ -277,6 +1980,7 @@ static int privcam_queue_setup(struct vb2_queue *vq,
 {
     struct privcam_ctx *ctx = vb2_get_drv_priv(vq);
     struct v4l2_pix_format_mplane *pf;
+    bool reqbufs = !*nplanes;       /* REQBUFS starts from an empty queue, CREATE_BUFS adds */
 
     if (vq->type == BUFTYPE_OUT)
         pf = &ctx->out_fmt;
@@ -291,6 +1995,16 @@ static int privcam_queue_setup(struct vb2_queue *vq,
     if(*nbufs < 2)
         *nbufs = 2;
 
+    if (vq->type == BUFTYPE_CAP) {
+        if (reqbufs)
+            ctx->cap_mmap_bytes = 0;
+        *nbufs = privcam_ring_cap_fit(ctx, *nbufs, *nplanes, sizes);
+        if (!*nbufs)
+            return -ENOMEM;
+        for (unsigned int i = 0; i < *nplanes; i++)
+            ctx->cap_mmap_bytes += (u64)*nbufs * PAGE_ALIGN(sizes[i]);
+    }
+
     return 0;    
 }
 
@@ -308,9 +2022,33 @@ static int privcam_buf_prepare(struct vb2_buffer *vb)
         return -EINVAL;
 
     for (unsigned int i = 0; i < pf->num_planes; i++) {
-        if (vb2_plane_size(vb, i) < pf->plane_fmt[i].sizeimage)
+        u32 sizeimage = pf->plane_fmt[i].sizeimage;
+
+        if (vb->vb2_queue->type != BUFTYPE_OUT) {
+            if (vb2_plane_size(vb, i) < sizeimage)
+                return -EINVAL;
+            continue;
+        }
+
+        /*
+         * OUTPUT planes can carry a data_offset so that all planes of a frame
+         * live in one dma-buf. bytesused includes the offset, as per the spec,
+         * and is kept as the producer set it: device_run copies only that much.
+         */
+        u32 off = vb->planes[i].data_offset;
+        u32 used = vb2_get_plane_payload(vb, i);
+
+        if (used <= off)
             return -EINVAL;
-        vb2_set_plane_payload(vb, i, pf->plane_fmt[i].sizeimage);
+
+        if (privcam_fmt_compressed(pf->pixelformat))
+            continue;
+
+        /* Raw planes: the buffer must hold a whole image; padding past it is not copied */
+        if (vb2_plane_size(vb, i) < off + sizeimage)
+            return -EINVAL;
+        if (used > off + sizeimage)
+            vb2_set_plane_payload(vb, i, off + sizeimage);
     }
 
     return 0;
@@ -320,12 +2058,82 @@ static void privcam_buf_queue(struct vb2_buffer *vb)
 {
     struct privcam_ctx *ctx = vb2_get_drv_priv(vb->vb2_queue);
     struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(vb);
+    unsigned long flags;
+    bool skip = false;
+
+    to_privcam_buf(vbuf)->qbuf_ns = ktime_get_ns();
+
+    if (vb->vb2_queue->type == BUFTYPE_OUT) {
+        /* Numbered as queued, so a decimated buffer returned early still gets its own number */
+        vbuf->sequence = ctx->out_sequence++;
+        vbuf->field = V4L2_FIELD_NONE;
+        spin_lock_irqsave(&privcam_link_lock, flags);
+        skip = privcam_decimate(ctx, vb->timestamp ? vb->timestamp : to_privcam_buf(vbuf)->qbuf_ns);
+        spin_unlock_irqrestore(&privcam_link_lock, flags);
+    }
+
+    /* Consumed ring entries go back to the CAPTURE queue before m2m checks for a job */
+    if (vb->vb2_queue->type == BUFTYPE_OUT)
+        privcam_ring_reclaim(ctx);
+
+    /* A decimated OUTPUT frame goes straight back, without a job or a CAPTURE buffer */
+    if (skip) {
+        privcam_buf_complete(ctx, vbuf, VB2_BUF_STATE_DONE);
+        return;
+    }
 
     v4l2_m2m_buf_queue(ctx->m2m_ctx, vbuf);
+
+    if (vb->vb2_queue->type == BUFTYPE_CAP && READ_ONCE(ctx->source))
+        queue_work(system_highpri_wq, &ctx->link_work);
 }
 
 static int privcam_start_streaming(struct vb2_queue *q, unsigned int count)
 {
+    struct privcam_ctx *ctx = vb2_get_drv_priv(q);
+
+    /* A linked context is fed by its source; OUTPUT streaming would race it for CAPTURE buffers */
+    if (q->type == BUFTYPE_OUT && ctx->source_nr >= 0)
+        return -EBUSY;
+
+    /* Compressed streams are passed through, so both sides must agree on the format */
+    if ((privcam_fmt_compressed(ctx->out_fmt.pixelformat) ||
+         privcam_fmt_compressed(ctx->cap_fmt.pixelformat)) &&
+        ctx->out_fmt.pixelformat != ctx->cap_fmt.pixelformat)
+        return -EINVAL;
+
+    /* A rotation needs CAPTURE sized as the rotated OUTPUT (or linked source) frame */
+    if (privcam_xform_active(&ctx->xform) && (q->type == BUFTYPE_OUT || ctx->source_nr >= 0) &&
+        privcam_xform_check(ctx, &ctx->xform, q->type == BUFTYPE_CAP))
+        return -EINVAL;
+
+    if (q->type == BUFTYPE_OUT) {
+        int ret = privcam_conv_alloc(ctx);
+
+        if (ret)
+            return ret;
+    }
+
+    /* Fresh nonce per stream */
+    if (q->type == BUFTYPE_CAP) {
+        int ret;
+
+        /* The link worker may already be filling CAPTURE buffers queued before STREAMON */
+        flush_work(&ctx->link_work);
+        ret = privcam_crypt_bounce_alloc(ctx);
+
+        if (ret)
+            return ret;
+        ctx->crypt_frames = 0;
+    }
+
+    if (q->type == BUFTYPE_CAP && ctx->ring) {
+        ctx->ring_head = 0;
+        ctx->ring_reclaim = 0;
+        WRITE_ONCE(ctx->ring->tail, 0);
+        smp_store_release(&ctx->ring->head, 0);
+    }
+
     return 0;
 }
 
@@ -333,14 +2141,30 @@ static void privcam_stop_streaming(struct vb2_queue *vq)
 {
     struct privcam_ctx *ctx = vb2_get_drv_priv(vq);
     struct vb2_v4l2_buffer *buf;
+    unsigned long flags;
 
-
-    if(vq->type == V4L2_BUF_TYPE_VIDEO_OUTPUT) {
+    if(vq->type == BUFTYPE_OUT) {
         while ((buf = v4l2_m2m_src_buf_remove(ctx->m2m_ctx)))
             v4l2_m2m_buf_done(buf, VB2_BUF_STATE_ERROR);
+        /* Buffers queued before STREAMON are decimated as they enter, so reset here, not at start */
+        spin_lock_irqsave(&privcam_link_lock, flags);
+        privcam_decimate_reset(ctx);
+        spin_unlock_irqrestore(&privcam_link_lock, flags);
     } else {
          while ((buf = v4l2_m2m_dst_buf_remove(ctx->m2m_ctx)))
             v4l2_m2m_buf_done(buf, VB2_BUF_STATE_ERROR);
+         /* A link copy may still hold a CAPTURE buffer it removed before the drain */
+         flush_work(&ctx->link_work);
+
+         /* Buffers parked in the completion ring are still owned by the driver */
+         for (unsigned int i = 0; ctx->ring && i < VB2_MAX_FRAME; i++) {
+            spin_lock_irqsave(&ctx->qlock, flags);
+            buf = ctx->ring_held[i];
+            ctx->ring_held[i] = NULL;
+            spin_unlock_irqrestore(&ctx->qlock, flags);
+            if (buf)
+                v4l2_m2m_buf_done(buf, VB2_BUF_STATE_ERROR);
+         }
     }
 }
 
@@ -361,15 +2185,25 @@ static int privcam_queue_init(void *priv, struct vb2_queue *src_vq, struct vb2_q
 
     // Output/Source queue
     src_vq->type = BUFTYPE_OUT;
-    src_vq->io_modes = VB2_MMAP | VB2_DMABUF;
+    /*
+     * USERPTR lets clients queue their own long-lived (e.g. huge-page) memory; vb2 pins it once
+     * per buffer index and only re-pins when a different address is queued on that index.
+     */
+    src_vq->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
     src_vq->drv_priv = ctx;
-    src_vq->buf_struct_size = sizeof(struct vb2_v4l2_buffer);
+    src_vq->buf_struct_size = sizeof(struct privcam_buf);
     src_vq->ops = &privcam_vb2_ops;
 #ifdef USE_DMABUF
     src_vq->mem_ops = &vb2_dma_sg_memops;
 #else
     src_vq->mem_ops = &vb2_dma_contig_memops;
 #endif
+    /*
+     * MMAP buffers may be requested with V4L2_MEMORY_FLAG_NON_COHERENT, and QBUF may carry
+     * V4L2_BUF_FLAG_NO_CACHE_CLEAN/INVALIDATE to skip the prepare/finish cache maintenance a
+     * client knows is useless (e.g. an input written once, an output never read).
+     */
+    src_vq->allow_cache_hints = 1;
     src_vq->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
     src_vq->lock = &ctx->dev->lock;
  //   src_vq->dev = ctx->dev->v4l2_dev.dev;
@@ -384,15 +2218,16 @@ static int privcam_queue_init(void *priv, struct vb2_queue *src_vq, struct vb2_q
 
     // Dest/Capture queue
     dst_vq->type = BUFTYPE_CAP;
-    dst_vq->io_modes = VB2_MMAP;
+    dst_vq->io_modes = VB2_MMAP | VB2_USERPTR;
     dst_vq->drv_priv = ctx;
-    dst_vq->buf_struct_size = sizeof(struct vb2_v4l2_buffer);
+    dst_vq->buf_struct_size = sizeof(struct privcam_buf);
     dst_vq->ops = &privcam_vb2_ops;
 #ifdef USE_DMABUF
     dst_vq->mem_ops = &vb2_vmalloc_memops;
 #else
     dst_vq->mem_ops = &vb2_dma_contig_memops;
 #endif
+    /* No allow_cache_hints: vmalloc memory has no cache maintenance for hints to skip */
     dst_vq->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
     dst_vq->lock = &ctx->dev->lock;
     dst_vq->dev = ctx->dev->v4l2_dev.dev;
@@ -401,7 +2236,8 @@ static int privcam_queue_init(void *priv, struct vb2_queue *src_vq, struct vb2_q
     
 }
 
-static void privcam_fill_fmt(struct v4l2_pix_format_mplane *mp, u32 w, u32 h, u32 fourcc)
+static void privcam_fill_fmt(struct v4l2_pix_format_mplane *mp, u32 w, u32 h, u32 fourcc,
+                             const u32 *req_bpl)
 {
     memset(mp, 0, sizeof(*mp));
     mp->width = w;
@@ -414,28 +2250,33 @@ static void privcam_fill_fmt(struct v4l2_pix_format_mplane *mp, u32 w, u32 h, u3
     if(fourcc == V4L2_PIX_FMT_YUV420M) {
         mp->num_planes = 3;
         
-        mp->plane_fmt[0].bytesperline = w;
-        mp->plane_fmt[0].sizeimage = w * h;
-
-        mp->plane_fmt[1].bytesperline = w / 2;
-        mp->plane_fmt[1].sizeimage = (w * h)/4;
+        privcam_set_plane(&mp->plane_fmt[0], req_bpl, 0, w, h);
+        privcam_set_plane(&mp->plane_fmt[1], req_bpl, 1, w / 2, h / 2);
+        privcam_set_plane(&mp->plane_fmt[2], req_bpl, 2, w / 2, h / 2);
+    } else if (privcam_fmt_compressed(fourcc)) {
+        mp->num_planes = 1;
 
-        mp->plane_fmt[2].bytesperline = w / 2;
-        mp->plane_fmt[2].sizeimage = (w * h)/4;
+        /* Worst case for a frame; userspace may ask for more through sizeimage */
+        mp->plane_fmt[0].bytesperline = 0;
+        mp->plane_fmt[0].sizeimage = (w * h) * 2;
     } else {
+        u32 row_bytes, rows;
+
         mp->num_planes = 1;
 
-        mp->plane_fmt[0].bytesperline = w * 2;
-        mp->plane_fmt[0].sizeimage = (w * h) * 2;
+        privcam_plane_geometry(mp, 0, &row_bytes, &rows);
+        privcam_set_plane(&mp->plane_fmt[0], req_bpl, 0, row_bytes, rows);
     }
 }
 
 static int privcam_enum_fmt(struct file *file, void *priv, struct v4l2_fmtdesc *f)
 {
-    if(f->index != 0)
+    if(f->index >= ARRAY_SIZE(privcam_formats))
         return -EINVAL;
 
-    f->pixelformat = PRIVCAM_DEF_PIXFMT;
+    f->pixelformat = privcam_formats[f->index].fourcc;
+    if (privcam_formats[f->index].compressed)
+        f->flags = V4L2_FMT_FLAG_COMPRESSED;
     return 0;
 }
 
@@ -455,18 +2296,30 @@ static int privcam_g_fmt(struct file *file, void *priv, struct v4l2_format *f)
 
 static int privcam_try_fmt(struct file *file, void *priv, struct v4l2_format *f)
 {
+    struct privcam_ctx *ctx = fh_to_ctx(priv);
 
     struct v4l2_pix_format_mplane *mp = &f->fmt.pix_mp;
+    u32 fourcc = privcam_find_fmt(mp->pixelformat) ? mp->pixelformat : PRIVCAM_DEF_PIXFMT;
+    u32 req_size = mp->plane_fmt[0].sizeimage;
+    u32 req_bpl[VIDEO_MAX_PLANES];
     u32 w, h;
 
-    w = mp->width ? mp->width : PRIVCAM_DEF_WIDTH;
-    h = mp->height ? mp->height : PRIVCAM_DEF_HEIGHT;
+    for (unsigned int p = 0; p < VIDEO_MAX_PLANES; p++)
+        req_bpl[p] = p < mp->num_planes ? mp->plane_fmt[p].bytesperline : 0;
+
+    w = mp->width ? clamp_t(u32, mp->width, 4, PRIVCAM_MAX_WIDTH) : PRIVCAM_DEF_WIDTH;
+    h = mp->height ? clamp_t(u32, mp->height, 2, PRIVCAM_MAX_HEIGHT) : PRIVCAM_DEF_HEIGHT;
 
-    /* YUYV needs even width */
-    w &= ~1U;
+    /* YUYV needs even width, Y10P whole 5-byte groups */
+    w &= fourcc == V4L2_PIX_FMT_Y10P ? ~3U : ~1U;
     h &= ~1U;
 
-    privcam_fill_fmt(mp, w, h, mp->pixelformat);
+    privcam_fill_fmt(mp, w, h, fourcc, req_bpl);
+    if (f->type == BUFTYPE_CAP)
+        privcam_set_extra_planes(ctx, mp, req_bpl);
+
+    if (privcam_fmt_compressed(fourcc) && req_size > mp->plane_fmt[0].sizeimage)
+        mp->plane_fmt[0].sizeimage = min_t(u32, req_size, PRIVCAM_MAX_COMPRESSED_SIZE);
     return 0;
 }
 
@@ -476,6 +2329,10 @@ static int privcam_s_fmt(struct file *file, void *priv, struct v4l2_format *f)
     struct privcam_ctx *ctx = container_of(fh, struct privcam_ctx, fh);
     int ret;
 
+    /* Buffers were sized and prepared for the current layout */
+    if (vb2_is_busy(v4l2_m2m_get_vq(ctx->m2m_ctx, f->type)))
+        return -EBUSY;
+
     ret = privcam_try_fmt(file, priv, f);
     if(ret)
         return ret;
@@ -501,8 +2358,8 @@ static int privcam_querycap(struct file *file, void *priv, struct v4l2_capabilit
 }
 
 static const struct v4l2_ioctl_ops privcam_ioctl_ops = {
-/*     .vidioc_enum_fmt_vid_cap_mplane = privcam_enum_fmt,
-    .vidioc_enum_fmt_vid_out_mplane = privcam_enum_fmt, */
+    .vidioc_enum_fmt_vid_cap = privcam_enum_fmt,
+    .vidioc_enum_fmt_vid_out = privcam_enum_fmt,
 
     .vidioc_g_fmt_vid_cap_mplane = privcam_g_fmt,
     .vidioc_g_fmt_vid_out_mplane = privcam_g_fmt,
@@ -538,6 +2395,10 @@ static int privcam_open(struct file *file)
         return -ENOMEM;
 
     spin_lock_init(&ctx->qlock);
+    INIT_WORK(&ctx->link_work, privcam_link_work);
+    ctx->source_nr = -1;
+    ctx->preview_scale = 1;
+    ctx->decimate = 1;
 
     v4l2_fh_init(&ctx->fh, &dev->vdev);
     v4l2_fh_add(&ctx->fh);
@@ -546,8 +2407,8 @@ static int privcam_open(struct file *file)
 
     ctx->dev = dev;
 
-    privcam_fill_fmt(&ctx->out_fmt, PRIVCAM_DEF_WIDTH, PRIVCAM_DEF_HEIGHT, PRIVCAM_DEF_PIXFMT);
-    privcam_fill_fmt(&ctx->cap_fmt, PRIVCAM_DEF_WIDTH, PRIVCAM_DEF_HEIGHT, PRIVCAM_DEF_PIXFMT);
+    privcam_fill_fmt(&ctx->out_fmt, PRIVCAM_DEF_WIDTH, PRIVCAM_DEF_HEIGHT, PRIVCAM_DEF_PIXFMT, NULL);
+    privcam_fill_fmt(&ctx->cap_fmt, PRIVCAM_DEF_WIDTH, PRIVCAM_DEF_HEIGHT, PRIVCAM_DEF_PIXFMT, NULL);
 
     ctx->m2m_ctx = v4l2_m2m_ctx_init(dev->m2m_dev, ctx, privcam_queue_init);
     if(IS_ERR(ctx->m2m_ctx)) {
@@ -562,6 +2423,33 @@ static int privcam_open(struct file *file)
 
     ctx->fh.m2m_ctx = ctx->m2m_ctx;
 
+    v4l2_ctrl_handler_init(&ctx->ctrl_handler, 11);
+    v4l2_ctrl_new_custom(&ctx->ctrl_handler, &privcam_ctrl_source_node, NULL);
+    v4l2_ctrl_new_custom(&ctx->ctrl_handler, &privcam_ctrl_ring_entries, NULL);
+    v4l2_ctrl_new_custom(&ctx->ctrl_handler, &privcam_ctrl_preview_scale, NULL);
+    v4l2_ctrl_new_custom(&ctx->ctrl_handler, &privcam_ctrl_meta_plane, NULL);
+    v4l2_ctrl_new_custom(&ctx->ctrl_handler, &privcam_ctrl_decimation, NULL);
+    v4l2_ctrl_new_custom(&ctx->ctrl_handler, &privcam_ctrl_max_fps, NULL);
+    v4l2_ctrl_new_std(&ctx->ctrl_handler, &privcam_ctrl_ops, V4L2_CID_ROTATE, 0, 270, 90, 0);
+    v4l2_ctrl_new_std(&ctx->ctrl_handler, &privcam_ctrl_ops, V4L2_CID_HFLIP, 0, 1, 1, 0);
+    v4l2_ctrl_new_std(&ctx->ctrl_handler, &privcam_ctrl_ops, V4L2_CID_VFLIP, 0, 1, 1, 0);
+    v4l2_ctrl_new_custom(&ctx->ctrl_handler, &privcam_ctrl_crypt_mode, NULL);
+    v4l2_ctrl_new_custom(&ctx->ctrl_handler, &privcam_ctrl_crypt_key, NULL);
+    if (ctx->ctrl_handler.error) {
+        ret = ctx->ctrl_handler.error;
+        v4l2_ctrl_handler_free(&ctx->ctrl_handler);
+        v4l2_m2m_ctx_release(ctx->m2m_ctx);
+        v4l2_fh_del(&ctx->fh);
+        v4l2_fh_exit(&ctx->fh);
+        kfree(ctx);
+        return ret;
+    }
+    ctx->fh.ctrl_handler = &ctx->ctrl_handler;
+
+    mutex_lock(&privcam_link_mutex);
+    list_add_tail(&ctx->link_node, &privcam_link_ctxs);
+    mutex_unlock(&privcam_link_mutex);
+
     return 0;
 }
 
@@ -570,25 +2458,63 @@ static int privcam_release(struct file *file)
     struct v4l2_fh *fh = file->private_data;
     struct privcam_ctx *ctx = container_of(fh, struct privcam_ctx, fh);
 
+    mutex_lock(&privcam_link_mutex);
+    privcam_link_unbind(ctx);
+    list_del(&ctx->link_node);
+    mutex_unlock(&privcam_link_mutex);
+    cancel_work_sync(&ctx->link_work);
+
     if(ctx->m2m_ctx) {
         ctx->fh.m2m_ctx = NULL;
         v4l2_m2m_ctx_release(ctx->m2m_ctx);
     }
 
+    v4l2_ctrl_handler_free(&ctx->ctrl_handler);
     v4l2_fh_del(&ctx->fh);
     v4l2_fh_exit(fh);
 
+    vfree(ctx->ring);
+    kfree(ctx->ring_shadow);
+    kfree(ctx->conv_row);
+    privcam_crypt_free(ctx);
+    memzero_explicit(ctx->crypt_key, sizeof(ctx->crypt_key));
     kfree(ctx);
     return 0;
 }
 
+static __poll_t privcam_poll(struct file *file, struct poll_table_struct *wait)
+{
+    struct privcam_ctx *ctx = fh_to_ctx(file->private_data);
+
+    /* Ring users consume CAPTURE entries without a syscall; poll is where they get picked up */
+    if (ctx->ring) {
+        privcam_ring_reclaim(ctx);
+        v4l2_m2m_try_schedule(ctx->m2m_ctx);
+    }
+
+    return v4l2_m2m_fop_poll(file, wait);
+}
+
+static int privcam_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct privcam_ctx *ctx = fh_to_ctx(file->private_data);
+
+    if (vma->vm_pgoff == PRIVCAM_RING_MMAP_OFFSET >> PAGE_SHIFT) {
+        if (!ctx->ring)
+            return -EINVAL;
+        return remap_vmalloc_range(vma, ctx->ring, 0);
+    }
+
+    return v4l2_m2m_fop_mmap(file, vma);
+}
+
 static const struct v4l2_file_operations privcam_fops = {
     .owner = THIS_MODULE,
     .open = privcam_open,
     .release = privcam_release,
-    .poll = v4l2_m2m_fop_poll,
+    .poll = privcam_poll,
     .unlocked_ioctl = video_ioctl2,
-    .mmap = v4l2_m2m_fop_mmap,   // checkgdc
+    .mmap = privcam_mmap,   // checkgdc
 };
 
 
@@ -692,4 +2618,8 @@ module_exit(privcam_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Privacy Camera V4l2 M2M Skeleton");
-MODULE_AUTHOR("RATH");
\ No newline at end of file
+MODULE_AUTHOR("RATH");
+
+#ifdef PRIVCAM_KUNIT_TEST
+#include "privcam_test.c"
+#endif
@@ -0,0 +1,49 @@
+/*
+ * privcam_link.h - in-kernel source -> privcam frame link
+ *
+ * A capture driver registers itself as a source under its video node number. A privcam context
+ * binds to it by setting the "Source Node" control to that number. From then on the source
+ * pushes every completed frame straight into the bound context, privcam copies it into the next
+ * CAPTURE buffer from a workqueue, and hands the frame back through release(). The source
+ * recycles its buffer without userspace ever seeing it, so the userspace camera DQBUF/QBUF and
+ * privcam OUTPUT QBUF/DQBUF per frame all disappear; userspace only deals with privcam CAPTURE.
+ *
+ * Sources resolve these symbols with symbol_get() so they load and stream without privcam.
+ */
+
+#ifndef PRIVCAM_LINK_H
+#define PRIVCAM_LINK_H
+
+#include <linux/list.h>
+#include <linux/types.h>
+
+struct privcam_ctx;
+
+struct privcam_link_frame {
+    void *vaddr;                /* linear kernel mapping of the payload */
+    size_t bytesused;
+    u32 bytesperline;           /* stride of vaddr; 0 for compressed payloads */
+    u64 timestamp;              /* ns, CLOCK_MONOTONIC */
+    u32 sequence;               /* source sequence, passed on as the CAPTURE sequence */
+
+    /* Called exactly once when privcam is done with the frame, from any context but IRQ */
+    void (*release)(struct privcam_link_frame *frame);
+};
+
+struct privcam_source {
+    int video_nr;
+
+    /* privcam internal */
+    struct list_head list;
+    struct privcam_ctx *sink;
+};
+
+int privcam_link_register(struct privcam_source *src);
+
+/* Returns after every pushed frame has been released */
+void privcam_link_unregister(struct privcam_source *src);
+
+/* 0: privcam owns the frame until release(). -ENOLINK: no context is bound, keep the frame. */
+int privcam_link_push(struct privcam_source *src, struct privcam_link_frame *frame);
+
+#endif /* PRIVCAM_LINK_H */
@@ -0,0 +1,76 @@
+/*
+ * privcam_meta.h - per-frame metadata plane, shared by privcam and its userspace clients
+ *
+ * Setting the "Metadata Plane" control before CAPTURE buffers are allocated appends one plane
+ * to every CAPTURE format; it is always the last plane and holds one struct privcam_meta.
+ * Everything in it is produced in the same pass that copies the frame, so reading it replaces
+ * a second pass over the image in userspace.
+ *
+ * stats is valid when PRIVCAM_META_F_STATS is set, i.e. for raw formats: luma histogram,
+ * min/max/mean and the mean of each block of a PRIVCAM_STATS_GRID x PRIVCAM_STATS_GRID grid.
+ *
+ * info is valid when PRIVCAM_META_F_TIMING is set (always, currently): where and when privcam
+ * handled the frame, so latency can be attributed per frame without tracing. Times are
+ * CLOCK_MONOTONIC ns, comparable with clock_gettime() in userspace.
+ *
+ * iv is valid when PRIVCAM_META_F_ENCRYPTED is set: the frame was encrypted with the
+ * "Encryption" mode and "Encryption Key" controls. Each image plane is one CTR stream over the
+ * whole plane buffer, padding included. Its 16-byte big-endian counter block is iv with the
+ * last 32-bit word set to plane << 28. Preview and statistics are not produced for encrypted
+ * frames.
+ */
+
+#ifndef PRIVCAM_META_H
+#define PRIVCAM_META_H
+
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+#define PRIVCAM_CID_META_PLANE      (V4L2_CID_USER_BASE + 0x1103)
+#define PRIVCAM_CID_ENCRYPTION      (V4L2_CID_USER_BASE + 0x1106)    /* menu, PRIVCAM_CRYPT_* */
+#define PRIVCAM_CID_ENCRYPTION_KEY  (V4L2_CID_USER_BASE + 0x1107)    /* u8[32], write-only */
+
+#define PRIVCAM_CRYPT_OFF           0
+#define PRIVCAM_CRYPT_AES128_CTR    1       /* key bytes 0-15 */
+#define PRIVCAM_CRYPT_AES256_CTR    2
+
+#define PRIVCAM_META_VERSION        1
+#define PRIVCAM_META_F_STATS        (1u << 0)
+#define PRIVCAM_META_F_TIMING       (1u << 1)
+#define PRIVCAM_META_F_ENCRYPTED    (1u << 2)
+
+#define PRIVCAM_STATS_GRID          16
+
+struct privcam_stats {
+    __u32 width;                    /* luma samples per row */
+    __u32 height;                   /* rows measured */
+    __u32 y_min, y_max;
+    __u32 y_mean;
+    __u32 reserved;
+    __u64 y_sum;
+    __u32 hist[256];
+    __u32 block_mean[PRIVCAM_STATS_GRID * PRIVCAM_STATS_GRID];     /* row-major */
+};
+
+struct privcam_frame_info {
+    __u64 out_qbuf_ns;              /* OUTPUT buffer queued, 0 for linked sources */
+    __u64 cap_qbuf_ns;              /* CAPTURE buffer queued */
+    __u64 run_start_ns;             /* copy started */
+    __u64 run_end_ns;               /* copy and statistics finished */
+    __u32 cpu;                      /* CPU that did the copy */
+    __u32 dropped;                  /* source frames dropped since the previous CAPTURE buffer */
+    __u32 copy_bytes[3];            /* bytes copied per image plane */
+    __u32 reserved;
+};
+
+struct privcam_meta {
+    __u32 version;                  /* PRIVCAM_META_VERSION */
+    __u32 size;                     /* sizeof(struct privcam_meta) */
+    __u32 flags;                    /* PRIVCAM_META_F_* */
+    __u32 sequence;                 /* CAPTURE sequence this record belongs to */
+    struct privcam_stats stats;
+    struct privcam_frame_info info;
+    __u8 iv[16];                    /* counter block of plane 0 offset 0 */
+};
+
+#endif /* PRIVCAM_META_H */
@@ -0,0 +1,70 @@
+/*
+ * privcam_ring.h - mmap'able completion ring, shared by privcam and its userspace clients
+ *
+ * Enabled per context by setting the "Completion Ring Entries" control (a power of two) before
+ * the CAPTURE queue has buffers, then mapped with
+ *
+ *     mmap(NULL, privcam_ring_bytes(entries), PROT_READ | PROT_WRITE, MAP_SHARED, fd, PRIVCAM_RING_MMAP_OFFSET)
+ *
+ * privcam appends one entry per completed buffer of either queue and publishes it by advancing
+ * head (release). Userspace reads entries between tail and head and then advances tail. Entries
+ * are single-producer / single-consumer, in the style of io_uring CQEs.
+ *
+ * A successfully completed CAPTURE buffer is posted with PRIVCAM_CQE_F_HELD: privcam keeps it
+ * instead of handing it to vb2, and consuming the entry (moving tail past it) queues it straight
+ * back for the next frame. Such buffers are never DQBUF'd or QBUF'd by userspace; the frame must
+ * be read before tail moves. Consumed buffers are picked up on the next OUTPUT QBUF, at the end
+ * of every job, and on poll(), so a poll() with a zero timeout also works as a kick.
+ * OUTPUT buffers and failed CAPTURE buffers complete through vb2 as usual; their entries only
+ * save the poll. If the ring is full the buffer completes through vb2 and overflow counts it.
+ *
+ * The ring resets (head = tail = 0) at CAPTURE STREAMON. While it is on, REQBUFS/CREATE_BUFS on
+ * CAPTURE grant only as many buffers as keep every mmap offset below PRIVCAM_RING_MMAP_OFFSET.
+ */
+
+#ifndef PRIVCAM_RING_H
+#define PRIVCAM_RING_H
+
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+#define PRIVCAM_CID_RING_ENTRIES    (V4L2_CID_USER_BASE + 0x1101)
+#define PRIVCAM_RING_MMAP_OFFSET    0x80000000u                 /* CAPTURE buffers are kept below it */
+#define PRIVCAM_RING_MAX_ENTRIES    4096
+#define PRIVCAM_RING_HDR_SIZE       64
+
+#define PRIVCAM_CQE_F_ERROR         (1u << 0)   /* buffer completed with VB2_BUF_STATE_ERROR */
+#define PRIVCAM_CQE_F_HELD          (1u << 1)   /* CAPTURE buffer owned by the ring, see above */
+
+struct privcam_ring_hdr {
+    __u32 entries;                  /* power of two */
+    __u32 entry_size;               /* sizeof(struct privcam_cqe) */
+    __u32 head;                     /* written by privcam */
+    __u32 tail;                     /* written by userspace */
+    __u32 overflow;                 /* completions that did not fit and went through DQBUF */
+    __u32 reserved[11];
+};
+
+struct privcam_cqe {
+    __u32 type;                     /* V4L2_BUF_TYPE_VIDEO_{OUTPUT,CAPTURE}_MPLANE */
+    __u32 index;
+    __u32 sequence;
+    __u32 flags;                    /* PRIVCAM_CQE_F_* */
+    __u64 timestamp_ns;
+    __u32 bytesused[3];
+    __u32 reserved;
+};
+
+static inline unsigned long privcam_ring_bytes(unsigned int entries)
+{
+    unsigned long bytes = PRIVCAM_RING_HDR_SIZE + (unsigned long)entries * sizeof(struct privcam_cqe);
+
+    return (bytes + 4095) & ~4095ul;
+}
+
+static inline struct privcam_cqe *privcam_ring_cqes(struct privcam_ring_hdr *hdr)
+{
+    return (struct privcam_cqe *)((char *)hdr + PRIVCAM_RING_HDR_SIZE);
+}
+
+#endif /* PRIVCAM_RING_H */
@@ -0,0 +1,73 @@
+/*
+ * privcam_source.h - binding a privcam context to a link source, shared by privcam and its
+ * userspace clients
+ *
+ * The "Source Node" control takes the video node number N of /dev/videoN that a capture driver
+ * registered under (see privcam_link.h); -1 unbinds. Userspace usually has a device path, so
+ * the helpers below resolve it through sysfs, which also works for udev-renamed nodes.
+ */
+
+#ifndef PRIVCAM_SOURCE_H
+#define PRIVCAM_SOURCE_H
+
+#include <linux/videodev2.h>
+
+#define PRIVCAM_CID_SOURCE_NODE     (V4L2_CID_USER_BASE + 0x1100)    /* int, -1 = unlinked */
+
+#ifndef __KERNEL__
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+/* N for the character device at path, or -1 if it is not a video node */
+static inline int privcam_video_node_number(const char *path)
+{
+    char link[64], target[256];
+    struct stat st;
+    const char *name;
+    ssize_t n;
+    int nr;
+
+    if (stat(path, &st) < 0) {
+        perror(path);
+        return -1;
+    }
+    snprintf(link, sizeof(link), "/sys/dev/char/%u:%u", major(st.st_rdev), minor(st.st_rdev));
+
+    n = readlink(link, target, sizeof(target) - 1);
+    if (n < 0) {
+        perror(link);
+        return -1;
+    }
+    target[n] = '\0';
+
+    name = strrchr(target, '/');
+    if (!name || sscanf(name, "/video%d", &nr) != 1) {
+        fprintf(stderr, "%s: not a video node\n", path);
+        return -1;
+    }
+    return nr;
+}
+
+/* Binds the privcam context on fd to source node nr, or unbinds it with -1 */
+static inline int privcam_set_source_node(int fd, int nr)
+{
+    struct v4l2_control ctrl = { .id = PRIVCAM_CID_SOURCE_NODE, .value = nr };
+    int r;
+
+    do { r = ioctl(fd, VIDIOC_S_CTRL, &ctrl); } while (r == -1 && errno == EINTR);
+    if (r < 0) {
+        perror("set privcam Source Node");
+        return -1;
+    }
+    return 0;
+}
+
+#endif /* !__KERNEL__ */
+
+#endif /* PRIVCAM_SOURCE_H */
@@ -0,0 +1,626 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * privcam_test.c - KUnit suites for the privcam copy and conversion kernels
+ *
+ * Included at the end of privcam.c when built with "make PRIVCAM_KUNIT=1", so the static
+ * kernels are tested as they are, without exporting anything. Needs CONFIG_KUNIT on 6.6 or
+ * later (KUnit actions); the suites run when the module loads and report through dmesg and
+ * /sys/kernel/debug/kunit/.
+ *
+ *   privcam-copy        correctness over the sg layouts privcam meets: many small entries,
+ *                       page-unaligned entries straddling pages, huge contiguous entries
+ *   privcam-copy-bench  GB/s of each kernel variant on a 1920x1080 YUYV frame
+ *
+ * Neither needs a camera, so hot path changes can be checked and measured in a VM.
+ */
+
+#include <kunit/test.h>
+#include <linux/sizes.h>
+
+enum privcam_test_layout {
+    PRIVCAM_TEST_SMALL,             /* many short entries at odd offsets */
+    PRIVCAM_TEST_UNALIGNED,         /* page-sized entries that straddle page boundaries */
+    PRIVCAM_TEST_HUGE,              /* 2 MiB physically contiguous entries */
+};
+
+static const char * const privcam_test_layout_names[] = {
+    [PRIVCAM_TEST_SMALL] = "small",
+    [PRIVCAM_TEST_UNALIGNED] = "unaligned",
+    [PRIVCAM_TEST_HUGE] = "huge",
+};
+
+/* An sg table over its own pages, plus a linear copy of what it describes */
+struct privcam_test_sg {
+    struct sg_table sgt;
+    struct page **pages;
+    unsigned int *orders;
+    unsigned int n;
+    u8 *ref;
+    size_t len;
+};
+
+#define PRIVCAM_TEST_FRAME_W    1920
+#define PRIVCAM_TEST_FRAME_H    1080
+#define PRIVCAM_TEST_FRAME      (PRIVCAM_TEST_FRAME_W * PRIVCAM_TEST_FRAME_H * 2)
+
+static void privcam_test_entry(enum privcam_test_layout layout, unsigned int i, u32 *len, u32 *off)
+{
+    switch (layout) {
+    case PRIVCAM_TEST_SMALL:
+        *len = 64 + (i * 97) % 1984;
+        *off = (i * 131) % (PAGE_SIZE - *len);
+        break;
+    case PRIVCAM_TEST_UNALIGNED:
+        *len = PAGE_SIZE + (i % 3) * 512 - 7;
+        *off = 1 + (i * 61) % (PAGE_SIZE - 1);
+        break;
+    case PRIVCAM_TEST_HUGE:
+        *len = SZ_2M - (i & 1) * 64;
+        *off = (i & 1) * 64;
+        break;
+    }
+}
+
+static u8 privcam_test_pattern(size_t k)
+{
+    return k * 7 + (k >> 8) + (k >> 16);
+}
+
+static void privcam_test_sg_free(struct privcam_test_sg *t)
+{
+    for (unsigned int i = 0; i < t->n; i++)
+        __free_pages(t->pages[i], t->orders[i]);
+    sg_free_table(&t->sgt);
+    kfree(t->pages);
+    kfree(t->orders);
+    kvfree(t->ref);
+    kfree(t);
+}
+
+/* At least total bytes in the given layout; NULL if memory (e.g. a 2 MiB block) is not available */
+static struct privcam_test_sg *privcam_test_sg_alloc(enum privcam_test_layout layout, size_t total)
+{
+    struct privcam_test_sg *t = kzalloc(sizeof(*t), GFP_KERNEL);
+    struct scatterlist *sg;
+    unsigned int n = 0, i;
+    size_t pos = 0;
+    u32 len, off;
+
+    if (!t)
+        return NULL;
+
+    while (t->len < total) {
+        privcam_test_entry(layout, n++, &len, &off);
+        t->len += len;
+    }
+
+    t->ref = kvmalloc(t->len, GFP_KERNEL);
+    t->pages = kcalloc(n, sizeof(*t->pages), GFP_KERNEL);
+    t->orders = kcalloc(n, sizeof(*t->orders), GFP_KERNEL);
+    if (!t->ref || !t->pages || !t->orders || sg_alloc_table(&t->sgt, n, GFP_KERNEL)) {
+        privcam_test_sg_free(t);
+        return NULL;
+    }
+
+    for_each_sg(t->sgt.sgl, sg, n, i) {
+        privcam_test_entry(layout, i, &len, &off);
+        t->orders[i] = get_order(off + len);
+        t->pages[i] = alloc_pages(GFP_KERNEL | __GFP_NOWARN, t->orders[i]);
+        if (!t->pages[i]) {
+            privcam_test_sg_free(t);
+            return NULL;
+        }
+        t->n++;
+
+        for (u32 k = 0; k < len; k++)
+            t->ref[pos + k] = privcam_test_pattern(pos + k);
+        memcpy(page_address(t->pages[i]) + off, t->ref + pos, len);
+        sg_set_page(sg, t->pages[i], len, off);
+        pos += len;
+    }
+    return t;
+}
+
+/*
+ * Everything a case allocates is freed by a KUnit action, so a failed assertion cannot leak it.
+ * The _put helpers free early, to keep only one layout's pages around at a time.
+ */
+static void privcam_test_sg_release(void *t)
+{
+    privcam_test_sg_free(t);
+}
+
+static void privcam_test_vfree(void *p)
+{
+    vfree(p);
+}
+
+static void privcam_test_crypt_release(void *ctx)
+{
+    privcam_crypt_free(ctx);
+}
+
+static struct privcam_test_sg *privcam_test_sg_get(struct kunit *test, enum privcam_test_layout layout,
+                                                   size_t total)
+{
+    struct privcam_test_sg *t = privcam_test_sg_alloc(layout, total);
+
+    if (!t) {
+        kunit_info(test, "%s: no memory for the sg layout, skipped", privcam_test_layout_names[layout]);
+        return NULL;
+    }
+    KUNIT_ASSERT_EQ(test, kunit_add_action_or_reset(test, privcam_test_sg_release, t), 0);
+    return t;
+}
+
+static void privcam_test_sg_put(struct kunit *test, struct privcam_test_sg *t)
+{
+    kunit_release_action(test, privcam_test_sg_release, t);
+}
+
+static void *privcam_test_vmalloc(struct kunit *test, size_t size)
+{
+    void *p = vmalloc(size);
+
+    KUNIT_ASSERT_NOT_NULL(test, p);
+    KUNIT_ASSERT_EQ(test, kunit_add_action_or_reset(test, privcam_test_vfree, p), 0);
+    return p;
+}
+
+static void privcam_test_vput(struct kunit *test, void *p)
+{
+    kunit_release_action(test, privcam_test_vfree, p);
+}
+
+static void privcam_test_sg_to_linear(struct kunit *test)
+{
+    for (int layout = PRIVCAM_TEST_SMALL; layout <= PRIVCAM_TEST_HUGE; layout++) {
+        struct privcam_test_sg *t = privcam_test_sg_get(test, layout, SZ_256K);
+        u8 *dst;
+
+        if (!t)
+            continue;
+        dst = privcam_test_vmalloc(test, t->len);
+
+        const size_t skips[] = { 0, 1, 63, PAGE_SIZE - 1, PAGE_SIZE + 1, t->len / 3 };
+
+        for (unsigned int s = 0; s < ARRAY_SIZE(skips); s++) {
+            size_t skip = skips[s], want = t->len - skip;
+
+            memset(dst, 0, t->len);
+            KUNIT_EXPECT_EQ(test, privcam_sg_to_linear(&t->sgt, skip, dst, want, NULL), want);
+            KUNIT_EXPECT_MEMEQ(test, dst, t->ref + skip, want);
+
+            /* Short copies stop exactly at len; asking past the end returns what is there */
+            KUNIT_EXPECT_EQ(test, privcam_sg_to_linear(&t->sgt, skip, dst, want / 2, NULL), want / 2);
+            KUNIT_EXPECT_EQ(test, privcam_sg_to_linear(&t->sgt, skip, dst, want + 4096, NULL), want);
+        }
+
+        privcam_test_vput(test, dst);
+        privcam_test_sg_put(test, t);
+    }
+}
+
+static void privcam_test_sg_to_linear_rows(struct kunit *test)
+{
+    static const u32 row_sizes[] = { 100, 1280, 3840 };
+
+    for (int layout = PRIVCAM_TEST_SMALL; layout <= PRIVCAM_TEST_HUGE; layout++) {
+        struct privcam_test_sg *t = privcam_test_sg_get(test, layout, SZ_256K);
+
+        if (!t)
+            continue;
+
+        for (unsigned int i = 0; i < ARRAY_SIZE(row_sizes); i++) {
+            u32 row_bytes = row_sizes[i];
+            u32 src_bpl = row_bytes + 48, dst_bpl = ALIGN(row_bytes, 64) + 64;
+            size_t skip = 17;
+            u32 rows = (t->len - skip - row_bytes) / src_bpl + 1;
+            u8 *dst = privcam_test_vmalloc(test, (size_t)rows * dst_bpl);
+
+            memset(dst, 0x5a, (size_t)rows * dst_bpl);
+
+            KUNIT_EXPECT_EQ(test, privcam_sg_to_linear_rows(&t->sgt, skip, src_bpl, dst, dst_bpl,
+                                                            row_bytes, rows, NULL, NULL, NULL),
+                            (size_t)rows * row_bytes);
+            for (u32 r = 0; r < rows; r++) {
+                const u8 *out = dst + (size_t)r * dst_bpl;
+
+                KUNIT_EXPECT_MEMEQ(test, out, t->ref + skip + (size_t)r * src_bpl, row_bytes);
+                /* Destination padding is never written */
+                KUNIT_EXPECT_EQ(test, out[row_bytes], 0x5a);
+                KUNIT_EXPECT_EQ(test, out[dst_bpl - 1], 0x5a);
+            }
+
+            /* One row more than the table holds: a short copy, not an overrun */
+            KUNIT_EXPECT_LT(test, privcam_sg_to_linear_rows(&t->sgt, t->len - row_bytes / 2, src_bpl, dst,
+                                                            dst_bpl, row_bytes, 1, NULL, NULL, NULL),
+                            (size_t)row_bytes);
+            privcam_test_vput(test, dst);
+        }
+        privcam_test_sg_put(test, t);
+    }
+}
+
+/* Straight from the Y10P layout description, one pixel at a time */
+static u16 privcam_test_y10p_pixel(const u8 *group, unsigned int i)
+{
+    return group[i] << 2 | ((group[4] >> (2 * i)) & 3);
+}
+
+static void privcam_test_y10p(struct kunit *test)
+{
+    const u32 width = 64;
+    u8 packed[64 / 4 * 5], repacked[64 / 4 * 5];
+    u16 px[64];
+
+    for (unsigned int it = 0; it < 256; it++) {
+        for (unsigned int k = 0; k < sizeof(packed); k++)
+            packed[k] = privcam_test_pattern(k * 31 + it * 1009);
+
+        privcam_unpack_y10p((u8 *)px, packed, width);
+        for (u32 x = 0; x < width; x++)
+            KUNIT_EXPECT_EQ(test, le16_to_cpu((__force __le16)px[x]),
+                            privcam_test_y10p_pixel(packed + x / 4 * 5, x % 4));
+
+        privcam_pack_y10p(repacked, (u8 *)px, width);
+        KUNIT_EXPECT_MEMEQ(test, repacked, packed, sizeof(packed));
+    }
+}
+
+/* Y10P rows gathered from every layout and unpacked on the way, as device_run does */
+static void privcam_test_y10p_rows(struct kunit *test)
+{
+    const u32 width = 1920, src_rb = width / 4 * 5, src_bpl = src_rb + 64, dst_bpl = width * 2 + 128;
+
+    for (int layout = PRIVCAM_TEST_SMALL; layout <= PRIVCAM_TEST_HUGE; layout++) {
+        struct privcam_test_sg *t = privcam_test_sg_get(test, layout, SZ_256K);
+        struct privcam_conv cv = { privcam_unpack_y10p, NULL, width, width * 2 };
+        u32 rows;
+        u8 *dst;
+
+        if (!t)
+            continue;
+        rows = (t->len - src_rb) / src_bpl + 1;
+        dst = privcam_test_vmalloc(test, (size_t)rows * dst_bpl);
+        cv.row = kunit_kmalloc(test, src_rb, GFP_KERNEL);
+        KUNIT_ASSERT_NOT_NULL(test, cv.row);
+
+        KUNIT_EXPECT_EQ(test, privcam_sg_to_linear_rows(&t->sgt, 0, src_bpl, dst, dst_bpl, src_rb, rows,
+                                                        NULL, &cv, NULL),
+                        (size_t)rows * src_rb);
+        for (u32 r = 0; r < rows; r++) {
+            const __le16 *out = (const __le16 *)(dst + (size_t)r * dst_bpl);
+            const u8 *in = t->ref + (size_t)r * src_bpl;
+
+            for (u32 x = 0; x < width; x++)
+                if (le16_to_cpu(out[x]) != privcam_test_y10p_pixel(in + x / 4 * 5, x % 4))
+                    KUNIT_FAIL(test, "%s: row %u pixel %u", privcam_test_layout_names[layout], r, x);
+        }
+
+        kunit_kfree(test, cv.row);
+        privcam_test_vput(test, dst);
+        privcam_test_sg_put(test, t);
+    }
+}
+
+/* Every rotation and flip against privcam_xform_point, per pixel */
+static void privcam_test_xform(struct kunit *test)
+{
+    static const u32 fourccs[] = { V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_YUV420M };
+    struct privcam_ctx *ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+    const u32 w = 70, h = 38;
+    u8 *src = kunit_kzalloc(test, 2 * w * h + 2 * SZ_4K, GFP_KERNEL);
+    u8 *dst = kunit_kzalloc(test, 2 * w * h + 2 * SZ_4K, GFP_KERNEL);
+
+    KUNIT_ASSERT_NOT_NULL(test, ctx);
+    KUNIT_ASSERT_NOT_NULL(test, src);
+    KUNIT_ASSERT_NOT_NULL(test, dst);
+
+    for (unsigned int f = 0; f < ARRAY_SIZE(fourccs); f++) {
+        u32 bpp = fourccs[f] == V4L2_PIX_FMT_YUYV ? 2 : 1;
+        u32 sbpl = w * bpp + 6;
+
+        ctx->cap_fmt.pixelformat = fourccs[f];
+        for (u32 k = 0; k < sbpl * h; k++)
+            src[k] = privcam_test_pattern(k);
+
+        for (u32 rot = 0; rot < 360; rot += 90) {
+            for (u32 flips = 0; flips < 4; flips++) {
+                bool t = rot == 90 || rot == 270;
+                u32 ow = t ? h : w, oh = t ? w : h, dbpl = ow * bpp + 10;
+                struct privcam_xform_cfg x = { rot, flips & 1, flips & 2 };
+                u32 bad = 0;
+
+                privcam_xform_plane(ctx, &x, 0, w, h, src, sbpl, dst, dbpl, NULL, NULL);
+
+                for (u32 oy = 0; oy < oh; oy++) {
+                    for (u32 ox = 0; ox < ow; ox++) {
+                        int sx, sy;
+
+                        privcam_xform_point(&x, w, h, ox, oy, &sx, &sy);
+                        if (dst[oy * dbpl + ox * bpp] != src[sy * sbpl + sx * bpp])
+                            bad++;
+                    }
+                }
+                KUNIT_EXPECT_EQ_MSG(test, bad, 0, "fourcc %p4cc rotate %u hflip %u vflip %u",
+                                    &fourccs[f], rot, flips & 1, !!(flips & 2));
+            }
+        }
+    }
+}
+
+static int privcam_test_crypt_ctx(struct kunit *test, struct privcam_ctx *ctx)
+{
+    int ret;
+
+    for (unsigned int k = 0; k < sizeof(ctx->crypt_key); k++)
+        ctx->crypt_key[k] = k * 11 + 3;
+    KUNIT_ASSERT_EQ(test, kunit_add_action_or_reset(test, privcam_test_crypt_release, ctx), 0);
+    ret = privcam_crypt_setup(ctx, PRIVCAM_CRYPT_AES128_CTR, ctx->crypt_key);
+    if (ret)
+        kunit_info(test, "ctr(aes) unavailable (%d), skipped", ret);
+    return ret;
+}
+
+/*
+ * The chunked keystream, consumed in any order and from any offset, must equal one CTR pass
+ * over the plane with the counter block privcam_meta.h documents.
+ */
+static void privcam_test_crypt(struct kunit *test)
+{
+    const size_t len = 3 * PRIVCAM_CRYPT_CHUNK + 100;
+    struct privcam_ctx *ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+    u8 *plain = kunit_kzalloc(test, len, GFP_KERNEL);
+    u8 *ref = kunit_kzalloc(test, len, GFP_KERNEL);
+    u8 *out = kunit_kzalloc(test, len, GFP_KERNEL);
+    struct privcam_crypt_stream cs;
+    struct scatterlist sg;
+    __be32 iv[4];
+
+    KUNIT_ASSERT_NOT_NULL(test, ctx);
+    KUNIT_ASSERT_NOT_NULL(test, plain);
+    KUNIT_ASSERT_NOT_NULL(test, ref);
+    KUNIT_ASSERT_NOT_NULL(test, out);
+    if (privcam_test_crypt_ctx(test, ctx))
+        return;
+
+    for (size_t k = 0; k < len; k++)
+        plain[k] = privcam_test_pattern(k);
+
+    KUNIT_ASSERT_TRUE(test, privcam_crypt_frame(ctx, &cs));
+    privcam_crypt_plane(&cs, 1);
+
+    /* Reference: the whole plane in one request, counter block built as userspace would */
+    {
+        SYNC_SKCIPHER_REQUEST_ON_STACK(req, ctx->crypt_tfm);
+
+        privcam_crypt_iv(&cs, 1 << 28, iv);
+        memcpy(ref, plain, len);
+        sg_init_one(&sg, ref, len);
+        skcipher_request_set_sync_tfm(req, ctx->crypt_tfm);
+        skcipher_request_set_callback(req, 0, NULL, NULL);
+        skcipher_request_set_crypt(req, &sg, &sg, len, (u8 *)iv);
+        KUNIT_ASSERT_EQ(test, crypto_skcipher_encrypt(req), 0);
+    }
+
+    /* Back to front in odd pieces, so every piece seeks and most straddle chunks */
+    for (size_t end = len; end; ) {
+        size_t n = min_t(size_t, end, 1000 + end % 777);
+
+        KUNIT_ASSERT_TRUE(test, privcam_crypt_xor(&cs, out + end - n, plain + end - n, end - n, n));
+        end -= n;
+    }
+    KUNIT_EXPECT_MEMEQ(test, out, ref, len);
+
+    /* In place, XOR twice is the identity */
+    KUNIT_ASSERT_TRUE(test, privcam_crypt_xor(&cs, out, out, 0, len));
+    KUNIT_EXPECT_MEMEQ(test, out, plain, len);
+
+    /* The next frame never reuses keystream */
+    KUNIT_ASSERT_TRUE(test, privcam_crypt_frame(ctx, &cs));
+    privcam_crypt_plane(&cs, 1);
+    KUNIT_ASSERT_TRUE(test, privcam_crypt_xor(&cs, out, plain, 0, len));
+    KUNIT_EXPECT_TRUE(test, memcmp(out, ref, len) != 0);
+}
+
+/* Without a key nothing is encrypted, and a failed switch leaves the running mode alone */
+static void privcam_test_crypt_key(struct kunit *test)
+{
+    struct privcam_ctx *ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+    struct crypto_sync_skcipher *tfm;
+    u8 zero[32] = {};
+
+    KUNIT_ASSERT_NOT_NULL(test, ctx);
+    KUNIT_EXPECT_EQ(test, privcam_crypt_setup(ctx, PRIVCAM_CRYPT_AES256_CTR, zero), -EACCES);
+    KUNIT_EXPECT_EQ(test, ctx->crypt_mode, PRIVCAM_CRYPT_OFF);
+    KUNIT_EXPECT_NULL(test, ctx->crypt_tfm);
+
+    if (privcam_test_crypt_ctx(test, ctx))
+        return;
+    tfm = ctx->crypt_tfm;
+    KUNIT_EXPECT_EQ(test, privcam_crypt_setup(ctx, PRIVCAM_CRYPT_AES256_CTR, zero), -EACCES);
+    KUNIT_EXPECT_EQ(test, ctx->crypt_mode, PRIVCAM_CRYPT_AES128_CTR);
+    KUNIT_EXPECT_PTR_EQ(test, ctx->crypt_tfm, tfm);
+}
+
+static struct kunit_case privcam_copy_cases[] = {
+    KUNIT_CASE(privcam_test_sg_to_linear),
+    KUNIT_CASE(privcam_test_sg_to_linear_rows),
+    KUNIT_CASE(privcam_test_y10p),
+    KUNIT_CASE(privcam_test_y10p_rows),
+    KUNIT_CASE(privcam_test_xform),
+    KUNIT_CASE(privcam_test_crypt),
+    KUNIT_CASE(privcam_test_crypt_key),
+    {}
+};
+
+static struct kunit_suite privcam_copy_suite = {
+    .name = "privcam-copy",
+    .test_cases = privcam_copy_cases,
+};
+
+/*
+ * Microbenchmarks: each variant moves a 1920x1080 YUYV frame (or its Y10P equivalent) into a
+ * vmalloc buffer like a CAPTURE plane, PRIVCAM_BENCH_ITERS times after a warm-up, and reports
+ * destination bytes per second. A 4 MB frame fits in many LLCs, so these are mostly warm-cache
+ * numbers; compare variants against each other and against the memcpy baseline.
+ */
+#define PRIVCAM_BENCH_ITERS 50
+
+struct privcam_bench {
+    struct kunit *test;
+    const char *name;
+    u64 start_ns;
+};
+
+static void privcam_bench_begin(struct privcam_bench *b, struct kunit *test, const char *name)
+{
+    b->test = test;
+    b->name = name;
+    b->start_ns = ktime_get_ns();
+}
+
+static void privcam_bench_end(struct privcam_bench *b, size_t bytes)
+{
+    u64 ns = ktime_get_ns() - b->start_ns;
+    /* bytes per ns is GB/s; keep two decimals */
+    u64 centi = div64_u64((u64)bytes * PRIVCAM_BENCH_ITERS * 100, max_t(u64, ns, 1));
+
+    kunit_info(b->test, "%-28s %4llu.%02llu GB/s", b->name, centi / 100, centi % 100);
+}
+
+static void privcam_bench_memcpy(struct kunit *test)
+{
+    u8 *src = privcam_test_vmalloc(test, PRIVCAM_TEST_FRAME);
+    u8 *dst = privcam_test_vmalloc(test, PRIVCAM_TEST_FRAME);
+    struct privcam_bench b;
+
+    memset(src, 1, PRIVCAM_TEST_FRAME);
+    memcpy(dst, src, PRIVCAM_TEST_FRAME);
+
+    privcam_bench_begin(&b, test, "memcpy (baseline)");
+    for (int i = 0; i < PRIVCAM_BENCH_ITERS; i++)
+        memcpy(dst, src, PRIVCAM_TEST_FRAME);
+    privcam_bench_end(&b, PRIVCAM_TEST_FRAME);
+}
+
+static void privcam_bench_sg(struct kunit *test)
+{
+    const u32 row_bytes = PRIVCAM_TEST_FRAME_W * 2, dst_bpl = ALIGN(row_bytes, 64) + 64;
+    u8 *dst = privcam_test_vmalloc(test, (size_t)dst_bpl * PRIVCAM_TEST_FRAME_H);
+    char name[40];
+
+    for (int layout = PRIVCAM_TEST_SMALL; layout <= PRIVCAM_TEST_HUGE; layout++) {
+        struct privcam_test_sg *t = privcam_test_sg_get(test, layout, PRIVCAM_TEST_FRAME);
+        struct privcam_bench b;
+
+        if (!t)
+            continue;
+
+        privcam_sg_to_linear(&t->sgt, 0, dst, PRIVCAM_TEST_FRAME, NULL);
+        snprintf(name, sizeof(name), "sg_to_linear/%s", privcam_test_layout_names[layout]);
+        privcam_bench_begin(&b, test, name);
+        for (int i = 0; i < PRIVCAM_BENCH_ITERS; i++)
+            privcam_sg_to_linear(&t->sgt, 0, dst, PRIVCAM_TEST_FRAME, NULL);
+        privcam_bench_end(&b, PRIVCAM_TEST_FRAME);
+
+        /* Same frame into padded CAPTURE rows */
+        snprintf(name, sizeof(name), "sg_to_linear_rows/%s", privcam_test_layout_names[layout]);
+        privcam_bench_begin(&b, test, name);
+        for (int i = 0; i < PRIVCAM_BENCH_ITERS; i++)
+            privcam_sg_to_linear_rows(&t->sgt, 0, row_bytes, dst, dst_bpl, row_bytes,
+                                      PRIVCAM_TEST_FRAME_H, NULL, NULL, NULL);
+        privcam_bench_end(&b, PRIVCAM_TEST_FRAME);
+
+        privcam_test_sg_put(test, t);
+    }
+}
+
+static void privcam_bench_y10p(struct kunit *test)
+{
+    const u32 src_rb = PRIVCAM_TEST_FRAME_W / 4 * 5, dst_rb = PRIVCAM_TEST_FRAME_W * 2;
+    struct privcam_test_sg *t = privcam_test_sg_get(test, PRIVCAM_TEST_HUGE, (size_t)src_rb * PRIVCAM_TEST_FRAME_H);
+    struct privcam_conv cv = { privcam_unpack_y10p, NULL, PRIVCAM_TEST_FRAME_W, dst_rb };
+    struct privcam_bench b;
+    u8 *dst;
+
+    if (!t)
+        return;
+    dst = privcam_test_vmalloc(test, (size_t)dst_rb * PRIVCAM_TEST_FRAME_H);
+    cv.row = kunit_kmalloc(test, src_rb, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, cv.row);
+
+    privcam_bench_begin(&b, test, "sg_to_linear_rows/unpack_y10p");
+    for (int i = 0; i < PRIVCAM_BENCH_ITERS; i++)
+        privcam_sg_to_linear_rows(&t->sgt, 0, src_rb, dst, dst_rb, src_rb, PRIVCAM_TEST_FRAME_H,
+                                  NULL, &cv, NULL);
+    privcam_bench_end(&b, (size_t)dst_rb * PRIVCAM_TEST_FRAME_H);
+}
+
+static void privcam_bench_xform(struct kunit *test)
+{
+    struct privcam_ctx *ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+    const u32 w = PRIVCAM_TEST_FRAME_W, h = PRIVCAM_TEST_FRAME_H;
+    u8 *src = privcam_test_vmalloc(test, PRIVCAM_TEST_FRAME);
+    u8 *dst = privcam_test_vmalloc(test, PRIVCAM_TEST_FRAME);
+    char name[40];
+
+    KUNIT_ASSERT_NOT_NULL(test, ctx);
+    memset(src, 0x80, PRIVCAM_TEST_FRAME);
+    ctx->cap_fmt.pixelformat = V4L2_PIX_FMT_YUYV;
+
+    for (u32 rot = 0; rot < 360; rot += 90) {
+        bool t = rot == 90 || rot == 270;
+        /* Rotation 0 with a vertical flip is the untransposed, row-memcpy case */
+        struct privcam_xform_cfg x = { .rotate = rot, .vflip = !rot };
+        struct privcam_bench b;
+
+        snprintf(name, sizeof(name), "xform_yuyv/rotate%u%s", rot, rot ? "" : "+vflip");
+        privcam_bench_begin(&b, test, name);
+        for (int i = 0; i < PRIVCAM_BENCH_ITERS; i++)
+            privcam_xform_plane(ctx, &x, 0, w, h, src, w * 2, dst, (t ? h : w) * 2, NULL, NULL);
+        privcam_bench_end(&b, PRIVCAM_TEST_FRAME);
+    }
+}
+
+static void privcam_bench_crypt(struct kunit *test)
+{
+    struct privcam_ctx *ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+    struct privcam_test_sg *t;
+    struct privcam_crypt_stream cs;
+    struct privcam_bench b;
+    u8 *dst;
+
+    KUNIT_ASSERT_NOT_NULL(test, ctx);
+    if (privcam_test_crypt_ctx(test, ctx))
+        return;
+    t = privcam_test_sg_get(test, PRIVCAM_TEST_HUGE, PRIVCAM_TEST_FRAME);
+    if (!t)
+        return;
+    dst = privcam_test_vmalloc(test, PRIVCAM_TEST_FRAME);
+
+    privcam_bench_begin(&b, test, "sg_to_linear/aes128-ctr");
+    for (int i = 0; i < PRIVCAM_BENCH_ITERS; i++) {
+        privcam_crypt_frame(ctx, &cs);
+        privcam_crypt_plane(&cs, 0);
+        privcam_sg_to_linear(&t->sgt, 0, dst, PRIVCAM_TEST_FRAME, &cs);
+    }
+    privcam_bench_end(&b, PRIVCAM_TEST_FRAME);
+}
+
+static struct kunit_case privcam_bench_cases[] = {
+    KUNIT_CASE(privcam_bench_memcpy),
+    KUNIT_CASE(privcam_bench_sg),
+    KUNIT_CASE(privcam_bench_y10p),
+    KUNIT_CASE(privcam_bench_xform),
+    KUNIT_CASE(privcam_bench_crypt),
+    {}
+};
+
+static struct kunit_suite privcam_bench_suite = {
+    .name = "privcam-copy-bench",
+    .test_cases = privcam_bench_cases,
+};
+
+kunit_test_suites(&privcam_copy_suite, &privcam_bench_suite);
@@ -1,4 +1,9 @@
-// Very minimal V4L2 driver: just registers /dev/videoX and does nothing.
+// Minimal V4L2 capture driver: registers /dev/videoX and streams test patterns.
+//
+// Frames are produced by a kthread paced with an absolute hrtimeout at the rate set through
+// S_PARM. Every pattern line is precomputed when streaming starts, so filling a frame is one
+// memcpy per row. Buffers are vmalloc backed and can be exported with VIDIOC_EXPBUF, which
+// lets privcam (or anything else) import them as DMABUF without a physical camera.
 
 #include <linux/module.h>
 #include <linux/kernel.h>
@@ -6,22 +11,55 @@
 #include <linux/slab.h>
 #include <linux/platform_device.h>
 #include <linux/mutex.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include <media/v4l2-dev.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-ioctl.h>
 #include <media/v4l2-fh.h>
 #include <media/v4l2-ctrls.h>
+#include <media/v4l2-event.h>
+#include <media/videobuf2-v4l2.h>
+#include <media/videobuf2-vmalloc.h>
+
+#include "../ratsv4l2_cam/privcam_link.h"
 
 #define MINIMAL_CID_OVERLAY_ENABLE (V4L2_CID_USER_BASE + 0x1000)
 
-#define MINI_V4L2_CAP_OPTIONS (V4L2_CAP_STREAMING | V4L2_CAP_VIDEO_M2M)
+#define MINI_V4L2_CAP_OPTIONS (V4L2_CAP_STREAMING | V4L2_CAP_VIDEO_CAPTURE)
 
 #define MIN_WIDTH 16
-#define MIN_HEIGHT 16 
+#define MIN_HEIGHT 16
+
+#define MAX_WIDTH 4096
+#define MAX_HEIGHT 2160
+
+#define MIN_FPS 1
+#define MAX_FPS 240
+#define DEF_FPS 30
 
-#define MAX_WIDTH 1920
-#define MAX_HEIGHT 1080
+#define OVERLAY_ROWS 16
+
+enum minimal_pattern {
+	PATTERN_BARS,
+	PATTERN_SCROLLING_BARS,
+};
+
+static const char * const pattern_menu[] = {
+	"Color Bars",
+	"Scrolling Color Bars",
+	NULL,
+};
+
+struct fmt {
+	u32 pixelformat;
+	const char *desc;
+	u8 bpp;
+};
 
 struct v4l2_minimal_dev {
 	struct v4l2_device v4l2_dev;
@@ -30,12 +68,37 @@ struct v4l2_minimal_dev {
 
 	struct v4l2_ctrl_handler ctrl_handler;
 	bool overlay_enable;
+	u32 pattern;
 
 	struct v4l2_pix_format pix_fmt;
+	const struct fmt *fmt;
+	struct v4l2_fract timeperframe;
+
+	struct vb2_queue queue;
+	spinlock_t slock;		/* protects buf_list */
+	struct list_head buf_list;
+
+	struct task_struct *thread;
+	u32 sequence;
+	u32 dropped;
+
+	/*
+	 * Pattern lines, built at stream on: two bar periods back to back so that any
+	 * horizontal scroll offset is one contiguous memcpy, then one overlay line.
+	 */
+	u8 *lines;
+	u8 *overlay_line;
+
+	/* Optional in-kernel link into privcam, resolved at stream on if privcam is loaded */
+	struct privcam_source link_src;
+	int (*link_push)(struct privcam_source *src, struct privcam_link_frame *frame);
+	void (*link_unregister)(struct privcam_source *src);
 };
 
-struct minimal_ctx {
-	struct v4l2_fh fh;
+struct minimal_buffer {
+	struct vb2_v4l2_buffer vb;
+	struct list_head list;
+	struct privcam_link_frame link;
 };
 
 // Rathinavel has arrived
@@ -43,12 +106,6 @@ struct minimal_ctx {
 static struct v4l2_minimal_dev *min_dev;
 static struct platform_device *min_pdev;
 
-struct fmt {
-	u32 pixelformat;
-	const char *desc;
-	u8 bpp;
-};
-
 static const struct fmt formats[] = {
 	{ V4L2_PIX_FMT_GREY, "8-bit Greyscale", 1 },
 	{ V4L2_PIX_FMT_YUYV, "YUYV 4:2:2", 2 },
@@ -57,42 +114,362 @@ static const struct fmt formats[] = {
 
 #define NUM_FORMATS ARRAY_SIZE(formats)
 
-static int minimal_open(struct file *file)
+/* 75% colour bars: white, yellow, cyan, green, magenta, red, blue, black */
+static const u8 bars_rgb[8][3] = {
+	{ 191, 191, 191 }, { 191, 191, 0 }, { 0, 191, 191 }, { 0, 191, 0 },
+	{ 191, 0, 191 }, { 191, 0, 0 }, { 0, 0, 191 }, { 0, 0, 0 },
+};
+
+static const struct fmt *find_format(u32 pixelformat)
+{
+	for (unsigned int i = 0; i < NUM_FORMATS; i++)
+		if (formats[i].pixelformat == pixelformat)
+			return &formats[i];
+	return NULL;
+}
+
+/* BT.601 limited range */
+static void rgb_to_yuv(const u8 *rgb, u8 *y, u8 *u, u8 *v)
+{
+	int r = rgb[0], g = rgb[1], b = rgb[2];
+
+	*y = clamp(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16, 0, 255);
+	*u = clamp(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128, 0, 255);
+	*v = clamp(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128, 0, 255);
+}
+
+/* Write pixels [x0, x0 + n) of a line in colour rgb; n is even for YUYV */
+static void put_pixels(const struct fmt *f, u8 *line, u32 x0, u32 n, const u8 *rgb)
 {
-	struct video_device *vdev = video_devdata(file);
-	struct v4l2_minimal_dev *dev = video_get_drvdata(vdev);
-	struct minimal_ctx *ctx;
+	u8 y, u, v;
+
+	rgb_to_yuv(rgb, &y, &u, &v);
+
+	for (u32 x = x0; x < x0 + n; x++) {
+		switch (f->pixelformat) {
+		case V4L2_PIX_FMT_GREY:
+			line[x] = y;
+			break;
+		case V4L2_PIX_FMT_YUYV:
+			line[x * 2] = y;
+			line[x * 2 + 1] = (x & 1) ? v : u;
+			break;
+		case V4L2_PIX_FMT_RGB24:
+			memcpy(&line[x * 3], rgb, 3);
+			break;
+		}
+	}
+}
 
-	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
-	if(!ctx)
+static int minimal_build_lines(struct v4l2_minimal_dev *dev)
+{
+	const struct fmt *f = dev->fmt;
+	u32 w = dev->pix_fmt.width;
+	u32 bar_w = max_t(u32, (w / 8) & ~1U, 2);
+	/* Full-range RGB; rgb_to_yuv maps it to limited-range Y = 235 */
+	static const u8 white[3] = { 255, 255, 255 };
+
+	dev->lines = kvmalloc(3 * w * f->bpp, GFP_KERNEL);
+	if (!dev->lines)
 		return -ENOMEM;
 
-	v4l2_fh_init(&ctx->fh, vdev);
-	v4l2_fh_add(&ctx->fh);
+	for (u32 x = 0; x < 2 * w; x += 2) {
+		u32 bar = ((x % w) / bar_w) & 7;
 
-	file->private_data = &ctx->fh;
+		put_pixels(f, dev->lines, x, 2, bars_rgb[bar]);
+	}
 
-	pr_info("minimal_open\n");
+	dev->overlay_line = dev->lines + 2 * w * f->bpp;
+	put_pixels(f, dev->overlay_line, 0, w, white);
 	return 0;
 }
 
-static int minimal_release(struct file *file)
+static void minimal_free_lines(struct v4l2_minimal_dev *dev)
+{
+	kvfree(dev->lines);
+	dev->lines = NULL;
+	dev->overlay_line = NULL;
+}
+
+static void minimal_fill_frame(struct v4l2_minimal_dev *dev, u8 *vaddr, u32 frame)
 {
-	struct v4l2_fh *fh = file->private_data;
-	struct minimal_ctx *ctx = container_of(fh, struct minimal_ctx, fh);
+	const struct v4l2_pix_format *pix = &dev->pix_fmt;
+	u32 row_bytes = pix->width * dev->fmt->bpp;
+	u32 scroll = 0, band = pix->height;
+	const u8 *src;
 
-	pr_info("minimal_release\n");
+	if (dev->pattern == PATTERN_SCROLLING_BARS)
+		scroll = ((frame * 4) % pix->width) & ~1U;
+	if (dev->overlay_enable)
+		band = (frame * 2) % pix->height;
+
+	src = dev->lines + scroll * dev->fmt->bpp;
+
+	for (u32 row = 0; row < pix->height; row++) {
+		bool in_band = row >= band && row < band + OVERLAY_ROWS;
+
+		memcpy(vaddr + row * pix->bytesperline, in_band ? dev->overlay_line : src, row_bytes);
+	}
+}
+
+/* privcam is done copying: recycle the buffer without a round trip through userspace */
+static void minimal_link_release(struct privcam_link_frame *frame)
+{
+	struct minimal_buffer *buf = container_of(frame, struct minimal_buffer, link);
+	struct v4l2_minimal_dev *dev = vb2_get_drv_priv(buf->vb.vb2_buf.vb2_queue);
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->slock, flags);
+	list_add_tail(&buf->list, &dev->buf_list);
+	spin_unlock_irqrestore(&dev->slock, flags);
+}
+
+/* Complete the oldest queued buffer with the next frame, or count a drop */
+static void minimal_produce(struct v4l2_minimal_dev *dev)
+{
+	struct minimal_buffer *buf;
+	unsigned long flags;
+	void *vaddr;
+
+	spin_lock_irqsave(&dev->slock, flags);
+	buf = list_first_entry_or_null(&dev->buf_list, struct minimal_buffer, list);
+	if (buf)
+		list_del(&buf->list);
+	spin_unlock_irqrestore(&dev->slock, flags);
+
+	if (!buf) {
+		dev->dropped++;
+		dev->sequence++;
+		return;
+	}
+
+	vaddr = vb2_plane_vaddr(&buf->vb.vb2_buf, 0);
+	if (!vaddr) {
+		vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
+		return;
+	}
+
+	minimal_fill_frame(dev, vaddr, dev->sequence);
+
+	vb2_set_plane_payload(&buf->vb.vb2_buf, 0, dev->pix_fmt.sizeimage);
+	buf->vb.field = V4L2_FIELD_NONE;
+	buf->vb.sequence = dev->sequence++;
+	buf->vb.vb2_buf.timestamp = ktime_get_ns();
+
+	/* Linked to a privcam context: hand the frame over, it comes back via minimal_link_release */
+	if (dev->link_push) {
+		buf->link.vaddr = vaddr;
+		buf->link.release = minimal_link_release;
+		buf->link.bytesused = dev->pix_fmt.sizeimage;
+		buf->link.bytesperline = dev->pix_fmt.bytesperline;
+		buf->link.timestamp = buf->vb.vb2_buf.timestamp;
+		buf->link.sequence = buf->vb.sequence;
+		if (!dev->link_push(&dev->link_src, &buf->link))
+			return;
+	}
+
+	vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
+}
+
+static void minimal_link_start(struct v4l2_minimal_dev *dev)
+{
+	int (*reg)(struct privcam_source *src) = symbol_get(privcam_link_register);
+
+	if (!reg)
+		return;
+
+	dev->link_push = symbol_get(privcam_link_push);
+	dev->link_unregister = symbol_get(privcam_link_unregister);
+	dev->link_src.video_nr = dev->vdev.num;
+	if (!dev->link_push || !dev->link_unregister || reg(&dev->link_src)) {
+		/* Not registered: never push to privcam, and let it unload */
+		if (dev->link_push)
+			symbol_put(privcam_link_push);
+		if (dev->link_unregister)
+			symbol_put(privcam_link_unregister);
+		dev->link_push = NULL;
+		dev->link_unregister = NULL;
+	}
+	symbol_put(privcam_link_register);
+}
+
+/* Returns once privcam has released every frame it was handed */
+static void minimal_link_stop(struct v4l2_minimal_dev *dev)
+{
+	if (!dev->link_push)
+		return;
+
+	dev->link_unregister(&dev->link_src);
+	symbol_put(privcam_link_push);
+	symbol_put(privcam_link_unregister);
+	dev->link_push = NULL;
+	dev->link_unregister = NULL;
+}
+
+static int minimal_thread(void *data)
+{
+	struct v4l2_minimal_dev *dev = data;
+	u64 period = div_u64((u64)NSEC_PER_SEC * dev->timeperframe.numerator,
+			     dev->timeperframe.denominator);
+	ktime_t next = ktime_get();
+
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		minimal_produce(dev);
+
+		next = ktime_add_ns(next, period);
+		/* Fell more than a frame behind: resync instead of bursting */
+		if (ktime_before(ktime_add_ns(next, period), ktime_get()))
+			next = ktime_get();
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule_hrtimeout_range(&next, 50 * NSEC_PER_USEC, HRTIMER_MODE_ABS);
+		__set_current_state(TASK_RUNNING);
+		try_to_freeze();
+	}
+
+	return 0;
+}
+
+static int minimal_queue_setup(struct vb2_queue *vq,
+			       unsigned int *nbufs,
+			       unsigned int *nplanes,
+			       unsigned int sizes[],
+			       struct device *alloc_devs[])
+{
+	struct v4l2_minimal_dev *dev = vb2_get_drv_priv(vq);
+
+	if (*nplanes)
+		return sizes[0] < dev->pix_fmt.sizeimage ? -EINVAL : 0;
+
+	*nplanes = 1;
+	sizes[0] = dev->pix_fmt.sizeimage;
+
+	if (*nbufs < 2)
+		*nbufs = 2;
+
+	return 0;
+}
+
+static int minimal_buf_prepare(struct vb2_buffer *vb)
+{
+	struct v4l2_minimal_dev *dev = vb2_get_drv_priv(vb->vb2_queue);
+
+	if (vb2_plane_size(vb, 0) < dev->pix_fmt.sizeimage)
+		return -EINVAL;
 
-	v4l2_fh_del(fh);
-	v4l2_fh_exit(fh);
-	kfree(ctx);
+	vb2_set_plane_payload(vb, 0, dev->pix_fmt.sizeimage);
+	return 0;
+}
+
+static void minimal_buf_queue(struct vb2_buffer *vb)
+{
+	struct v4l2_minimal_dev *dev = vb2_get_drv_priv(vb->vb2_queue);
+	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(vb);
+	struct minimal_buffer *buf = container_of(vbuf, struct minimal_buffer, vb);
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->slock, flags);
+	list_add_tail(&buf->list, &dev->buf_list);
+	spin_unlock_irqrestore(&dev->slock, flags);
+}
 
+static void minimal_return_buffers(struct v4l2_minimal_dev *dev, enum vb2_buffer_state state)
+{
+	struct minimal_buffer *buf, *tmp;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->slock, flags);
+	list_for_each_entry_safe(buf, tmp, &dev->buf_list, list) {
+		list_del(&buf->list);
+		vb2_buffer_done(&buf->vb.vb2_buf, state);
+	}
+	spin_unlock_irqrestore(&dev->slock, flags);
+}
+
+static int minimal_start_streaming(struct vb2_queue *vq, unsigned int count)
+{
+	struct v4l2_minimal_dev *dev = vb2_get_drv_priv(vq);
+	int ret;
+
+	ret = minimal_build_lines(dev);
+	if (ret)
+		goto err;
+
+	dev->sequence = 0;
+	dev->dropped = 0;
+
+	minimal_link_start(dev);
+
+	dev->thread = kthread_run(minimal_thread, dev, "v4l2-minimal");
+	if (IS_ERR(dev->thread)) {
+		ret = PTR_ERR(dev->thread);
+		dev->thread = NULL;
+		minimal_link_stop(dev);
+		minimal_free_lines(dev);
+		goto err;
+	}
+
+	pr_info("v4l2_minimal: streaming %ux%u %.4s at %u/%u s\n",
+		dev->pix_fmt.width, dev->pix_fmt.height, (char *)&dev->pix_fmt.pixelformat,
+		dev->timeperframe.numerator, dev->timeperframe.denominator);
 	return 0;
+
+err:
+	minimal_return_buffers(dev, VB2_BUF_STATE_QUEUED);
+	return ret;
+}
+
+static void minimal_stop_streaming(struct vb2_queue *vq)
+{
+	struct v4l2_minimal_dev *dev = vb2_get_drv_priv(vq);
+
+	if (dev->thread) {
+		kthread_stop(dev->thread);
+		dev->thread = NULL;
+	}
+
+	minimal_link_stop(dev);
+	minimal_return_buffers(dev, VB2_BUF_STATE_ERROR);
+	minimal_free_lines(dev);
+
+	pr_info("v4l2_minimal: stopped after %u frames, %u dropped\n", dev->sequence, dev->dropped);
+}
+
+static const struct vb2_ops minimal_vb2_ops = {
+	.queue_setup = minimal_queue_setup,
+	.buf_prepare = minimal_buf_prepare,
+	.buf_queue = minimal_buf_queue,
+	.start_streaming = minimal_start_streaming,
+	.stop_streaming = minimal_stop_streaming,
+	.wait_prepare = vb2_ops_wait_prepare,
+	.wait_finish = vb2_ops_wait_finish,
+};
+
+static int minimal_open(struct file *file)
+{
+	int ret;
+
+	ret = v4l2_fh_open(file);
+	if (ret)
+		return ret;
+
+	pr_info("minimal_open\n");
+	return 0;
+}
+
+static int minimal_release(struct file *file)
+{
+	pr_info("minimal_release\n");
+
+	return vb2_fop_release(file);
 }
 
 static int minimal_s_ctrl(struct v4l2_ctrl *ctrl)
 {
-	struct v4l2_minimal_dev *vdev = 
+	struct v4l2_minimal_dev *vdev =
 		container_of(ctrl->handler, struct v4l2_minimal_dev, ctrl_handler);
 
 	switch(ctrl->id)
@@ -101,6 +478,9 @@ static int minimal_s_ctrl(struct v4l2_ctrl *ctrl)
 			vdev->overlay_enable = ctrl->val;
 			pr_info("v4l2-minimal: overlay_enable: %d\n", vdev->overlay_enable);
 			return 0;
+		case V4L2_CID_TEST_PATTERN:
+			vdev->pattern = ctrl->val;
+			return 0;
 	}
 
 	return -EINVAL;
@@ -110,11 +490,12 @@ static const struct v4l2_ctrl_ops minimal_ctrl_ops = {
 	.s_ctrl = minimal_s_ctrl,
 };
 
-/* No real functionality yet */
 static const struct v4l2_file_operations minimal_fops = {
 	.owner = THIS_MODULE,
 	.open = minimal_open,
 	.release = minimal_release,
+	.poll = vb2_fop_poll,
+	.mmap = vb2_fop_mmap,
 	.unlocked_ioctl = video_ioctl2,
 };
 
@@ -137,15 +518,15 @@ static int vidioc_enum_fmt(struct file *file, void *priv,
 					    struct v4l2_fmtdesc *f)
 {
 
-	pr_alert("Capture enum_fmt: type=%u index=%u\n", f->type, f->index);
+	pr_debug("Capture enum_fmt: type=%u index=%u\n", f->type, f->index);
 
-	if (f->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || f->type != V4L2_BUF_TYPE_VIDEO_OUTPUT) {
+	if (f->type != V4L2_BUF_TYPE_VIDEO_CAPTURE && f->type != V4L2_BUF_TYPE_VIDEO_OUTPUT) {
 		pr_info("enum_fmt: bad type\n");
 		return -EINVAL;
 	}
 
 	if (f->index >= NUM_FORMATS) {
-		pr_info("enum_fmt: index too big\n");
+		pr_debug("enum_fmt: index too big\n");
 		return -EINVAL;
 	}
 
@@ -155,12 +536,563 @@ static int vidioc_enum_fmt(struct file *file, void *priv,
 	return 0;
 }
 
+static int vidioc_g_fmt(struct file *file, void *priv, struct v4l2_format *f)
+{
+	struct v4l2_minimal_dev *dev = video_drvdata(file);
+
+	f->fmt.pix = dev->pix_fmt;
+	return 0;
+}
+
+static int vidioc_try_fmt(struct file *file, void *priv, struct v4l2_format *f)
+{
+	struct v4l2_pix_format *pix = &f->fmt.pix;
+	const struct fmt *fmt = find_format(pix->pixelformat);
+
+	if (!fmt) {
+		fmt = &formats[1];
+		pix->pixelformat = fmt->pixelformat;
+	}
+
+	pix->width = clamp_t(u32, pix->width, MIN_WIDTH, MAX_WIDTH) & ~1U;
+	pix->height = clamp_t(u32, pix->height, MIN_HEIGHT, MAX_HEIGHT);
+	pix->field = V4L2_FIELD_NONE;
+	pix->colorspace = fmt->pixelformat == V4L2_PIX_FMT_RGB24 ?
+			  V4L2_COLORSPACE_SRGB : V4L2_COLORSPACE_SMPTE170M;
+	pix->bytesperline = pix->width * fmt->bpp;
+	pix->sizeimage = pix->bytesperline * pix->height;
+	pix->priv = 0;
+
+	return 0;
+}
+
+static int vidioc_s_fmt(struct file *file, void *priv, struct v4l2_format *f)
+{
+	struct v4l2_minimal_dev *dev = video_drvdata(file);
+	int ret;
+
+	if (vb2_is_busy(&dev->queue))
+		return -EBUSY;
+
+	ret = vidioc_try_fmt(file, priv, f);
+	if (ret)
+		return ret;
+
+	dev->pix_fmt = f->fmt.pix;
+	dev->fmt = find_format(dev->pix_fmt.pixelformat);
+	return 0;
+}
+
+static int vidioc_enum_framesizes(struct file *file, void *priv, struct v4l2_frmsizeenum *fsize)
+{
+	if (fsize->index || !find_format(fsize->pixel_format))
+		return -EINVAL;
+
+	fsize->type = V4L2_FRMSIZE_TYPE_STEPWISE;
+	fsize->stepwise.min_width = MIN_WIDTH;
+	fsize->stepwise.max_width = MAX_WIDTH;
+	fsize->stepwise.step_width = 2;
+	fsize->stepwise.min_height = MIN_HEIGHT;
+	fsize->stepwise.max_height = MAX_HEIGHT;
+	fsize->stepwise.step_height = 1;
+	return 0;
+}
+
+static int vidioc_enum_frameintervals(struct file *file, void *priv, struct v4l2_frmivalenum *fival)
+{
+	if (fival->index || !find_format(fival->pixel_format))
+		return -EINVAL;
+	if (fival->width < MIN_WIDTH || fival->width > MAX_WIDTH ||
+	    fival->height < MIN_HEIGHT || fival->height > MAX_HEIGHT)
+		return -EINVAL;
+
+	fival->type = V4L2_FRMIVAL_TYPE_CONTINUOUS;
+	fival->stepwise.min = (struct v4l2_fract){ 1, MAX_FPS };
+	fival->stepwise.max = (struct v4l2_fract){ 1, MIN_FPS };
+	fival->stepwise.step = (struct v4l2_fract){ 1, 1 };
+	return 0;
+}
+
+static int vidioc_g_parm(struct file *file, void *priv, struct v4l2_streamparm *parm)
+{
+	struct v4l2_minimal_dev *dev = video_drvdata(file);
+
+	if (parm->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+		return -EINVAL;
+
+	parm->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+	parm->parm.capture.timeperframe = dev->timeperframe;
+	parm->parm.capture.readbuffers = 2;
+	return 0;
+}
+
+static int vidioc_s_parm(struct file *file, void *priv, struct v4l2_streamparm *parm)
+{
+	struct v4l2_minimal_dev *dev = video_drvdata(file);
+	struct v4l2_fract *tpf = &parm->parm.capture.timeperframe;
+	u64 fps_x1000;
+
+	if (parm->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+		return -EINVAL;
+	/* The producer thread reads the period once at stream on */
+	if (vb2_is_streaming(&dev->queue))
+		return -EBUSY;
+
+	if (!tpf->numerator || !tpf->denominator) {
+		*tpf = (struct v4l2_fract){ 1, DEF_FPS };
+	} else {
+		fps_x1000 = div_u64((u64)tpf->denominator * 1000, tpf->numerator);
+		if (fps_x1000 < MIN_FPS * 1000)
+			*tpf = (struct v4l2_fract){ 1, MIN_FPS };
+		else if (fps_x1000 > MAX_FPS * 1000)
+			*tpf = (struct v4l2_fract){ 1, MAX_FPS };
+	}
+
+	dev->timeperframe = *tpf;
+	return vidioc_g_parm(file, priv, parm);
+}
+
+static int vidioc_enum_input(struct file *file, void *priv, struct v4l2_input *inp)
+{
+	if (inp->index)
+		return -EINVAL;
+
+	inp->type = V4L2_INPUT_TYPE_CAMERA;
+	strscpy(inp->name, "Test Pattern", sizeof(inp->name));
+	return 0;
+}
+
+static int vidioc_g_input(struct file *file, void *priv, unsigned int *i)
+{
+	*i = 0;
+	return 0;
+}
+
+static int vidioc_s_input(struct file *file, void *priv, unsigned int i)
+{
+	return i ? -EINVAL : 0;
+}
+
 static const struct v4l2_ioctl_ops minimal_ioctl_ops = {
 	.vidioc_querycap = minimal_vidioc_querycap,
 	.vidioc_enum_fmt_vid_cap = vidioc_enum_fmt,
+	.vidioc_g_fmt_vid_cap = vidioc_g_fmt,
+	.vidioc_try_fmt_vid_cap = vidioc_try_fmt,
+	.vidioc_s_fmt_vid_cap = vidioc_s_fmt,
+
+	.vidioc_enum_framesizes = vidioc_enum_framesizes,
+	.vidioc_enum_frameintervals = vidioc_enum_frameintervals,
+	.vidioc_g_parm = vidioc_g_parm,
+	.vidioc_s_parm = vidioc_s_parm,
+
+	.vidioc_enum_input = vidioc_enum_input,
+	.vidioc_g_input = vidioc_g_input,
+	.vidioc_s_input = vidioc_s_input,
+
+	.vidioc_reqbufs = vb2_ioctl_reqbufs,
+	.vidioc_create_bufs = vb2_ioctl_create_bufs,
+	.vidioc_prepare_buf = vb2_ioctl_prepare_buf,
+	.vidioc_querybuf = vb2_ioctl_querybuf,
+	.vidioc_qbuf = vb2_ioctl_qbuf,
+	.vidioc_dqbuf = vb2_ioctl_dqbuf,
+	.vidioc_expbuf = vb2_ioctl_expbuf,
+	.vidioc_streamon = vb2_ioctl_streamon,
+	.vidioc_streamoff = vb2_ioctl_streamoff,
+
+	.vidioc_subscribe_event = v4l2_ctrl_subscribe_event,
+	.vidioc_unsubscribe_event = v4l2_event_unsubscribe,
+};
+
+static int minimal_queue_init(struct v4l2_minimal_dev *dev)
+{
+	struct vb2_queue *q = &dev->queue;
+
+	q->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	q->io_modes = VB2_MMAP | VB2_DMABUF;
+	q->drv_priv = dev;
+	q->buf_struct_size = sizeof(struct minimal_buffer);
+	q->ops = &minimal_vb2_ops;
+	/* vmalloc buffers export as dma-bufs (VIDIOC_EXPBUF) */
+	q->mem_ops = &vb2_vmalloc_memops;
+	q->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+	q->lock = &dev->lock;
+	q->dev = &min_pdev->dev;
+
+	return vb2_queue_init(q);
+}
+
+/*
+ * Null sink: an OUTPUT-only node (registered with null_sink=1) that takes MMAP, USERPTR or
+ * DMABUF buffers, optionally touches or checksums them, and completes them straight from QBUF.
+ * It has no worker and no copy, so its cost per buffer is the floor for V4L2 queueing and
+ * syscall overhead that privcam's device_run and any userspace producer can be measured against.
+ */
+
+static bool null_sink;
+module_param(null_sink, bool, 0444);
+MODULE_PARM_DESC(null_sink, "Also register an OUTPUT-only null sink node");
+
+#define MINIMAL_CID_SINK_MODE		(V4L2_CID_USER_BASE + 0x1001)
+#define MINIMAL_CID_SINK_BUFFERS	(V4L2_CID_USER_BASE + 0x1002)
+#define MINIMAL_CID_SINK_BYTES		(V4L2_CID_USER_BASE + 0x1003)
+#define MINIMAL_CID_SINK_BUSY_NS	(V4L2_CID_USER_BASE + 0x1004)
+#define MINIMAL_CID_SINK_CHECKSUM	(V4L2_CID_USER_BASE + 0x1005)
+
+#define MINI_V4L2_SINK_CAP_OPTIONS (V4L2_CAP_STREAMING | V4L2_CAP_VIDEO_OUTPUT)
+
+enum minimal_sink_mode {
+	SINK_DROP,		/* return the buffer untouched */
+	SINK_TOUCH,		/* read one byte per page */
+	SINK_CHECKSUM,		/* sum every 64-bit word */
+};
+
+static const char * const sink_mode_menu[] = {
+	"Drop",
+	"Touch Pages",
+	"Checksum",
+	NULL,
+};
+
+struct minimal_sink {
+	struct video_device vdev;
+	struct mutex lock;
+	struct v4l2_ctrl_handler ctrl_handler;
+	struct vb2_queue queue;
+
+	struct v4l2_pix_format pix_fmt;
+	u32 mode;
+
+	/* Counters for the current streaming run, read back through the volatile controls */
+	u64 buffers;
+	u64 bytes;
+	u64 busy_ns;
+	u64 checksum;		/* of the most recent buffer */
+};
+
+static struct minimal_sink *min_sink;
+
+static u64 minimal_sink_process(u32 mode, const u8 *vaddr, size_t len)
+{
+	const u64 *w = (const u64 *)vaddr;
+	u64 sum = 0;
+	size_t i;
+
+	switch (mode) {
+	case SINK_TOUCH:
+		for (i = 0; i < len; i += PAGE_SIZE)
+			sum += READ_ONCE(vaddr[i]);
+		break;
+	case SINK_CHECKSUM:
+		for (i = 0; i < len / 8; i++)
+			sum += w[i];
+		for (i = len & ~(size_t)7; i < len; i++)
+			sum += vaddr[i];
+		break;
+	}
+
+	return sum;
+}
+
+static int minimal_sink_queue_setup(struct vb2_queue *vq,
+				    unsigned int *nbufs,
+				    unsigned int *nplanes,
+				    unsigned int sizes[],
+				    struct device *alloc_devs[])
+{
+	struct minimal_sink *sink = vb2_get_drv_priv(vq);
+
+	if (*nplanes)
+		return sizes[0] < sink->pix_fmt.sizeimage ? -EINVAL : 0;
+
+	*nplanes = 1;
+	sizes[0] = sink->pix_fmt.sizeimage;
+	return 0;
+}
+
+static int minimal_sink_buf_prepare(struct vb2_buffer *vb)
+{
+	struct minimal_sink *sink = vb2_get_drv_priv(vb->vb2_queue);
+
+	if (vb2_plane_size(vb, 0) < sink->pix_fmt.sizeimage)
+		return -EINVAL;
+	if (vb2_get_plane_payload(vb, 0) > vb2_plane_size(vb, 0))
+		return -EINVAL;
+
+	return 0;
+}
+
+/* QBUF lands here once streaming; the buffer is consumed and completed in the caller's context */
+static void minimal_sink_buf_queue(struct vb2_buffer *vb)
+{
+	struct minimal_sink *sink = vb2_get_drv_priv(vb->vb2_queue);
+	size_t len = vb2_get_plane_payload(vb, 0);
+	u64 t0 = ktime_get_ns();
+	void *vaddr;
+
+	if (sink->mode != SINK_DROP) {
+		vaddr = vb2_plane_vaddr(vb, 0);
+		if (!vaddr) {
+			vb2_buffer_done(vb, VB2_BUF_STATE_ERROR);
+			return;
+		}
+		WRITE_ONCE(sink->checksum, minimal_sink_process(sink->mode, vaddr, len));
+	}
+
+	WRITE_ONCE(sink->busy_ns, sink->busy_ns + ktime_get_ns() - t0);
+	WRITE_ONCE(sink->bytes, sink->bytes + len);
+	WRITE_ONCE(sink->buffers, sink->buffers + 1);
+
+	vb2_buffer_done(vb, VB2_BUF_STATE_DONE);
+}
+
+static int minimal_sink_start_streaming(struct vb2_queue *vq, unsigned int count)
+{
+	return 0;
+}
+
+static void minimal_sink_stop_streaming(struct vb2_queue *vq)
+{
+	struct minimal_sink *sink = vb2_get_drv_priv(vq);
+
+	/* Every buffer is completed from buf_queue, so nothing is left to return */
+	pr_info("v4l2_minimal sink: %llu buffers, %llu bytes, %llu ns/buffer\n",
+		sink->buffers, sink->bytes,
+		sink->buffers ? div64_u64(sink->busy_ns, sink->buffers) : 0);
+
+	/*
+	 * Reset here rather than at start: vb2 hands the pre-queued buffers to buf_queue
+	 * before start_streaming is called, and those must count towards the next run.
+	 */
+	WRITE_ONCE(sink->buffers, 0);
+	WRITE_ONCE(sink->bytes, 0);
+	WRITE_ONCE(sink->busy_ns, 0);
+	WRITE_ONCE(sink->checksum, 0);
+}
+
+static const struct vb2_ops minimal_sink_vb2_ops = {
+	.queue_setup = minimal_sink_queue_setup,
+	.buf_prepare = minimal_sink_buf_prepare,
+	.buf_queue = minimal_sink_buf_queue,
+	.start_streaming = minimal_sink_start_streaming,
+	.stop_streaming = minimal_sink_stop_streaming,
+	.wait_prepare = vb2_ops_wait_prepare,
+	.wait_finish = vb2_ops_wait_finish,
+};
+
+static int minimal_sink_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct minimal_sink *sink =
+		container_of(ctrl->handler, struct minimal_sink, ctrl_handler);
+
+	switch (ctrl->id) {
+	case MINIMAL_CID_SINK_MODE:
+		sink->mode = ctrl->val;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+static int minimal_sink_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct minimal_sink *sink =
+		container_of(ctrl->handler, struct minimal_sink, ctrl_handler);
+
+	switch (ctrl->id) {
+	case MINIMAL_CID_SINK_BUFFERS:
+		*ctrl->p_new.p_s64 = READ_ONCE(sink->buffers);
+		return 0;
+	case MINIMAL_CID_SINK_BYTES:
+		*ctrl->p_new.p_s64 = READ_ONCE(sink->bytes);
+		return 0;
+	case MINIMAL_CID_SINK_BUSY_NS:
+		*ctrl->p_new.p_s64 = READ_ONCE(sink->busy_ns);
+		return 0;
+	case MINIMAL_CID_SINK_CHECKSUM:
+		*ctrl->p_new.p_s64 = READ_ONCE(sink->checksum);
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+static const struct v4l2_ctrl_ops minimal_sink_ctrl_ops = {
+	.s_ctrl = minimal_sink_s_ctrl,
+	.g_volatile_ctrl = minimal_sink_g_volatile_ctrl,
+};
+
+static const struct v4l2_ctrl_config minimal_sink_counter = {
+	.ops = &minimal_sink_ctrl_ops,
+	.type = V4L2_CTRL_TYPE_INTEGER64,
+	.flags = V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_VOLATILE,
+	.min = S64_MIN, .max = S64_MAX, .step = 1,
+};
+
+static void minimal_sink_add_counter(struct minimal_sink *sink, u32 id, const char *name)
+{
+	struct v4l2_ctrl_config cfg = minimal_sink_counter;
+
+	cfg.id = id;
+	cfg.name = name;
+	v4l2_ctrl_new_custom(&sink->ctrl_handler, &cfg, NULL);
+}
+
+static int minimal_sink_querycap(struct file *file, void *priv,
+				 struct v4l2_capability *cap)
+{
+	strscpy(cap->driver, "v4l2_minimal", sizeof(cap->driver));
+	strscpy(cap->card, "v4l2-minimal-sink", sizeof(cap->card));
+	strscpy(cap->bus_info, "platform:v4l2-minimal", sizeof(cap->bus_info));
+	return 0;
+}
+
+static int minimal_sink_g_fmt(struct file *file, void *priv, struct v4l2_format *f)
+{
+	struct minimal_sink *sink = video_drvdata(file);
+
+	f->fmt.pix = sink->pix_fmt;
+	return 0;
+}
+
+static int minimal_sink_s_fmt(struct file *file, void *priv, struct v4l2_format *f)
+{
+	struct minimal_sink *sink = video_drvdata(file);
+	int ret;
+
+	if (vb2_is_busy(&sink->queue))
+		return -EBUSY;
+
+	ret = vidioc_try_fmt(file, priv, f);
+	if (ret)
+		return ret;
+
+	sink->pix_fmt = f->fmt.pix;
+	return 0;
+}
+
+static const struct v4l2_ioctl_ops minimal_sink_ioctl_ops = {
+	.vidioc_querycap = minimal_sink_querycap,
 	.vidioc_enum_fmt_vid_out = vidioc_enum_fmt,
+	.vidioc_g_fmt_vid_out = minimal_sink_g_fmt,
+	.vidioc_try_fmt_vid_out = vidioc_try_fmt,
+	.vidioc_s_fmt_vid_out = minimal_sink_s_fmt,
+
+	.vidioc_reqbufs = vb2_ioctl_reqbufs,
+	.vidioc_create_bufs = vb2_ioctl_create_bufs,
+	.vidioc_prepare_buf = vb2_ioctl_prepare_buf,
+	.vidioc_querybuf = vb2_ioctl_querybuf,
+	.vidioc_qbuf = vb2_ioctl_qbuf,
+	.vidioc_dqbuf = vb2_ioctl_dqbuf,
+	.vidioc_expbuf = vb2_ioctl_expbuf,
+	.vidioc_streamon = vb2_ioctl_streamon,
+	.vidioc_streamoff = vb2_ioctl_streamoff,
+
+	.vidioc_subscribe_event = v4l2_ctrl_subscribe_event,
+	.vidioc_unsubscribe_event = v4l2_event_unsubscribe,
+};
+
+static const struct v4l2_file_operations minimal_sink_fops = {
+	.owner = THIS_MODULE,
+	.open = v4l2_fh_open,
+	.release = vb2_fop_release,
+	.poll = vb2_fop_poll,
+	.mmap = vb2_fop_mmap,
+	.unlocked_ioctl = video_ioctl2,
 };
 
+static int minimal_sink_register(struct v4l2_minimal_dev *dev)
+{
+	struct minimal_sink *sink;
+	struct video_device *vdev;
+	struct vb2_queue *q;
+	int ret;
+
+	sink = kzalloc(sizeof(*sink), GFP_KERNEL);
+	if (!sink)
+		return -ENOMEM;
+
+	mutex_init(&sink->lock);
+	sink->pix_fmt = dev->pix_fmt;
+
+	v4l2_ctrl_handler_init(&sink->ctrl_handler, 5);
+	v4l2_ctrl_new_custom(&sink->ctrl_handler, &(struct v4l2_ctrl_config)
+			{
+			 .ops = &minimal_sink_ctrl_ops,
+			 .id = MINIMAL_CID_SINK_MODE,
+			 .name = "Sink Mode",
+			 .type = V4L2_CTRL_TYPE_MENU,
+			 .max = SINK_CHECKSUM,
+			 .def = SINK_DROP,
+			 .qmenu = sink_mode_menu,
+			}, NULL);
+	minimal_sink_add_counter(sink, MINIMAL_CID_SINK_BUFFERS, "Sink Buffers");
+	minimal_sink_add_counter(sink, MINIMAL_CID_SINK_BYTES, "Sink Bytes");
+	minimal_sink_add_counter(sink, MINIMAL_CID_SINK_BUSY_NS, "Sink Busy ns");
+	minimal_sink_add_counter(sink, MINIMAL_CID_SINK_CHECKSUM, "Sink Last Checksum");
+
+	if (sink->ctrl_handler.error) {
+		ret = sink->ctrl_handler.error;
+		pr_err("v4l2_minimal sink: ctrl_handler_error: %d\n", ret);
+		goto err_free;
+	}
+
+	q = &sink->queue;
+	q->type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	q->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
+	q->drv_priv = sink;
+	q->buf_struct_size = sizeof(struct vb2_v4l2_buffer);
+	q->ops = &minimal_sink_vb2_ops;
+	q->mem_ops = &vb2_vmalloc_memops;
+	q->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
+	q->lock = &sink->lock;
+	q->dev = &min_pdev->dev;
+
+	ret = vb2_queue_init(q);
+	if (ret) {
+		pr_err("v4l2_minimal sink: vb2_queue_init failed: %d\n", ret);
+		goto err_free;
+	}
+
+	vdev = &sink->vdev;
+	strscpy(vdev->name, "v4l2-minimal-sink", sizeof(vdev->name));
+	vdev->v4l2_dev   = &dev->v4l2_dev;
+	vdev->fops       = &minimal_sink_fops;
+	vdev->ioctl_ops  = &minimal_sink_ioctl_ops;
+	vdev->release    = video_device_release_empty;
+	vdev->lock       = &sink->lock;
+	vdev->queue      = q;
+	vdev->device_caps = MINI_V4L2_SINK_CAP_OPTIONS;
+	vdev->vfl_dir    = VFL_DIR_TX;
+	vdev->ctrl_handler = &sink->ctrl_handler;
+	video_set_drvdata(vdev, sink);
+
+	ret = video_register_device(vdev, VFL_TYPE_VIDEO, -1);
+	if (ret) {
+		pr_err("v4l2_minimal sink: video_register_device failed: %d\n", ret);
+		goto err_free;
+	}
+
+	min_sink = sink;
+	pr_info("v4l2_minimal: null sink registered as /dev/video%d\n", vdev->num);
+	return 0;
+
+err_free:
+	v4l2_ctrl_handler_free(&sink->ctrl_handler);
+	kfree(sink);
+	return ret;
+}
+
+static void minimal_sink_unregister(void)
+{
+	if (!min_sink)
+		return;
+
+	video_unregister_device(&min_sink->vdev);
+	v4l2_ctrl_handler_free(&min_sink->ctrl_handler);
+	kfree(min_sink);
+	min_sink = NULL;
+}
+
 static void v4l2_minimal_vdev_release(struct v4l2_minimal_dev *dev)
 {
 	kfree(dev);
@@ -178,14 +1110,18 @@ static int __init v4l2_minimal_init(void)
 		return -ENOMEM;
 
 	mutex_init(&min_dev->lock);
+	spin_lock_init(&min_dev->slock);
+	INIT_LIST_HEAD(&min_dev->buf_list);
 
 	min_dev->pix_fmt.width = 640;
 	min_dev->pix_fmt.height = 480;
 	min_dev->pix_fmt.pixelformat = V4L2_PIX_FMT_YUYV;
 	min_dev->pix_fmt.field = V4L2_FIELD_NONE;
-	min_dev->pix_fmt.colorspace = V4L2_COLORSPACE_SRGB;
+	min_dev->pix_fmt.colorspace = V4L2_COLORSPACE_SMPTE170M;
 	min_dev->pix_fmt.bytesperline = min_dev->pix_fmt.width * 2;
 	min_dev->pix_fmt.sizeimage = (min_dev->pix_fmt.height * min_dev->pix_fmt.bytesperline);
+	min_dev->fmt = find_format(V4L2_PIX_FMT_YUYV);
+	min_dev->timeperframe = (struct v4l2_fract){ 1, DEF_FPS };
 
 	/* Create a simple parent device so v4l2_device has a struct device */
 	min_pdev = platform_device_register_simple("v4l2-minimal", -1, NULL, 0);
@@ -206,7 +1142,7 @@ static int __init v4l2_minimal_init(void)
 		goto err_unreg_pdev;
 	}
 
-	v4l2_ctrl_handler_init(&min_dev->ctrl_handler, 1);
+	v4l2_ctrl_handler_init(&min_dev->ctrl_handler, 2);
 
 	v4l2_ctrl_new_custom(&min_dev->ctrl_handler, &(struct v4l2_ctrl_config)
 			{
@@ -215,9 +1151,13 @@ static int __init v4l2_minimal_init(void)
 			 .name = "Overlay Enable",
 			 .type = V4L2_CTRL_TYPE_BOOLEAN,
 			 .min = 0, .max = 1, .step = 1, .def = 0,
-			 
+
 			}, NULL);
 
+	v4l2_ctrl_new_std_menu_items(&min_dev->ctrl_handler, &minimal_ctrl_ops,
+				     V4L2_CID_TEST_PATTERN, ARRAY_SIZE(pattern_menu) - 2,
+				     0, PATTERN_BARS, pattern_menu);
+
 	if(min_dev->ctrl_handler.error)
 	{
 		ret = min_dev->ctrl_handler.error;
@@ -225,37 +1165,49 @@ static int __init v4l2_minimal_init(void)
 		goto err_unreg_v4l2;
 	}
 
-	
+	ret = minimal_queue_init(min_dev);
+	if (ret) {
+		pr_err("v4l2_minimal: vb2_queue_init failed: %d\n", ret);
+		goto err_unreg_v4l2;
+	}
+
 	/* Set up video_device */
 	vdev = &min_dev->vdev;
 	memset(vdev, 0, sizeof(*vdev));
-	
+
 	strscpy(vdev->name, "v4l2-minimal", sizeof(vdev->name));
 	vdev->v4l2_dev   = &min_dev->v4l2_dev;
 	vdev->fops       = &minimal_fops;
 	vdev->ioctl_ops  = &minimal_ioctl_ops;
 	vdev->release    = video_device_release_empty;
 	vdev->lock       = &min_dev->lock;
+	vdev->queue      = &min_dev->queue;
 	vdev->device_caps = MINI_V4L2_CAP_OPTIONS;
 	vdev->vfl_type   = VFL_TYPE_VIDEO;
-	vdev->vfl_dir    = VFL_DIR_M2M;
+	vdev->vfl_dir    = VFL_DIR_RX;
 	vdev->dev_parent = &min_pdev->dev;
-	
+
 	vdev->ctrl_handler = &min_dev->ctrl_handler;
 	min_dev->v4l2_dev.ctrl_handler = &min_dev->ctrl_handler;
 
-	//pr_info("v4l2_minimal: formats=%zu\n", (size_t)MINIMAL_NUM_FORMATS);
+	video_set_drvdata(vdev, min_dev);
 
 	ret = video_register_device(vdev, VFL_TYPE_VIDEO, 0);
 	if (ret) {
 		pr_err("v4l2_minimal: video_register_device failed: %d\n", ret);
-		v4l2_device_unregister(&min_dev->v4l2_dev);
 		goto err_unreg_v4l2;
 	}
 
-	video_set_drvdata(vdev, min_dev);
-
 	pr_info("v4l2_minimal: registered as /dev/video%d\n", vdev->num);
+
+	if (null_sink) {
+		ret = minimal_sink_register(min_dev);
+		if (ret) {
+			video_unregister_device(vdev);
+			goto err_unreg_v4l2;
+		}
+	}
+
 	return 0;
 
 err_unreg_v4l2:
@@ -277,7 +1229,9 @@ static void __exit v4l2_minimal_exit(void)
 {
 	pr_info("v4l2_minimal: exit\n");
 
-	
+
+	minimal_sink_unregister();
+
 	if (min_dev) {
 		video_unregister_device(&min_dev->vdev);
 		v4l2_ctrl_handler_free(&min_dev->ctrl_handler);
@@ -297,6 +1251,5 @@ module_init(v4l2_minimal_init);
 module_exit(v4l2_minimal_exit);
 
 MODULE_LICENSE("GPL");
-MODULE_DESCRIPTION("Minimal V4L2 dummy driver");
+MODULE_DESCRIPTION("Minimal V4L2 test-pattern capture driver");
 MODULE_AUTHOR("Rath");
-